@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * bench.c
+ * Benchmark suite runner.
+ * See bench.h for the runs of the suite.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <metal/io.h>
+#include <metal/device.h>
+#include <metal/irq.h>
+#include "common.h"
+#include "sys_init.h"
+#include "timestamp.h"
+#include "demo_params.h"
+#include "results.h"
+#include "bench.h"
+#include "ocm.h"
+
+/* Tests of the suite, in the order they run */
+static const struct bench_test bench_tests[] = {
+	{ "IPI latency", DEMO_TEST_MASK_IPI_LATENCY, ipi_latency_demo },
+	{ "shared memory latency", DEMO_TEST_MASK_SHMEM_LATENCY,
+	  shmem_latency_demo },
+	{ "shared memory throughput", DEMO_TEST_MASK_SHMEM_THROUGHPUT,
+	  shmem_throughput_demo },
+	{ "SMP scaling", DEMO_TEST_MASK_SMP_SCALING, smp_scaling_demo },
+};
+
+#define BENCH_TESTS_NUM (sizeof(bench_tests) / sizeof(bench_tests[0]))
+
+/**
+ * records and duration of a measured run of a test
+ */
+struct bench_span {
+	uint32_t first; /* first record in the results area */
+	uint32_t num; /* number of records */
+	uint64_t cnt; /* system count ticks of the run */
+};
+
+static struct bench_span bench_spans[BENCH_TESTS_NUM][DEMO_RUNS_MAX];
+
+/**
+ * @brief bench_irq_handler() - IPI interrupt handler of the channel
+ *        Call the handler of the running test. There is none between two
+ *        tests, while the interrupt is disabled in the IPI.
+ *
+ * @param[in] vect_id - IPI interrupt vector ID
+ * @param[in] priv - channel
+ * @return - return of the test handler, METAL_IRQ_HANDLED if there is
+ *           none.
+ */
+static OCM_TEXT int bench_irq_handler(int vect_id, void *priv)
+{
+	struct bench_channel *ch = (struct bench_channel *)priv;
+
+	if (ch->handler)
+		return ch->handler(vect_id, ch->priv);
+	metal_io_write32(ch->ipi_io, IPI_ISR_OFFSET, IPI_MASK);
+	return METAL_IRQ_HANDLED;
+}
+
+int bench_channel_open(struct bench_channel *ch)
+{
+	memset(ch, 0, sizeof(*ch));
+	if (!shm_dev || !ipi_dev)
+		return -ENODEV;
+
+	ch->shm_io = metal_device_io_region(shm_dev, 0);
+	if (!ch->shm_io) {
+		LPERROR("Failed to map io region for %s.\n", shm_dev->name);
+		return -ENODEV;
+	}
+	ch->ttc_io = metal_device_io_region(ttc_dev, 0);
+	if (!ch->ttc_io) {
+		LPERROR("Failed to map io region for %s.\n", ttc_dev->name);
+		return -ENODEV;
+	}
+	ch->ipi_io = metal_device_io_region(ipi_dev, 0);
+	if (!ch->ipi_io) {
+		LPERROR("Failed to map io region for %s.\n", ipi_dev->name);
+		return -ENODEV;
+	}
+
+	/* disable and clear the IPI interrupt until a test enables it */
+	metal_io_write32(ch->ipi_io, IPI_IDR_OFFSET, IPI_MASK);
+	metal_io_write32(ch->ipi_io, IPI_ISR_OFFSET, IPI_MASK);
+
+	ch->ipi_irq = (intptr_t)ipi_dev->irq_info;
+	metal_irq_register(ch->ipi_irq, bench_irq_handler, ch);
+	metal_irq_enable(ch->ipi_irq);
+	return 0;
+}
+
+void bench_channel_close(struct bench_channel *ch)
+{
+	if (!ch->ipi_io)
+		return;
+	metal_io_write32(ch->ipi_io, IPI_IDR_OFFSET, IPI_MASK);
+	metal_irq_disable(ch->ipi_irq);
+	metal_irq_unregister(ch->ipi_irq);
+	ch->ipi_io = NULL;
+}
+
+void bench_irq_attach(struct bench_channel *ch, metal_irq_handler handler,
+		      void *priv)
+{
+	metal_irq_disable(ch->ipi_irq);
+	ch->handler = handler;
+	ch->priv = priv;
+	metal_irq_enable(ch->ipi_irq);
+}
+
+void bench_irq_detach(struct bench_channel *ch)
+{
+	bench_irq_attach(ch, NULL, NULL);
+}
+
+/**
+ * @brief bench_tests_selected() - tests of the suite
+ *
+ * @return - DEMO_TEST_MASK_* mask of the tests to run.
+ */
+static uint32_t bench_tests_selected(void)
+{
+	if (demo_params.tests)
+		return demo_params.tests;
+	return DEMO_TEST_MASK_IPI_LATENCY | DEMO_TEST_MASK_SHMEM_LATENCY |
+	       DEMO_TEST_MASK_SHMEM_THROUGHPUT |
+	       ((demo_params.flags & DEMO_PARAMS_SMP) ?
+		DEMO_TEST_MASK_SMP_SCALING : 0);
+}
+
+/**
+ * @brief bench_isqrt() - integer square root
+ *
+ * @param[in] v - value
+ * @return - largest integer whose square is not above v.
+ */
+static uint64_t bench_isqrt(uint64_t v)
+{
+	uint64_t r = 0, bit = 1UL << 62;
+
+	while (bit > v)
+		bit >>= 2;
+	for (; bit; bit >>= 2) {
+		if (v >= r + bit) {
+			v -= r + bit;
+			r = (r >> 1) + bit;
+		} else {
+			r >>= 1;
+		}
+	}
+	return r;
+}
+
+/**
+ * @brief bench_value() - value of a record compared from run to run
+ *
+ * @param[in] r - result
+ * @return - mean of the samples, or the APU interval of a throughput
+ *           run without samples.
+ */
+static uint64_t bench_value(const struct demo_result *r)
+{
+	return r->stat.st_cnt ? r->stat.st_sum / r->stat.st_cnt : r->apu_ticks;
+}
+
+/**
+ * @brief bench_report() - report the run to run variation of a test
+ *        The records of the measured runs are compared one by one, the
+ *        n-th record of a run with the n-th record of the other runs.
+ *        The variation of a record is the coefficient of variation of
+ *        its value over the runs.
+ *
+ * @param[in] t - test number in bench_tests
+ */
+static void bench_report(unsigned int t)
+{
+	struct bench_span *spans = bench_spans[t];
+	struct demo_result r, worst;
+	uint64_t v[DEMO_RUNS_MAX], mean, var, dev, cnt_min = ~0UL, cnt_max = 0;
+	uint64_t cnt_sum = 0;
+	uint32_t runs = demo_params.runs, run, i, n = 0;
+	uint32_t cv, cv_max = 0, cv_sum = 0;
+
+	for (run = 0; run < runs; run++) {
+		cnt_sum += spans[run].cnt;
+		if (cnt_min > spans[run].cnt)
+			cnt_min = spans[run].cnt;
+		if (cnt_max < spans[run].cnt)
+			cnt_max = spans[run].cnt;
+	}
+	RPRINTF("%s: %u runs of %u records, run time min %lu avg %lu max %lu"
+		" us\n", bench_tests[t].name, runs, spans[0].num,
+		ts_cnt_to_ns(cnt_min) / 1000,
+		ts_cnt_to_ns(cnt_sum / runs) / 1000,
+		ts_cnt_to_ns(cnt_max) / 1000);
+	if (runs < 2)
+		return;
+	for (run = 1; run < runs; run++) {
+		if (spans[run].num != spans[0].num) {
+			RPRINTF("  runs have different records, "
+				"no variation\n");
+			return;
+		}
+	}
+
+	memset(&worst, 0, sizeof(worst));
+	for (i = 0; i < spans[0].num; i++) {
+		mean = 0;
+		for (run = 0; run < runs; run++) {
+			if (results_read(spans[run].first + i, &r))
+				return;
+			v[run] = bench_value(&r);
+			mean += v[run];
+		}
+		mean /= runs;
+		if (!mean)
+			continue;
+		var = 0;
+		for (run = 0; run < runs; run++) {
+			dev = v[run] > mean ? v[run] - mean : mean - v[run];
+			var += dev * dev;
+		}
+		/* in 0.01% */
+		cv = bench_isqrt(var / runs) * 10000 / mean;
+		cv_sum += cv;
+		n++;
+		if (cv >= cv_max) {
+			cv_max = cv;
+			worst = r;
+		}
+	}
+	if (!n)
+		return;
+	RPRINTF("  run to run variation: mean %u.%02u%%, max %u.%02u%% "
+		"(test %u, package size %u, dir %u)\n",
+		cv_sum / n / 100, cv_sum / n % 100, cv_max / 100, cv_max % 100,
+		worst.test, worst.pkg_size, worst.dir);
+}
+
+int bench_run(struct bench_channel *ch)
+{
+	const struct bench_test *t;
+	struct bench_span *span;
+	uint32_t tests = bench_tests_selected(), flags = demo_params.flags;
+	uint32_t runs = demo_params.warmup_runs + demo_params.runs;
+	uint32_t run, measured, first, run_first, step = 0;
+	uint64_t start;
+	unsigned int i;
+	int warmup, ret = 0;
+
+	LPRINTF("Starting suite: tests 0x%x, %u warm-up runs, %u runs\n",
+		tests, demo_params.warmup_runs, demo_params.runs);
+	for (run = 0; run < runs && !ret; run++) {
+		warmup = run < demo_params.warmup_runs;
+		measured = warmup ? 0 : run - demo_params.warmup_runs;
+		/* Warm-up runs print nothing and add no records */
+		demo_params.flags = warmup ? flags | DEMO_PARAMS_QUIET : flags;
+		results_set_run(measured, demo_params.runs, warmup);
+		LPRINTF("%s run %u\n", warmup ? "Warm-up" : "Measured",
+			warmup ? run : measured);
+		run_first = results_num();
+
+		for (i = 0; i < BENCH_TESTS_NUM; i++) {
+			t = &bench_tests[i];
+			if (!(tests & t->mask))
+				continue;
+			/* The server is ready for the first step since
+			 * sys_init() */
+			if (step++) {
+				ret = sys_wait_remote(step);
+				if (ret)
+					break;
+			}
+			first = results_num();
+			start = ts_now();
+			ret = t->run(ch);
+			if (ret) {
+				LPERROR("%s failed: %d\n", t->name, ret);
+				break;
+			}
+			if (warmup)
+				continue;
+			span = &bench_spans[i][measured];
+			span->cnt = ts_now() - start;
+			span->first = first;
+			span->num = results_num() - first;
+		}
+		/* The measured runs add the same records, refuse to go on if
+		 * the others do not fit in the results area */
+		if (!ret && !warmup && !measured && demo_params.runs > 1 &&
+		    results_space() < (results_num() - run_first) *
+				      (demo_params.runs - 1)) {
+			LPERROR("%u runs of %u records do not fit in the "
+				"results area, %u records left.\n",
+				demo_params.runs, results_num() - run_first,
+				results_space());
+			ret = -ENOSPC;
+		}
+	}
+	demo_params.flags = flags;
+	results_set_run(0, demo_params.runs, 0);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < BENCH_TESTS_NUM; i++) {
+		if (tests & bench_tests[i].mask)
+			bench_report(i);
+	}
+	LPRINTF("Finished suite\n");
+	return 0;
+}
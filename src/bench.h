@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * bench.h
+ * Benchmark suite runner.
+ *
+ * The runner opens the IPI channel once and runs the tests selected by
+ * the parameter block over it, demo_params.tests, or the default suite:
+ * the IPI latency, shared memory latency and throughput demos, and the
+ * SMP scaling demo if DEMO_PARAMS_SMP is set. The suite is run
+ * demo_params.warmup_runs times without output nor results, then
+ * demo_params.runs times. Each record of a measured run carries the run
+ * number, and the runner reports the run to run variation of the records
+ * of each test.
+ *
+ * The channel regions are looked up and the IPI interrupt registered
+ * once. A test attaches its own handler to the IPI interrupt for as long
+ * as it runs, see bench_irq_attach().
+ *
+ * The server runs the same tests, warm-up and measured runs from the
+ * parameter block. It numbers the steps of the suite, one per test run,
+ * from 1, and waits in step n until the APU is ready for it, see
+ * sys_wait_remote().
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdint.h>
+#include <metal/io.h>
+#include <metal/irq.h>
+
+/**
+ * channel shared by the tests of the suite
+ */
+struct bench_channel {
+	struct metal_io_region *ipi_io; /* IPI metal i/o region */
+	struct metal_io_region *shm_io; /* Shared memory metal i/o region */
+	struct metal_io_region *ttc_io; /* TTC metal i/o region */
+	int ipi_irq; /* IPI interrupt */
+	metal_irq_handler handler; /* IPI handler of the running test */
+	void *priv; /* argument of the handler */
+};
+
+/**
+ * test of the suite
+ */
+struct bench_test {
+	const char *name; /* name of the test */
+	uint32_t mask; /* DEMO_TEST_MASK_* */
+	int (*run)(struct bench_channel *ch); /* run the test once */
+};
+
+/**
+ * @brief bench_channel_open() - Open the channel shared by the tests
+ *        Get the channel i/o regions and register the IPI interrupt,
+ *        with no test handler attached.
+ *
+ * @param[out] ch - channel
+ * @return - 0 on success, error code if failure.
+ */
+int bench_channel_open(struct bench_channel *ch);
+
+/**
+ * @brief bench_channel_close() - Close the channel shared by the tests
+ *
+ * @param[in] ch - channel
+ */
+void bench_channel_close(struct bench_channel *ch);
+
+/**
+ * @brief bench_irq_attach() - Attach the IPI handler of a test
+ *        The IPI interrupt stays enabled in the GIC, the test enables it
+ *        in the IPI if it uses it.
+ *
+ * @param[in] ch - channel
+ * @param[in] handler - IPI interrupt handler
+ * @param[in] priv - argument of the handler
+ */
+void bench_irq_attach(struct bench_channel *ch, metal_irq_handler handler,
+		      void *priv);
+
+/**
+ * @brief bench_irq_detach() - Detach the IPI handler of a test
+ *        The test disables the interrupt in the IPI first.
+ *
+ * @param[in] ch - channel
+ */
+void bench_irq_detach(struct bench_channel *ch);
+
+/**
+ * @brief bench_run() - Run the suite
+ *        Stop at the first test which fails, or after the first
+ *        measured run if the records of all the measured runs do not
+ *        fit in the results area.
+ *
+ * @param[in] ch - channel
+ * @return - 0 on success, -ENOSPC if the runs do not fit in the results
+ *           area, error code of the failed test otherwise.
+ */
+int bench_run(struct bench_channel *ch);
+
+#endif /* __BENCH_H__ */
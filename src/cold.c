@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * cold.c
+ * Cold path latency measurements.
+ * See cold.h for how the path is made cold.
+ */
+
+#include <metal/sleep.h>
+#include "common.h"
+#include "timestamp.h"
+#include "results.h"
+#include "cold.h"
+
+static const char *cold_mode_names[COLD_MODES_NUM] = {
+	[COLD_MODE_WARM] = "warm",
+	[COLD_MODE_EVICT] = "after eviction",
+	[COLD_MODE_IDLE] = "after idle",
+};
+
+/* Eviction buffer, only read */
+static uint8_t cold_evict_buf[COLD_EVICT_SIZE] __attribute__((aligned(64)));
+
+/**
+ * @brief cold_evict() - Evict the caches and TLBs of the APU core
+ *        The eviction buffer walk displaces the L1 data cache and the L2,
+ *        without the set/way maintenance Xen would have to emulate. The
+ *        I-cache and the TLBs of the translation regime of the current
+ *        exception level are invalidated.
+ */
+static void cold_evict(void)
+{
+	volatile uint8_t *p = cold_evict_buf;
+	uint64_t el;
+	size_t i;
+
+	for (i = 0; i < COLD_EVICT_SIZE; i += 64)
+		(void)p[i];
+
+	asm volatile("mrs %0, CurrentEL" : "=r" (el));
+	asm volatile("dsb ish; ic iallu" ::: "memory");
+	switch ((el >> 2) & 0x3) {
+	case 3:
+		asm volatile("tlbi alle3" ::: "memory");
+		break;
+	case 2:
+		asm volatile("tlbi alle2" ::: "memory");
+		break;
+	default:
+		asm volatile("tlbi vmalle1" ::: "memory");
+		break;
+	}
+	asm volatile("dsb ish; isb" ::: "memory");
+}
+
+void cold_prepare(enum cold_mode mode)
+{
+	if (mode == COLD_MODE_EVICT)
+		cold_evict();
+	else if (mode == COLD_MODE_IDLE)
+		metal_sleep_usec(COLD_IDLE_US);
+}
+
+void cold_stat_init(struct cold_stat *cs, enum cold_mode mode)
+{
+	struct metal_stat init = STAT_INIT;
+
+	cs->mode = mode;
+	cs->a2r = init;
+	cs->r2a = init;
+	cs->rt = init;
+}
+
+void cold_report(const struct demo_result *res, const struct cold_stat *cs,
+		 uint64_t warm_rt_ns)
+{
+	struct demo_result rec = *res;
+
+	if (!cs->rt.st_cnt)
+		return;
+	RPRINTF("  %s, %lu samples:\n", cold_mode_names[cs->mode],
+		cs->rt.st_cnt);
+	RPRINTF("    APU to RPU: [%lu, %lu] avg: %lu ns\n",
+		cs->a2r.st_min, cs->a2r.st_max,
+		ts_ticks_to_ns(cs->a2r.st_sum) / cs->a2r.st_cnt);
+	RPRINTF("    RPU to APU: [%lu, %lu] avg: %lu ns\n",
+		cs->r2a.st_min, cs->r2a.st_max,
+		ts_ticks_to_ns(cs->r2a.st_sum) / cs->r2a.st_cnt);
+	RPRINTF("    worst round trip: %lu ns, avg %lu ns, warm avg %lu ns\n",
+		ts_ticks_to_ns(cs->rt.st_max),
+		ts_ticks_to_ns(cs->rt.st_sum) / cs->rt.st_cnt, warm_rt_ns);
+
+	rec.flags |= cs->mode == COLD_MODE_EVICT ? RESULT_COLD_EVICT :
+		     RESULT_COLD_IDLE;
+	rec.dir = TS_APU_TO_RPU;
+	rec.stat = cs->a2r;
+	memset(&rec.pctl, 0, sizeof(rec.pctl));
+	results_add(&rec, NULL);
+	rec.dir = TS_RPU_TO_APU;
+	rec.stat = cs->r2a;
+	results_add(&rec, NULL);
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * cold.h
+ * Cold path latency measurements.
+ *
+ * The latency demos run the same exchange back to back, so after the
+ * first iterations the code, data and page tables of the path are in the
+ * caches and TLBs and the branches are predicted. The first message after
+ * an idle period finds none of it. With DEMO_PARAMS_COLD, the latency
+ * demos measure a few more exchanges per path, each one after:
+ * - COLD_MODE_EVICT: a walk over an eviction buffer of twice the APU L2
+ *   size, an I-cache invalidate and a TLB invalidate. The branch
+ *   predictors cannot be reset from AArch64, they are only disturbed by
+ *   the walk.
+ * - COLD_MODE_IDLE: COLD_IDLE_US of sleep, so the path is only as warm as
+ *   the rest of the system leaves it.
+ *
+ * The cold samples are kept apart from the warm ones, in records flagged
+ * RESULT_COLD_EVICT or RESULT_COLD_IDLE, and the worst round trip from
+ * cold is reported per path.
+ */
+
+#ifndef __COLD_H__
+#define __COLD_H__
+
+#include <stdint.h>
+#include "common.h"
+#include "results.h"
+
+#define COLD_ITERATIONS  32 /* cold samples per path and mode */
+#define COLD_EVICT_SIZE  0x200000 /* twice the 1MB APU L2 */
+#define COLD_IDLE_US     10000
+
+/**
+ * how the path is made cold before a sample
+ */
+enum cold_mode {
+	COLD_MODE_WARM = 0, /* not cold, back to back samples */
+	COLD_MODE_EVICT = 1, /* caches and TLBs evicted */
+	COLD_MODE_IDLE = 2, /* idle */
+	COLD_MODES_NUM,
+};
+
+/**
+ * statistics of the cold samples of a path
+ */
+struct cold_stat {
+	enum cold_mode mode; /* how the path is made cold */
+	struct metal_stat a2r; /* APU to RPU timestamp ticks */
+	struct metal_stat r2a; /* RPU to APU timestamp ticks */
+	struct metal_stat rt; /* round trip timestamp ticks */
+};
+
+/**
+ * @brief cold_prepare() - Make the path cold before a sample
+ *
+ * @param[in] mode - how to make it cold
+ */
+void cold_prepare(enum cold_mode mode);
+
+/**
+ * @brief cold_stat_init() - Initialize the cold statistics of a path
+ *
+ * @param[out] cs - cold statistics
+ * @param[in] mode - how the path is made cold
+ */
+void cold_stat_init(struct cold_stat *cs, enum cold_mode mode);
+
+/**
+ * @brief cold_stat_update() - Add a cold sample
+ *
+ * @param[in/out] cs - cold statistics
+ * @param[in] a2r - APU to RPU timestamp ticks
+ * @param[in] r2a - RPU to APU timestamp ticks
+ */
+static inline void cold_stat_update(struct cold_stat *cs, uint64_t a2r,
+				    uint64_t r2a)
+{
+	update_stat(&cs->a2r, a2r);
+	update_stat(&cs->r2a, r2a);
+	update_stat(&cs->rt, a2r + r2a);
+}
+
+/**
+ * @brief cold_report() - Report the cold statistics of a path and export
+ *        them, one record per direction
+ *
+ * @param[in] res - record of the path, test, package size and flags, the
+ *                  cold flag, direction and statistics are set here
+ * @param[in] cs - cold statistics
+ * @param[in] warm_rt_ns - average warm round trip of the path, in ns
+ */
+void cold_report(const struct demo_result *res, const struct cold_stat *cs,
+		 uint64_t warm_rt_ns);
+
+#endif /* __COLD_H__ */
@@ -12,9 +12,12 @@
 #include <metal/cpu.h>
 #include <metal/io.h>
 #include <metal/device.h>
+#include <metal/cache.h>
 
 #include <sys/types.h>
 #include "sys_init.h"
+#include "demo_params.h"
+#include "trace.h"
 
 #include <errno.h>
 
@@ -23,6 +26,13 @@
 #define IPI_DEV_NAME    "ff340000.ipi"
 #define SHM_DEV_NAME    "3ed80000.shm"
 #define TTC_DEV_NAME    "ff110000.ttc"
+#define IPI1_DEV_NAME   "ff350000.ipi" /* IPI channel 8, APU core 1 */
+#define IPI2_DEV_NAME   "ff360000.ipi" /* IPI channel 9, APU core 2 */
+#define IPI3_DEV_NAME   "ff370000.ipi" /* IPI channel 10, APU core 3 */
+#define GDMA_DEV_NAME   "fd500000.dma" /* GDMA channel 0 */
+
+/* APU cores, each with its own IPI channel to the RPU */
+#define SMP_CORES_MAX   4
 
 /* IPI registers offset */
 #define IPI_TRIG_OFFSET 0x0  /* IPI trigger reg offset */
@@ -50,17 +60,182 @@
 
 #define LPERROR(format, ...) LPRINTF("ERROR: " format, ##__VA_ARGS__)
 
+/* Print measurement results, unless they only go to the results area */
+#define RPRINTF(format, ...) \
+  do { \
+    if (!(demo_params.flags & DEMO_PARAMS_QUIET)) \
+      LPRINTF(format, ##__VA_ARGS__); \
+  } while (0)
+
 extern struct metal_device *ipi_dev; /* IPI metal device */
 extern struct metal_device *shm_dev; /* SHM metal device */
 extern struct metal_device *ttc_dev; /* TTC metal device */
+extern struct metal_device *smp_ipi_dev[SMP_CORES_MAX]; /* IPI metal device
+							 * of each APU core,
+							 * [0] is ipi_dev */
+extern struct metal_device *gdma_dev; /* GDMA channel metal device */
+extern int shm_cacheable; /* 1 - shared memory is mapped cacheable */
+extern int shm_neon_copy; /* 1 - shared memory block copies use NEON */
 
+/**
+ * @brief shm_cache_flush() - Write back shared memory data to DDR
+ *        Producers call it after writing and before notifying the
+ *        remote. It does nothing if the shared memory is not cacheable.
+ *
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset of the data in the region
+ * @param[in] len - length of the data
+ */
+static inline void shm_cache_flush(struct metal_io_region *io,
+				   unsigned long offset, size_t len)
+{
+	if (shm_cacheable)
+		metal_cache_flush(metal_io_virt(io, offset), len);
+}
+
+/**
+ * @brief shm_cache_invalidate() - Drop cached shared memory data
+ *        Consumers call it before reading data written by the remote.
+ *        It does nothing if the shared memory is not cacheable.
+ *
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset of the data in the region
+ * @param[in] len - length of the data
+ */
+static inline void shm_cache_invalidate(struct metal_io_region *io,
+					unsigned long offset, size_t len)
+{
+	if (shm_cacheable)
+		metal_cache_invalidate(metal_io_virt(io, offset), len);
+}
+
+/**
+ * @brief shm_block_write_chunked() - Write data larger than the source
+ *        buffer to the shared memory, the buffer is written again for
+ *        each chunk of buf_size bytes.
+ *
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset of the data in the region
+ * @param[in] buf - source buffer
+ * @param[in] buf_size - size of the source buffer
+ * @param[in] len - length of the data
+ * @return - len on success, -EINVAL if buf_size is 0 or if a chunk
+ *           cannot be written.
+ */
+static inline int shm_block_write_chunked(struct metal_io_region *io,
+					  unsigned long offset,
+					  const void *buf, size_t buf_size,
+					  size_t len)
+{
+	size_t chunk, done;
+
+	if (!buf_size)
+		return -EINVAL;
+	for (done = 0; done < len; done += chunk) {
+		chunk = len - done < buf_size ? len - done : buf_size;
+		if (metal_io_block_write(io, offset + done, buf, chunk) !=
+		    (int)chunk)
+			return -EINVAL;
+	}
+	return (int)len;
+}
+
+/**
+ * @brief shm_block_read_chunked() - Read data larger than the destination
+ *        buffer from the shared memory in chunks of buf_size bytes.
+ *        The chunks are read from the end, so the buffer holds the first
+ *        chunk of the data on return.
+ *
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset of the data in the region
+ * @param[out] buf - destination buffer
+ * @param[in] buf_size - size of the destination buffer
+ * @param[in] len - length of the data
+ * @return - len on success, -EINVAL if buf_size is 0 or if a chunk
+ *           cannot be read.
+ */
+static inline int shm_block_read_chunked(struct metal_io_region *io,
+					 unsigned long offset,
+					 void *buf, size_t buf_size,
+					 size_t len)
+{
+	size_t chunk, left = len;
+
+	if (!buf_size)
+		return -EINVAL;
+	while (left) {
+		/* The last chunk may be partial, read it first */
+		chunk = left % buf_size ? left % buf_size : buf_size;
+		left -= chunk;
+		if (metal_io_block_read(io, offset + left, buf, chunk) !=
+		    (int)chunk)
+			return -EINVAL;
+	}
+	return (int)len;
+}
+
+/**
+ * @brief shm_block_sum() - Read data in place in the shared memory.
+ *        The zero-copy paths consume a whole payload without copying it:
+ *        the data is read with 64-bit loads, byte loads for the tail, and
+ *        summed.
+ *
+ * @param[in] p - data in the shared memory, aligned on 8 bytes
+ * @param[in] len - length of the data
+ * @return - sum of the 64-bit words and of the tail bytes.
+ */
+static inline uint64_t shm_block_sum(const void *p, size_t len)
+{
+	const volatile uint64_t *w = p;
+	const volatile uint8_t *b;
+	uint64_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < len / sizeof(*w); i++)
+		sum += w[i];
+	b = (const volatile uint8_t *)(w + i);
+	for (i = 0; i < len % sizeof(*w); i++)
+		sum += b[i];
+	return sum;
+}
+
+
+struct bench_channel;
 
 /**
  * @brief ipi_latency_demo() - Show performance of  IPI with Libmetal.
  *
+ * @param[in] bch - channel shared by the tests, see bench.h
  * @return - 0 on success, error code if failure.
  */
-int ipi_latency_demo();
+int ipi_latency_demo(struct bench_channel *bch);
+
+/**
+ * @brief shmem_latency_demo() - Show the latency of shared memory
+ *        messages of each package size.
+ *
+ * @param[in] bch - channel shared by the tests, see bench.h
+ * @return - 0 on success, error code if failure.
+ */
+int shmem_latency_demo(struct bench_channel *bch);
+
+/**
+ * @brief shmem_throughput_demo() - Show the shared memory throughput of
+ *        each package size.
+ *
+ * @param[in] bch - channel shared by the tests, see bench.h
+ * @return - 0 on success, error code if failure.
+ */
+int shmem_throughput_demo(struct bench_channel *bch);
+
+/**
+ * @brief smp_scaling_demo() - Show how IPI latency and shared memory
+ *        throughput scale with the number of APU cores.
+ *
+ * @param[in] bch - channel shared by the tests, see bench.h
+ * @return - 0 on success, error code if failure.
+ */
+int smp_scaling_demo(struct bench_channel *bch);
 
 static inline void wait_for_interrupt()
 {
@@ -68,13 +243,53 @@ static inline void wait_for_interrupt()
 	//asm volatile("yield"); //used client side
 }
 
+static inline void wait_for_event()
+{
+	asm volatile("wfe");
+}
+
+/* Number of polls of the notified flag before the spin then wfi policy
+ * goes to sleep */
+#define WAIT_SPIN_COUNT 1000
+
 /**
- * @brief wait_for_notified() - Loop until notified bit
- *        in channel is set.
+ * wait policies of wait_for_notified()
+ */
+enum wait_policy {
+	WAIT_POLICY_WFI = 0, /* sleep in wfi with interrupts disabled */
+	WAIT_POLICY_SPIN, /* poll the flag until the irq handler clears it */
+	WAIT_POLICY_SPIN_WFI, /* poll WAIT_SPIN_COUNT times, then wfi */
+	WAIT_POLICY_WFE, /* sleep in wfe, woken up by the interrupt */
+};
+
+/**
+ * @brief wait_policy_name() - return wait policy name
+ *
+ * @param[in] policy - wait policy
+ */
+static inline const char *wait_policy_name(enum wait_policy policy)
+{
+	switch (policy) {
+	case WAIT_POLICY_WFI:
+		return "wfi";
+	case WAIT_POLICY_SPIN:
+		return "spin";
+	case WAIT_POLICY_SPIN_WFI:
+		return "spin then wfi";
+	case WAIT_POLICY_WFE:
+		return "wfe";
+	default:
+		return "unknown";
+	}
+}
+
+/**
+ * @brief wait_for_notified_wfi() - Loop until notified bit
+ *        in channel is set, sleep in wfi between checks.
  *
  * @param[in] notified - pointer to the notified variable
  */
-static inline void  wait_for_notified(atomic_flag *notified)
+static inline void wait_for_notified_wfi(atomic_flag *notified)
 {
 	unsigned int flags;
 
@@ -89,6 +304,48 @@ static inline void  wait_for_notified(atomic_flag *notified)
 	} while(1);
 }
 
+/**
+ * @brief wait_for_notified() - Loop until notified bit
+ *        in channel is set.
+ *
+ * @param[in] notified - pointer to the notified variable
+ * @param[in] policy - how to wait while the bit is not set
+ */
+static inline void wait_for_notified(atomic_flag *notified,
+				     enum wait_policy policy)
+{
+	unsigned int i;
+
+	trace_event(TRACE_WAIT_START, policy);
+	switch (policy) {
+	case WAIT_POLICY_SPIN:
+		while (atomic_flag_test_and_set(notified))
+			metal_cpu_yield();
+		break;
+	case WAIT_POLICY_SPIN_WFI:
+		for (i = 0; i < WAIT_SPIN_COUNT; i++) {
+			if (!atomic_flag_test_and_set(notified))
+				goto out;
+			metal_cpu_yield();
+		}
+		wait_for_notified_wfi(notified);
+		break;
+	case WAIT_POLICY_WFE:
+		/* If the interrupt comes in between the check and the wfe,
+		 * the exception return sets the event register and wfe
+		 * returns immediately, the wake up cannot be lost. */
+		while (atomic_flag_test_and_set(notified))
+			wait_for_event();
+		break;
+	case WAIT_POLICY_WFI:
+	default:
+		wait_for_notified_wfi(notified);
+		break;
+	}
+out:
+	trace_event(TRACE_WAIT_END, policy);
+}
+
 /**
  * @brief print_demo() - print demo string
  *
@@ -126,4 +383,262 @@ static inline void update_stat(struct metal_stat *pst, uint64_t val)
 		pst->st_max = val;
 }
 
+/**
+ * log-linear histogram
+ * Values below HIST_SUB_BUCKETS have a bucket each. Above, every power of
+ * two range is split in HIST_SUB_BUCKETS linear buckets, the bucket width
+ * is at most 1/HIST_SUB_BUCKETS of the value. Values above 32 bits go to
+ * the last bucket.
+ */
+#define HIST_SUB_BITS    3
+#define HIST_SUB_BUCKETS (1U << HIST_SUB_BITS)
+#define HIST_BUCKETS     ((32 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+struct metal_hist {
+	uint32_t h_cnt;
+	uint32_t h_bucket[HIST_BUCKETS];
+};
+
+/**
+ * log-linear histogram with 64bit counts, same buckets as struct
+ * metal_hist, for runs which may take more than 2^32 samples, e.g. a
+ * soak. It is exported as a struct metal_hist, see hist64_export().
+ */
+struct metal_hist64 {
+	uint64_t h_cnt;
+	uint64_t h_bucket[HIST_BUCKETS];
+};
+
+/**
+ * percentiles computed from a histogram
+ */
+struct metal_pctl {
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t p999;
+	uint64_t max;
+};
+
+/**
+ * @brief reset_hist() - clear histogram
+ *
+ * @param[in] ph - pointer to the histogram
+ */
+static inline void reset_hist(struct metal_hist *ph)
+{
+	memset(ph, 0, sizeof(*ph));
+}
+
+/**
+ * @brief hist_bucket_idx() - return the bucket of a value
+ *
+ * @param[in] val - the value
+ */
+static inline unsigned int hist_bucket_idx(uint64_t val)
+{
+	unsigned int shift;
+
+	if (val < HIST_SUB_BUCKETS)
+		return val;
+	if (val >> 32)
+		return HIST_BUCKETS - 1;
+	shift = 63 - __builtin_clzll(val) - HIST_SUB_BITS;
+	return ((shift + 1) << HIST_SUB_BITS) +
+	       ((val >> shift) & (HIST_SUB_BUCKETS - 1));
+}
+
+/**
+ * @brief update_hist() - add a value to the histogram
+ *
+ * @param[in] ph - pointer to the histogram
+ * @param[in] val - the value for the update
+ */
+static inline void update_hist(struct metal_hist *ph, uint64_t val)
+{
+	ph->h_cnt++;
+	ph->h_bucket[hist_bucket_idx(val)]++;
+}
+
+/**
+ * @brief reset_hist64() - clear 64bit histogram
+ *
+ * @param[in] ph - pointer to the histogram
+ */
+static inline void reset_hist64(struct metal_hist64 *ph)
+{
+	memset(ph, 0, sizeof(*ph));
+}
+
+/**
+ * @brief update_hist64() - add a value to the 64bit histogram
+ *
+ * @param[in] ph - pointer to the histogram
+ * @param[in] val - the value for the update
+ */
+static inline void update_hist64(struct metal_hist64 *ph, uint64_t val)
+{
+	ph->h_cnt++;
+	ph->h_bucket[hist_bucket_idx(val)]++;
+}
+
+/**
+ * @brief hist_bucket_max() - return the highest value of a bucket
+ *
+ * @param[in] idx - bucket index
+ */
+static inline uint64_t hist_bucket_max(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < HIST_SUB_BUCKETS)
+		return idx;
+	shift = (idx >> HIST_SUB_BITS) - 1;
+	return ((uint64_t)(HIST_SUB_BUCKETS + (idx & (HIST_SUB_BUCKETS - 1)) + 1)
+		<< shift) - 1;
+}
+
+/**
+ * @brief hist_percentile() - return the value below which the given
+ *        fraction of the samples are, rounded up to the bucket top.
+ *
+ * @param[in] ph - pointer to the histogram
+ * @param[in] pct - fraction in 1/10000, e.g. 9990 for p99.9
+ */
+static inline uint64_t hist_percentile(struct metal_hist *ph, uint32_t pct)
+{
+	uint64_t rank, cnt = 0;
+	unsigned int i;
+
+	if (!ph->h_cnt)
+		return 0;
+	rank = ((uint64_t)ph->h_cnt * pct + 9999) / 10000;
+	if (!rank)
+		rank = 1;
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		cnt += ph->h_bucket[i];
+		if (cnt >= rank)
+			break;
+	}
+	return hist_bucket_max(i < HIST_BUCKETS ? i : HIST_BUCKETS - 1);
+}
+
+/**
+ * @brief hist64_percentile() - hist_percentile() of a 64bit histogram
+ *
+ * @param[in] ph - pointer to the histogram
+ * @param[in] pct - fraction in 1/10000, e.g. 9990 for p99.9
+ */
+static inline uint64_t hist64_percentile(struct metal_hist64 *ph,
+					 uint32_t pct)
+{
+	uint64_t rank, cnt = 0;
+	unsigned int i;
+
+	if (!ph->h_cnt)
+		return 0;
+	/* h_cnt / 10000 * pct does not overflow, the remainder is exact */
+	rank = ph->h_cnt / 10000 * pct +
+	       ((ph->h_cnt % 10000) * pct + 9999) / 10000;
+	if (!rank)
+		rank = 1;
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		cnt += ph->h_bucket[i];
+		if (cnt >= rank)
+			break;
+	}
+	return hist_bucket_max(i < HIST_BUCKETS ? i : HIST_BUCKETS - 1);
+}
+
+/**
+ * @brief hist64_export() - copy a 64bit histogram to a struct metal_hist
+ *        The counts are shifted right until the total fits in 32 bits,
+ *        the bucket shares stay the same up to the rounding down.
+ *
+ * @param[in] src - 64bit histogram
+ * @param[out] dst - exported histogram
+ * @return - shift of the counts, 0 if they are exact.
+ */
+static inline uint32_t hist64_export(const struct metal_hist64 *src,
+				     struct metal_hist *dst)
+{
+	uint32_t shift = 0;
+	unsigned int i;
+
+	while (src->h_cnt >> shift > UINT32_MAX)
+		shift++;
+	dst->h_cnt = 0;
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		dst->h_bucket[i] = (uint32_t)(src->h_bucket[i] >> shift);
+		dst->h_cnt += dst->h_bucket[i];
+	}
+	return shift;
+}
+
+/**
+ * @brief pctl_clamp() - set the maximum of percentiles and clamp them to
+ *        it, bucket tops can be above the exact maximum
+ *
+ * @param[in/out] pp - percentiles
+ * @param[in] max - exact maximum
+ */
+static inline void pctl_clamp(struct metal_pctl *pp, uint64_t max)
+{
+	pp->max = max;
+	if (pp->p50 > max)
+		pp->p50 = max;
+	if (pp->p90 > max)
+		pp->p90 = max;
+	if (pp->p99 > max)
+		pp->p99 = max;
+	if (pp->p999 > max)
+		pp->p999 = max;
+}
+
+/**
+ * @brief hist_percentiles() - compute the reported percentiles
+ *
+ * @param[in] ph - pointer to the histogram
+ * @param[in] max - exact maximum, e.g. from struct metal_stat
+ * @param[out] pp - percentiles
+ */
+static inline void hist_percentiles(struct metal_hist *ph, uint64_t max,
+				    struct metal_pctl *pp)
+{
+	pp->p50 = hist_percentile(ph, 5000);
+	pp->p90 = hist_percentile(ph, 9000);
+	pp->p99 = hist_percentile(ph, 9900);
+	pp->p999 = hist_percentile(ph, 9990);
+	pctl_clamp(pp, max);
+}
+
+/**
+ * @brief hist64_percentiles() - hist_percentiles() of a 64bit histogram
+ *
+ * @param[in] ph - pointer to the histogram
+ * @param[in] max - exact maximum, e.g. from struct metal_stat
+ * @param[out] pp - percentiles
+ */
+static inline void hist64_percentiles(struct metal_hist64 *ph, uint64_t max,
+				      struct metal_pctl *pp)
+{
+	pp->p50 = hist64_percentile(ph, 5000);
+	pp->p90 = hist64_percentile(ph, 9000);
+	pp->p99 = hist64_percentile(ph, 9900);
+	pp->p999 = hist64_percentile(ph, 9990);
+	pctl_clamp(pp, max);
+}
+
+/**
+ * @brief print_pctl() - print percentiles
+ *
+ * @param[in] name - name of the measurement
+ * @param[in] pp - percentiles
+ */
+static inline void print_pctl(const char *name, struct metal_pctl *pp)
+{
+	RPRINTF("%s: p50: %lu p90: %lu p99: %lu p99.9: %lu max: %lu ticks\n",
+		name, pp->p50, pp->p90, pp->p99, pp->p999, pp->max);
+}
+
 #endif /* __COMMON_H__ */
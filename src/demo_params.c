@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * demo_params.c
+ * Runtime parameters of the demos.
+ * See demo_params.h for the shared memory structure of the parameters.
+ */
+
+#include <errno.h>
+#include <metal/io.h>
+#include "common.h"
+#include "demo_params.h"
+
+struct demo_params demo_params = {
+	.magic = DEMO_PARAMS_MAGIC,
+	.version = DEMO_PARAMS_VERSION,
+	.iterations = DEFAULT_ITERATIONS,
+	.pkg_size_min = DEFAULT_PKG_SIZE_MIN,
+	.pkg_size_max = DEFAULT_PKG_SIZE_MAX,
+	.buf_size_max = DEFAULT_BUF_SIZE_MAX,
+	.total_data_size = DEFAULT_TOTAL_DATA_SIZE,
+	.flags = DEFAULT_FLAGS,
+	.soak_secs = DEFAULT_SOAK_SECS,
+	.soak_period = DEFAULT_SOAK_PERIOD,
+	.evtchn_port = DEFAULT_EVTCHN_PORT,
+	.tests = DEFAULT_TESTS,
+	.warmup_runs = DEFAULT_WARMUP_RUNS,
+	.runs = DEFAULT_RUNS,
+	.pipe_window = DEFAULT_PIPE_WINDOW,
+};
+
+/**
+ * @brief demo_params_fill_sizes() - fill the package sizes list
+ *        An empty list is filled with the powers of two from the minimum
+ *        to the maximum package size. The minimum and maximum package
+ *        sizes are then set from the list.
+ *
+ * @param[in/out] p - parameters
+ * @return - 0 on success, -EINVAL if there are too many sizes.
+ */
+static int demo_params_fill_sizes(struct demo_params *p)
+{
+	uint32_t s, i;
+
+	if (!p->num_sizes) {
+		if (!p->pkg_size_min)
+			return -EINVAL;
+		for (s = p->pkg_size_min; s <= p->pkg_size_max; s <<= 1) {
+			if (p->num_sizes >= DEMO_SIZES_MAX)
+				return -EINVAL;
+			p->sizes[p->num_sizes++] = s;
+		}
+	}
+	if (p->num_sizes > DEMO_SIZES_MAX)
+		return -EINVAL;
+	p->pkg_size_min = ~0U;
+	p->pkg_size_max = 0;
+	for (i = 0; i < p->num_sizes; i++) {
+		if (p->pkg_size_min > p->sizes[i])
+			p->pkg_size_min = p->sizes[i];
+		if (p->pkg_size_max < p->sizes[i])
+			p->pkg_size_max = p->sizes[i];
+	}
+	return 0;
+}
+
+/**
+ * @brief demo_params_check() - check the parameters are in range
+ *
+ * @param[in] p - parameters, with the package sizes list filled
+ * @return - 0 if valid, -EINVAL otherwise.
+ */
+static int demo_params_check(const struct demo_params *p)
+{
+	if (!p->iterations || !p->num_sizes)
+		return -EINVAL;
+	if (p->pkg_size_min < PKG_SIZE_LIMIT_MIN ||
+	    p->pkg_size_max > PKG_SIZE_LIMIT_MAX)
+		return -EINVAL;
+	if (p->buf_size_max < PKG_SIZE_LIMIT_MIN)
+		return -EINVAL;
+	if (p->total_data_size < p->pkg_size_max)
+		return -EINVAL;
+	if (p->soak_secs && !p->soak_period)
+		return -EINVAL;
+	if (p->tests & ~DEMO_TEST_MASK_ALL)
+		return -EINVAL;
+	if (!p->runs || p->runs > DEMO_RUNS_MAX ||
+	    p->warmup_runs > DEMO_RUNS_MAX)
+		return -EINVAL;
+	if (p->pipe_window > PIPE_WINDOW_MAX)
+		return -EINVAL;
+	return 0;
+}
+
+int demo_params_load(struct metal_io_region *io)
+{
+	struct demo_params p;
+	int ret = -EINVAL;
+
+	/* The built-in defaults have no list */
+	demo_params_fill_sizes(&demo_params);
+	if (!io)
+		return ret;
+	shm_cache_invalidate(io, SHM_PARAMS_OFFSET, sizeof(p));
+	metal_io_block_read(io, SHM_PARAMS_OFFSET, &p, sizeof(p));
+	if (p.magic != DEMO_PARAMS_MAGIC || p.version != DEMO_PARAMS_VERSION)
+		return -ENOENT;
+	ret = demo_params_fill_sizes(&p);
+	if (!ret)
+		ret = demo_params_check(&p);
+	if (ret) {
+		LPERROR("Invalid shared memory parameters, using defaults.\n");
+		return ret;
+	}
+	demo_params = p;
+	return 0;
+}
+
+void demo_params_print(void)
+{
+	uint32_t i;
+
+	LPRINTF("parameters: iterations %u, package size [%u, %u], "
+		"buffer size %u, total data size %u, flags 0x%x\n",
+		demo_params.iterations, demo_params.pkg_size_min,
+		demo_params.pkg_size_max, demo_params.buf_size_max,
+		demo_params.total_data_size, demo_params.flags);
+	if (demo_params.soak_secs)
+		LPRINTF("IPI latency soak: %u s, summary every %u s\n",
+			demo_params.soak_secs, demo_params.soak_period);
+	if (demo_params.evtchn_port)
+		LPRINTF("kicks on Xen event channel port %u\n",
+			demo_params.evtchn_port);
+	LPRINTF("suite: tests 0x%x, %u warm-up runs, %u runs\n",
+		demo_params.tests, demo_params.warmup_runs, demo_params.runs);
+	if (demo_params.pipe_window)
+		LPRINTF("pipelined latency: windows up to %u\n",
+			demo_params.pipe_window);
+	for (i = 0; i < demo_params.num_sizes; i++)
+		LPRINTF("package size %u: %u\n", i, demo_params.sizes[i]);
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * demo_params.h
+ * Runtime parameters of the demos.
+ *
+ * The server or a Linux side tool may fill the parameter block in the
+ * shared memory before the client starts. The client reads it once in
+ * sys_init(). If the block has no valid magic and version, or if one of
+ * the values is out of range, the built-in defaults are used.
+ *
+ * The demo data areas start at the bottom of the shared memory, so the
+ * parameter block sits in the control area at the top of it, which is
+ * never cleared by the demos.
+ *
+ * Here is the structure of the parameter block:
+ * |0x00 - 0x03 | magic, DEMO_PARAMS_MAGIC |
+ * |0x04 - 0x07 | version, DEMO_PARAMS_VERSION |
+ * |0x08 - 0x0B | iterations of the latency demos |
+ * |0x0C - 0x0F | minimum package size |
+ * |0x10 - 0x13 | maximum package size |
+ * |0x14 - 0x17 | size of the private buffers |
+ * |0x18 - 0x1B | data sent per package size by the throughput demo |
+ * |0x1C - 0x1F | flags, DEMO_PARAMS_* flags |
+ * |0x20 - 0x23 | number of package sizes in the list |
+ * |0x24 - 0x63 | package sizes list, DEMO_SIZES_MAX entries |
+ * |0x64 - 0x67 | duration of the IPI latency soak in seconds, 0 for none |
+ * |0x68 - 0x6B | period of the soak summaries in seconds |
+ * |0x6C - 0x6F | Xen event channel port of the kicks to the RPU, 0 to
+ *                kick with the IPI, see notify.h |
+ * |0x70 - 0x73 | tests of the suite, DEMO_TEST_MASK_* mask, 0 for the
+ *                default suite, see bench.h |
+ * |0x74 - 0x77 | warm-up runs of the suite, their results are dropped |
+ * |0x78 - 0x7B | measured runs of the suite, from 1 to DEMO_RUNS_MAX |
+ * |0x7C - 0x7F | largest window of the pipelined shared memory latency, up
+ *                to PIPE_WINDOW_MAX, 0 for none |
+ *
+ * If the list is empty, the package sizes are the powers of two from the
+ * minimum to the maximum package size. Otherwise the sizes of the list
+ * are used in order, they need not be powers of two nor aligned, and the
+ * minimum and maximum package sizes are set from the list.
+ *
+ * Packages larger than the private buffers are copied in chunks of the
+ * private buffer size, so the private buffers do not grow with the
+ * package size.
+ */
+
+#ifndef __DEMO_PARAMS_H__
+#define __DEMO_PARAMS_H__
+
+#include <stdint.h>
+#include <metal/io.h>
+
+/* Parameter block in the shared memory */
+#define SHM_PARAMS_OFFSET   0xFF0000
+#define DEMO_PARAMS_MAGIC   0x50524D53 /* "PRMS" */
+#define DEMO_PARAMS_VERSION 7
+
+/* Built-in defaults */
+#define DEFAULT_ITERATIONS      1000
+#define DEFAULT_PKG_SIZE_MIN    16
+#define DEFAULT_PKG_SIZE_MAX    1024
+#define DEFAULT_BUF_SIZE_MAX    4096
+#define DEFAULT_TOTAL_DATA_SIZE (1024 * 4096)
+#define DEFAULT_FLAGS           0
+#define DEFAULT_SOAK_SECS       0
+#define DEFAULT_SOAK_PERIOD     60
+#define DEFAULT_EVTCHN_PORT     0
+#define DEFAULT_TESTS           0
+#define DEFAULT_WARMUP_RUNS     0
+#define DEFAULT_RUNS            1
+#define DEFAULT_PIPE_WINDOW     0
+
+/* Flags */
+#define DEMO_PARAMS_QUIET 0x1 /* results only go to the results area */
+#define DEMO_PARAMS_SMP   0x2 /* run the SMP scaling demo */
+#define DEMO_PARAMS_DOORBELL 0x4 /* poll doorbells instead of the IPI */
+#define DEMO_PARAMS_COLD  0x8 /* also measure the latencies from cold, see
+			       * cold.h */
+
+/* Tests of the suite */
+#define DEMO_TEST_MASK_IPI_LATENCY      0x1
+#define DEMO_TEST_MASK_SHMEM_LATENCY    0x2
+#define DEMO_TEST_MASK_SHMEM_THROUGHPUT 0x4
+#define DEMO_TEST_MASK_SMP_SCALING      0x8 /* needs the client at EL1 */
+#define DEMO_TEST_MASK_ALL              0xF
+
+/* Limits of the package sizes, a latency message starts with a header of
+ * 16 bytes and the latency TX and RX buffers are 4MB each */
+#define PKG_SIZE_LIMIT_MIN 16
+#define PKG_SIZE_LIMIT_MAX (4 * 1024 * 1024)
+
+/* Maximum number of package sizes in a sweep */
+#define DEMO_SIZES_MAX 16
+
+/* Maximum number of warm-up or measured runs of the suite */
+#define DEMO_RUNS_MAX 16
+
+/* Maximum number of messages in flight of the pipelined latency */
+#define PIPE_WINDOW_MAX 64
+
+/**
+ * runtime parameters, same layout as the shared memory parameter block
+ */
+struct demo_params {
+	uint32_t magic; /* DEMO_PARAMS_MAGIC */
+	uint32_t version; /* DEMO_PARAMS_VERSION */
+	uint32_t iterations; /* iterations of the latency demos */
+	uint32_t pkg_size_min; /* minimum package size */
+	uint32_t pkg_size_max; /* maximum package size */
+	uint32_t buf_size_max; /* size of the private buffers */
+	uint32_t total_data_size; /* data sent per package size */
+	uint32_t flags; /* DEMO_PARAMS_* flags */
+	uint32_t num_sizes; /* number of package sizes */
+	uint32_t sizes[DEMO_SIZES_MAX]; /* package sizes */
+	uint32_t soak_secs; /* IPI latency soak duration, 0 for none */
+	uint32_t soak_period; /* period of the soak summaries, seconds */
+	uint32_t evtchn_port; /* event channel port of the kicks, 0 for IPI */
+	uint32_t tests; /* DEMO_TEST_MASK_* tests of the suite, 0 for default */
+	uint32_t warmup_runs; /* warm-up runs of the suite */
+	uint32_t runs; /* measured runs of the suite */
+	uint32_t pipe_window; /* largest pipelined latency window, 0 for none */
+};
+
+extern struct demo_params demo_params; /* parameters in use */
+
+/**
+ * @brief demo_params_load() - Load the runtime parameters
+ *        Read the parameter block from the shared memory and validate it.
+ *        demo_params keeps the built-in defaults if the block is invalid.
+ *
+ * @param[in] io - shared memory i/o region
+ * @return - 0 if the shared memory parameters are used, -ENOENT if the
+ *           block is not filled, -EINVAL if a value is out of range.
+ */
+int demo_params_load(struct metal_io_region *io);
+
+/**
+ * @brief demo_params_print() - print the runtime parameters in use
+ */
+void demo_params_print(void);
+
+#endif /* __DEMO_PARAMS_H__ */
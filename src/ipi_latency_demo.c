@@ -10,19 +10,31 @@
  * This demo does the follwing steps:
  *
  *  1. Get the shared memory device I/O region.
- *  1. Get the TTC timer device I/O region.
+ *  1. Get the TTC timer device I/O region, initialize the timestamp source.
  *  2. Get the IPI device I/O region.
  *  3. Register IPI interrupt handler.
  *  4. Write to shared memory to indicate demo starts
- *  5. Reset the APU to RPU TTC counter and then kick IPI to notify the
+ *  5. Start the APU to RPU interval and then kick IPI to notify the
  *     remote.
  *  6. When it receives IPI interrupt, the IPI interrupt handler to stop
- *     the RPU to APU TTC counter.
+ *     the RPU to APU interval.
  *  7. Accumulate APU to RPU and RPU to APU counter values.
- *  8. Repeat step 5, 6 and 7 for 1000 times
- *  9. Write shared memory to indicate RPU about demo finishes and kick
+ *  8. Repeat step 5, 6 and 7 for 1000 times, first through the libmetal
+ *     ISR dispatch, then again through the fast path ISR connected
+ *     directly to the GIC, see sys_ipi_set_fast_path().
+ *  9. Profile the notification costs in system count ticks: the kick,
+ *     the wake-up from the IPI handler to the waiter, the round trip and
+ *     an IPI and a GIC register access, for the IPI backend, then for the
+ *     Xen event channel backend if a port is set. The sequence is the
+ *     same in NOXEN and Xen builds, the hypervisor overhead of each
+ *     operation is the difference between the records of the two builds,
+ *     see RESULT_XEN.
+ * 10. Write shared memory to indicate RPU about demo finishes and kick
  *     IPI to notify.
- * 10. Clean up: disable IPI interrupt, deregister the IPI interrupt handler.
+ * 11. If the soak duration parameter is set, run the same exchange for
+ *     that duration (soak mode), printing a summary of each period and
+ *     keeping the SOAK_OUTLIERS_MAX slowest round trips.
+ * 12. Clean up: disable IPI interrupt, deregister the IPI interrupt handler.
  */
 
 #include <unistd.h>
@@ -35,80 +47,58 @@
 #include <metal/irq.h>
 #include <metal/time.h>
 #include "common.h"
-
-#define TTC_CNT_APU_TO_RPU 2 /* APU to RPU TTC counter ID */
-#define TTC_CNT_RPU_TO_APU 3 /* RPU to APU TTC counter ID */
-
-#define TTC_CLK_FREQ_HZ	100000000
-#define NS_PER_SEC     1000000000
-#define NS_PER_TTC_TICK (NS_PER_SEC / TTC_CLK_FREQ_HZ)
-
-/* Shared memory offset */
-#define SHM_DEMO_CNTRL_OFFSET    0x0
+#include "timestamp.h"
+#include "demo_params.h"
+#include "results.h"
+#include "notify.h"
+#include "shm_layout.h"
+#include "bench.h"
+#include "cold.h"
+#include "ocm.h"
 
 #define DEMO_STATUS_IDLE         0x0
 #define DEMO_STATUS_START        0x1 /* Status value to indicate demo start */
 
-#define ITERATIONS 1000
+/* How to wait for the RPU kick, see enum wait_policy */
+#ifndef IPI_LATENCY_WAIT_POLICY
+#define IPI_LATENCY_WAIT_POLICY WAIT_POLICY_WFI
+#endif
+
+/* Number of slowest round trips kept by the soak mode */
+#define SOAK_OUTLIERS_MAX        32
 
 struct channel_s {
 	struct metal_io_region *ipi_io; /* IPI metal i/o region */
 	struct metal_io_region *shm_io; /* Shared memory metal i/o region */
 	struct metal_io_region *ttc_io; /* TTC metal i/o region */
+	struct ts_timer ts; /* timestamp source */
 	uint32_t ipi_mask; /* APU IPI mask */
+	enum wait_policy wait_policy; /* how to wait for the remote kick */
 	atomic_flag remote_nkicked; /* 0 - kicked from remote */
+	uint64_t irq_cnt; /* system count of the last handled kick */
 };
 
-/**
- * @brief read_timer() - return TTC counter value
- *
- * @param[in] ttc_io - TTC timer i/o region
- * @param[in] cnt_id - counter ID
- */
-static inline uint32_t read_timer(struct metal_io_region *ttc_io,
-				unsigned long cnt_id)
-{
-	unsigned long offset = XTTCPS_CNT_VAL_OFFSET +
-				XTTCPS_CNT_OFFSET(cnt_id);
-
-	return metal_io_read32(ttc_io, offset);
-}
-
-/**
- * @brief reset_timer() - function to reset TTC counter
- *        Set the RST bit in the Count Control Reg.
- *
- * @param[in] ttc_io - TTC timer i/o region
- * @param[in] cnt_id - counter id
- */
-static inline void reset_timer(struct metal_io_region *ttc_io,
-				unsigned long cnt_id)
-{
-	uint32_t val;
-	unsigned long offset = XTTCPS_CNT_CNTRL_OFFSET +
-				XTTCPS_CNT_OFFSET(cnt_id);
-
-	val = XTTCPS_CNT_CNTRL_RST_MASK;
-	metal_io_write32(ttc_io, offset, val);
-}
+static const char *notify_op_names[NOTIFY_OP_NUM] = {
+	[NOTIFY_OP_KICK] = "kick",
+	[NOTIFY_OP_WAKE] = "wake-up",
+	[NOTIFY_OP_ROUND_TRIP] = "round trip",
+	[NOTIFY_OP_IPI_READ] = "IPI register read",
+	[NOTIFY_OP_GIC_READ] = "GIC register read",
+};
 
 /**
- * @brief stop_timer() - function to stop TTC counter
- *        Set the disable bit in the Count Control Reg.
- *
- * @param[in] ttc_io - TTC timer i/o region
- * @param[in] cnt_id - counter id
+ * soak mode outlier, one of the slowest round trips
  */
-static inline void stop_timer(struct metal_io_region *ttc_io,
-				unsigned long cnt_id)
-{
-	uint32_t val;
-	unsigned long offset = XTTCPS_CNT_CNTRL_OFFSET +
-				XTTCPS_CNT_OFFSET(cnt_id);
+struct soak_outlier {
+	uint64_t iter; /* iteration index, from 0 */
+	uint64_t cnt; /* system count at the start of the iteration */
+	uint64_t a2r; /* APU to RPU timestamp ticks */
+	uint64_t r2a; /* RPU to APU timestamp ticks */
+};
 
-	val = XTTCPS_CNT_CNTRL_DIS_MASK;
-	metal_io_write32(ttc_io, offset, val);
-}
+static struct soak_outlier soak_outliers[SOAK_OUTLIERS_MAX];
+/* An hours long soak takes more than 2^32 round trips */
+static struct metal_hist64 soak_a2r_hist, soak_r2a_hist, soak_win_hist;
 
 /**
  * @brief ipi_irq_handler() - IPI interrupt handler
@@ -124,19 +114,22 @@ static inline void stop_timer(struct metal_io_region *ttc_io,
  *           not the interrupt it expected.
  *
  */
-static int ipi_irq_handler (int vect_id, void *priv)
+static OCM_TEXT int ipi_irq_handler (int vect_id, void *priv)
 {
 	struct channel_s *ch = (struct channel_s *)priv;
 	uint32_t val;
 	(void)vect_id;
 
+	trace_event(TRACE_IRQ_ENTER, vect_id);
 	if (ch) {
 		val = metal_io_read32(ch->ipi_io, IPI_ISR_OFFSET);
 		if (val & ch->ipi_mask) {
 			/* stop RPU -> APU timer */
-			stop_timer(ch->ttc_io, TTC_CNT_RPU_TO_APU);
+			ts_stop(&ch->ts, TS_RPU_TO_APU);
 			metal_io_write32(ch->ipi_io, IPI_ISR_OFFSET, ch->ipi_mask);
+			ch->irq_cnt = ts_now();
 			atomic_flag_clear(&ch->remote_nkicked);
+			trace_event(TRACE_FLAG_CLEAR, vect_id);
 			return METAL_IRQ_HANDLED;
 		}
 	}
@@ -144,24 +137,24 @@ static int ipi_irq_handler (int vect_id, void *priv)
 }
 
 /**
- * @brief ttc_vs_clock_gettime() sanity check: TTC and CLOCK_MONOTONIC
- *	  Compare TTC counts with the CLOCK_MONOTONIC over sleep(1).
+ * @brief ttc_vs_clock_gettime() sanity check: timestamps and CLOCK_MONOTONIC
+ *	  Compare timestamp counts with the CLOCK_MONOTONIC over sleep(1).
  *	  They should be very close, e.g. within 6 us for 100 MHz TTC
  *
- * @param[in] ch - channel information for the ttc timer
+ * @param[in] ch - channel information for the timestamp source
  */
 
 //static void ttc_vs_clock_gettime(struct channel_s *ch)
 //{
 //	uint64_t ttc, lnx = metal_get_timestamp();
 //
-//	reset_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU);
+//	ts_start(&ch->ts, TS_APU_TO_RPU);
 //	sleep(1);
-//	stop_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU);
+//	ts_stop(&ch->ts, TS_APU_TO_RPU);
 //	lnx = metal_get_timestamp() - lnx;
-//	ttc = NS_PER_TTC_TICK * read_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU);
-//	LPRINTF("sleep(1) check: TTC= %lu / CLOCK_MONOTONIC= %lu = %.2f\n",
-//		ttc, lnx, lnx ? (ttc/(float)lnx) : 0);
+//	ttc = ts_ticks_to_ns(ts_read(&ch->ts, TS_APU_TO_RPU));
+//	LPRINTF("sleep(1) check: %s= %lu / CLOCK_MONOTONIC= %lu = %.2f\n",
+//		ts_backend_name(), ttc, lnx, lnx ? (ttc/(float)lnx) : 0);
 //
 //	//Read Clock Control Register TTC0_ID_3
 //	unsigned long offset;
@@ -172,11 +165,429 @@ static int ipi_irq_handler (int vect_id, void *priv)
 //}
 
 /**
- * @brief measure_ipi_latency() - Measure latency of IPI
+ * @brief ipi_round_trip() - Kick the remote and wait for its kick back
+ *
+ * @param[in] ch - channel information
+ * @param[out] a2r - APU to RPU timestamp ticks
+ * @param[out] r2a - RPU to APU timestamp ticks
+ */
+static OCM_TEXT void ipi_round_trip(struct channel_s *ch, uint64_t *a2r,
+				    uint64_t *r2a)
+{
+	/* Start APU to RPU interval */
+	ts_start(&ch->ts, TS_APU_TO_RPU);
+	/* Kick IPI to notify the remote */
+	trace_event(TRACE_KICK, ch->ipi_mask);
+	notify_kick(ch->ipi_io, ch->ipi_mask);
+	/* irq handler stops timer for rpu->apu irq */
+	notify_wait(&ch->remote_nkicked, ch->wait_policy);
+	/* there is no irq handler with the doorbells */
+	if (notify_backend == NOTIFY_BACKEND_DOORBELL)
+		ts_stop(&ch->ts, TS_RPU_TO_APU);
+
+	*a2r = ts_read(&ch->ts, TS_APU_TO_RPU);
+	*r2a = ts_read(&ch->ts, TS_RPU_TO_APU);
+}
+
+/**
+ * @brief soak_add_outlier() - Keep a round trip if it is one of the
+ *        SOAK_OUTLIERS_MAX slowest so far
+ *
+ * @param[in/out] num - number of outliers kept
+ * @param[in] o - round trip
+ * @return - the round trip ticks a new round trip must exceed to be kept.
+ */
+static uint64_t soak_add_outlier(uint32_t *num, const struct soak_outlier *o)
+{
+	uint32_t i, min = 0;
+
+	if (*num < SOAK_OUTLIERS_MAX) {
+		soak_outliers[(*num)++] = *o;
+		if (*num < SOAK_OUTLIERS_MAX)
+			return 0;
+	} else {
+		for (i = 1; i < SOAK_OUTLIERS_MAX; i++) {
+			if (soak_outliers[i].a2r + soak_outliers[i].r2a <
+			    soak_outliers[min].a2r + soak_outliers[min].r2a)
+				min = i;
+		}
+		soak_outliers[min] = *o;
+	}
+	/* New floor of the table */
+	min = 0;
+	for (i = 1; i < SOAK_OUTLIERS_MAX; i++) {
+		if (soak_outliers[i].a2r + soak_outliers[i].r2a <
+		    soak_outliers[min].a2r + soak_outliers[min].r2a)
+			min = i;
+	}
+	return soak_outliers[min].a2r + soak_outliers[min].r2a;
+}
+
+/**
+ * @brief soak_print_outliers() - Print the outliers, slowest first
+ *
+ * @param[in] num - number of outliers kept
+ * @param[in] start - system count at the start of the soak
+ */
+static void soak_print_outliers(uint32_t num, uint64_t start)
+{
+	struct soak_outlier tmp;
+	uint32_t i, j;
+
+	for (i = 0; i < num; i++) {
+		for (j = i + 1; j < num; j++) {
+			if (soak_outliers[j].a2r + soak_outliers[j].r2a >
+			    soak_outliers[i].a2r + soak_outliers[i].r2a) {
+				tmp = soak_outliers[i];
+				soak_outliers[i] = soak_outliers[j];
+				soak_outliers[j] = tmp;
+			}
+		}
+	}
+	RPRINTF("soak outliers, %s ticks, system count at %lu Hz:\n",
+		ts_backend_name(), ts_cnt_freq());
+	for (i = 0; i < num; i++)
+		RPRINTF("  iteration %lu at %lu (+%lu ms): "
+			"APU to RPU %lu, RPU to APU %lu\n",
+			soak_outliers[i].iter, soak_outliers[i].cnt,
+			ts_cnt_to_ns(soak_outliers[i].cnt - start) / 1000000,
+			soak_outliers[i].a2r, soak_outliers[i].r2a);
+}
+
+/**
+ * @brief soak_ipi_latency() - Measure latency of IPI for a long time
+ *        Do the measure_ipi_latency() exchange for soak_secs seconds. Every
+ *        soak_period seconds, print a summary of the round trips of the
+ *        period. Keep the SOAK_OUTLIERS_MAX slowest round trips with their
+ *        iteration index and system count, so they can be correlated with
+ *        external events. The system count is the same time base as the
+ *        RPU and the other APU cores.
+ *        It runs within the measure_ipi_latency() session, the remote
+ *        keeps answering the kicks until the demo end status.
+ *
+ * @param[in] ch - channel information
+ * @return - 0 on success, error code if failure.
+ */
+static int soak_ipi_latency(struct channel_s *ch)
+{
+	struct metal_stat a2r = STAT_INIT;
+	struct metal_stat r2a = STAT_INIT;
+	struct metal_stat win = STAT_INIT;
+	struct soak_outlier o;
+	struct demo_result res;
+	struct metal_pctl pctl;
+	uint64_t freq = ts_cnt_freq();
+	uint64_t start, now, end, next, period;
+	uint64_t iter = 0, floor = 0, rtt;
+	uint32_t num = 0, win_outliers = 0;
+	static struct metal_hist hist;
+
+	LPRINTF("Starting IPI latency soak for %u s\n", demo_params.soak_secs);
+
+	reset_hist64(&soak_a2r_hist);
+	reset_hist64(&soak_r2a_hist);
+	reset_hist64(&soak_win_hist);
+	period = (uint64_t)demo_params.soak_period * freq;
+	start = ts_now();
+	end = start + (uint64_t)demo_params.soak_secs * freq;
+	next = start + period;
+	for (now = start; now < end; iter++) {
+		ipi_round_trip(ch, &o.a2r, &o.r2a);
+		rtt = o.a2r + o.r2a;
+		update_stat(&a2r, o.a2r);
+		update_stat(&r2a, o.r2a);
+		update_hist64(&soak_a2r_hist, o.a2r);
+		update_hist64(&soak_r2a_hist, o.r2a);
+		update_stat(&win, rtt);
+		update_hist64(&soak_win_hist, rtt);
+		if (rtt > floor) {
+			o.iter = iter;
+			o.cnt = now;
+			floor = soak_add_outlier(&num, &o);
+			win_outliers++;
+		}
+
+		now = ts_now();
+		if (now >= next) {
+			/* Rolling summary of the period */
+			hist64_percentiles(&soak_win_hist, win.st_max, &pctl);
+			RPRINTF("soak +%lu s: %lu round trips [%lu, %lu] "
+				"avg: %lu ns, p99: %lu ns, new outliers: %u\n",
+				(now - start) / freq, win.st_cnt,
+				win.st_min, win.st_max,
+				ts_ticks_to_ns(win.st_sum) / win.st_cnt,
+				ts_ticks_to_ns(pctl.p99), win_outliers);
+			win = (struct metal_stat)STAT_INIT;
+			reset_hist64(&soak_win_hist);
+			win_outliers = 0;
+			next += period;
+		}
+	}
+
+	RPRINTF("soak: %lu iterations\n", iter);
+	RPRINTF("APU to RPU: [%lu, %lu] avg: %lu ns\n",
+		a2r.st_min, a2r.st_max, ts_ticks_to_ns(a2r.st_sum) / iter);
+	RPRINTF("RPU to APU: [%lu, %lu] avg: %lu ns\n",
+		r2a.st_min, r2a.st_max, ts_ticks_to_ns(r2a.st_sum) / iter);
+	soak_print_outliers(num, start);
+
+	/* report percentiles and export the results */
+	memset(&res, 0, sizeof(res));
+	res.test = DEMO_TEST_IPI_SOAK;
+	res.dir = TS_APU_TO_RPU;
+	res.stat = a2r;
+	hist64_percentiles(&soak_a2r_hist, a2r.st_max, &res.pctl);
+	print_pctl("soak APU to RPU", &res.pctl);
+	res.hist_shift = hist64_export(&soak_a2r_hist, &hist);
+	results_add(&res, &hist);
+	res.dir = TS_RPU_TO_APU;
+	res.stat = r2a;
+	hist64_percentiles(&soak_r2a_hist, r2a.st_max, &res.pctl);
+	print_pctl("soak RPU to APU", &res.pctl);
+	res.hist_shift = hist64_export(&soak_r2a_hist, &hist);
+	results_add(&res, &hist);
+	LPRINTF("Finished IPI latency soak\n");
+	return 0;
+}
+
+/**
+ * @brief measure_ipi_cold() - Measure round trips from cold, see cold.h
+ *
+ * @param[in] ch - channel information
+ * @param[out] cold - cold statistics per mode, COLD_MODE_WARM is unused
+ */
+static void measure_ipi_cold(struct channel_s *ch,
+			     struct cold_stat cold[COLD_MODES_NUM])
+{
+	uint64_t a2r_val, r2a_val;
+	enum cold_mode mode;
+	uint32_t i;
+
+	for (mode = COLD_MODE_EVICT; mode < COLD_MODES_NUM; mode++) {
+		cold_stat_init(&cold[mode], mode);
+		for (i = 0; i < COLD_ITERATIONS; i++) {
+			cold_prepare(mode);
+			ipi_round_trip(ch, &a2r_val, &r2a_val);
+			cold_stat_update(&cold[mode], a2r_val, r2a_val);
+		}
+	}
+}
+
+/**
+ * @brief measure_ipi_path() - Measure latency of IPI through one handler
  *        Repeatedly kick IPI to notify the remote and then wait for IPI kick
  *        from RPU and measure the latency. Similarly, measure the latency
  *        from RPU to APU. Each iteration, record this latency and after the
  *        loop has finished, report the total latency in nanseconds.
+ *        With DEMO_PARAMS_COLD, the round trips from cold are measured
+ *        next and reported apart.
+ *
+ * @param[in] ch - channel information
+ * @param[in] fast - 1 to take the IPI in the fast path ISR, 0 through the
+ *                   libmetal ISR dispatch and ipi_irq_handler()
+ * @return - 0 on success, error code if failure.
+ */
+static int measure_ipi_path(struct channel_s *ch, int fast)
+{
+	struct metal_stat a2r = STAT_INIT;
+	struct metal_stat r2a = STAT_INIT;
+	static struct metal_hist a2r_hist, r2a_hist;
+	struct cold_stat cold[COLD_MODES_NUM];
+	struct demo_result res;
+	uint64_t a2r_val, r2a_val;
+	enum cold_mode mode;
+	const char *path = fast ? "fast path ISR" :
+			   notify_backend == NOTIFY_BACKEND_DOORBELL ?
+			   "no ISR" : "libmetal ISR";
+	//uint64_t delta_ns;
+	uint32_t i;
+	int ret;
+
+	if (fast) {
+		ret = sys_ipi_set_fast_path(&ch->remote_nkicked, &ch->ts);
+		if (ret) {
+			LPERROR("Failed to connect the IPI fast path.\n");
+			return ret;
+		}
+	}
+
+	reset_hist(&a2r_hist);
+	reset_hist(&r2a_hist);
+	//delta_ns = metal_get_timestamp();
+	for ( i = 1; i <= demo_params.iterations; i++) {
+		ipi_round_trip(ch, &a2r_val, &r2a_val);
+		update_stat(&a2r, a2r_val);
+		update_stat(&r2a, r2a_val);
+		update_hist(&a2r_hist, a2r_val);
+		update_hist(&r2a_hist, r2a_val);
+	}
+	//delta_ns = metal_get_timestamp() - delta_ns;
+	if (demo_params.flags & DEMO_PARAMS_COLD)
+		measure_ipi_cold(ch, cold);
+
+	if (fast)
+		sys_ipi_set_fast_path(NULL, NULL);
+
+	/* report avg latencies */
+//	LPRINTF("IPI latency: %i iterations took %lu ns (CLOCK_MONOTONIC)\n",
+//		demo_params.iterations, delta_ns);
+	RPRINTF("[min,max] are in %s ticks: %lu Hz\n",
+		ts_backend_name(), ts_freq());
+	RPRINTF("wait policy: %s, %s\n", notify_wait_name(ch->wait_policy),
+		path);
+	RPRINTF("APU to RPU: [%lu, %lu] avg: %lu ns\n",
+		a2r.st_min, a2r.st_max,
+		ts_ticks_to_ns(a2r.st_sum) / demo_params.iterations);
+	RPRINTF("RPU to APU: [%lu, %lu] avg: %lu ns\n",
+		r2a.st_min, r2a.st_max,
+		ts_ticks_to_ns(r2a.st_sum) / demo_params.iterations);
+
+	/* report percentiles and export the results */
+	memset(&res, 0, sizeof(res));
+	res.test = DEMO_TEST_IPI_LATENCY;
+	res.flags = fast ? RESULT_FAST_ISR : 0;
+	res.dir = TS_APU_TO_RPU;
+	res.stat = a2r;
+	hist_percentiles(&a2r_hist, a2r.st_max, &res.pctl);
+	print_pctl("APU to RPU", &res.pctl);
+	results_add(&res, &a2r_hist);
+	res.dir = TS_RPU_TO_APU;
+	res.stat = r2a;
+	hist_percentiles(&r2a_hist, r2a.st_max, &res.pctl);
+	print_pctl("RPU to APU", &res.pctl);
+	results_add(&res, &r2a_hist);
+
+	if (!(demo_params.flags & DEMO_PARAMS_COLD))
+		return 0;
+	RPRINTF("cold round trips, %s:\n", path);
+	for (mode = COLD_MODE_EVICT; mode < COLD_MODES_NUM; mode++)
+		cold_report(&res, &cold[mode],
+			    ts_ticks_to_ns(a2r.st_sum + r2a.st_sum) /
+			    demo_params.iterations);
+	return 0;
+}
+
+/**
+ * @brief measure_notify_backend() - Profile the notification costs with
+ *        the backend in use, through the libmetal ISR
+ *
+ * @param[in] ch - channel information
+ * @param[in] access - 1 to also measure the IPI and GIC register reads
+ * @return - 0 on success, error code if failure.
+ */
+static int measure_notify_backend(struct channel_s *ch, int access)
+{
+	static struct metal_hist hist[NOTIFY_OP_NUM];
+	struct metal_stat stat[NOTIFY_OP_NUM];
+	struct demo_result res;
+	uint64_t start, kick, end;
+	uint32_t i, op;
+	int ret;
+
+	for (op = NOTIFY_OP_KICK; op < NOTIFY_OP_NUM; op++) {
+		stat[op] = (struct metal_stat)STAT_INIT;
+		reset_hist(&hist[op]);
+	}
+	for (i = 0; i < demo_params.iterations; i++) {
+		if (access) {
+			start = ts_now();
+			(void)metal_io_read32(ch->ipi_io, IPI_ISR_OFFSET);
+			end = ts_now() - start;
+			update_stat(&stat[NOTIFY_OP_IPI_READ], end);
+			update_hist(&hist[NOTIFY_OP_IPI_READ], end);
+			start = ts_now();
+			sys_gic_read();
+			end = ts_now() - start;
+			update_stat(&stat[NOTIFY_OP_GIC_READ], end);
+			update_hist(&hist[NOTIFY_OP_GIC_READ], end);
+		}
+
+		start = ts_now();
+		ret = notify_kick(ch->ipi_io, ch->ipi_mask);
+		kick = ts_now();
+		if (ret) {
+			LPERROR("Failed to kick with the %s: %d\n",
+				notify_backend_name(notify_backend), ret);
+			return ret;
+		}
+		notify_wait(&ch->remote_nkicked, ch->wait_policy);
+		end = ts_now();
+
+		update_stat(&stat[NOTIFY_OP_KICK], kick - start);
+		update_hist(&hist[NOTIFY_OP_KICK], kick - start);
+		/* The doorbell wait has no irq handler to wake it up */
+		if (notify_backend != NOTIFY_BACKEND_DOORBELL) {
+			update_stat(&stat[NOTIFY_OP_WAKE], end - ch->irq_cnt);
+			update_hist(&hist[NOTIFY_OP_WAKE], end - ch->irq_cnt);
+		}
+		update_stat(&stat[NOTIFY_OP_ROUND_TRIP], end - start);
+		update_hist(&hist[NOTIFY_OP_ROUND_TRIP], end - start);
+	}
+
+	RPRINTF("notification costs, %s backend, wait policy: %s\n",
+		notify_backend_name(notify_backend),
+		notify_wait_name(ch->wait_policy));
+	memset(&res, 0, sizeof(res));
+	res.test = DEMO_TEST_NOTIFY_COST;
+	for (op = NOTIFY_OP_KICK; op < NOTIFY_OP_NUM; op++) {
+		if (!stat[op].st_cnt)
+			continue;
+		RPRINTF("  %s: [%lu, %lu] avg: %lu ns\n", notify_op_names[op],
+			stat[op].st_min, stat[op].st_max,
+			ts_cnt_to_ns(stat[op].st_sum) / stat[op].st_cnt);
+		res.op = op;
+		res.stat = stat[op];
+		hist_percentiles(&hist[op], stat[op].st_max, &res.pctl);
+		print_pctl(notify_op_names[op], &res.pctl);
+		results_add(&res, &hist[op]);
+	}
+	return 0;
+}
+
+/**
+ * @brief measure_notify_cost() - Profile the notification costs of each
+ *        backend, see measure_notify_backend(). The register accesses do
+ *        not depend on the backend, they are measured with the IPI one.
+ *        The backend selected at startup is restored. The doorbell
+ *        backend is the only one profiled when it is selected.
+ *
+ * @param[in] ch - channel information
+ * @return - 0 on success, error code if failure.
+ */
+static int measure_notify_cost(struct channel_s *ch)
+{
+	enum notify_backend backend = notify_backend;
+	uint32_t major, minor;
+	int ret;
+
+	if (!xen_version(&major, &minor))
+		LPRINTF("Starting notification costs under Xen %u.%u\n",
+			major, minor);
+	else
+		LPRINTF("Starting notification costs without hypervisor\n");
+	LPRINTF("[min,max] are in system count ticks: %lu Hz\n",
+		ts_cnt_freq());
+
+	/* The remote kicks back with the doorbell for the whole run, the
+	 * backend cannot change */
+	if (backend == NOTIFY_BACKEND_DOORBELL)
+		return measure_notify_backend(ch, 1);
+
+	notify_set_backend(NOTIFY_BACKEND_IPI, 0);
+	ret = measure_notify_backend(ch, 1);
+	if (!ret && demo_params.evtchn_port &&
+	    !notify_set_backend(NOTIFY_BACKEND_EVTCHN,
+				demo_params.evtchn_port))
+		ret = measure_notify_backend(ch, 0);
+	notify_set_backend(backend, notify_evtchn_port);
+	return ret;
+}
+
+/**
+ * @brief measure_ipi_latency() - Measure latency of IPI
+ *        Measure the latencies through the libmetal ISR, then through the
+ *        fast path ISR, see measure_ipi_path(). With the doorbell backend
+ *        there is no interrupt, the doorbell path is measured once.
  *        Notes:
  *        - RPU will repeatedly wait for IPI from APU until APU
  *          notifies remote demo has finished by setting the value in the
@@ -188,87 +599,52 @@ static int ipi_irq_handler (int vect_id, void *priv)
  */
 static int measure_ipi_latency(struct channel_s *ch)
 {
-	struct metal_stat a2r = STAT_INIT;
-	struct metal_stat r2a = STAT_INIT;
-	//uint64_t delta_ns;
-	int i;
+	int ret;
 
 	LPRINTF("Starting IPI latency\n");
 	//ttc_vs_clock_gettime(ch);
 	/* write to shared memory to indicate demo has started */
-	metal_io_write32(ch->shm_io, SHM_DEMO_CNTRL_OFFSET, DEMO_STATUS_START);
+	metal_io_write32(ch->shm_io, SHM_DEMO_STATUS_OFFSET, DEMO_STATUS_START);
+	shm_cache_flush(ch->shm_io, SHM_DEMO_STATUS_OFFSET, sizeof(uint32_t));
 
-	//delta_ns = metal_get_timestamp();
-	for ( i = 1; i <= ITERATIONS; i++) {
-		/* Reset TTC counter */
-		reset_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU);
-		/* Kick IPI to notify the remote */
-		metal_io_write32(ch->ipi_io, IPI_TRIG_OFFSET, ch->ipi_mask);
-		/* irq handler stops timer for rpu->apu irq */
-		wait_for_notified(&ch->remote_nkicked);
-
-		update_stat(&a2r, read_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU));
-		update_stat(&r2a, read_timer(ch->ttc_io, TTC_CNT_RPU_TO_APU));
-	}
-	//delta_ns = metal_get_timestamp() - delta_ns;
+	ret = measure_ipi_path(ch, 0);
+	if (!ret && notify_backend != NOTIFY_BACKEND_DOORBELL)
+		ret = measure_ipi_path(ch, 1);
+	if (!ret)
+		ret = measure_notify_cost(ch);
+
+	/* Keep the remote going for the soak mode */
+	if (!ret && demo_params.soak_secs)
+		soak_ipi_latency(ch);
 
 	/* write to shared memory to indicate demo has finished */
-	metal_io_write32(ch->shm_io, SHM_DEMO_CNTRL_OFFSET, 0);
+	metal_io_write32(ch->shm_io, SHM_DEMO_STATUS_OFFSET, 0);
+	shm_cache_flush(ch->shm_io, SHM_DEMO_STATUS_OFFSET, sizeof(uint32_t));
 	/* Kick IPI to notify the remote */
-	metal_io_write32(ch->ipi_io, IPI_TRIG_OFFSET, ch->ipi_mask);
+	notify_kick(ch->ipi_io, ch->ipi_mask);
 
-	/* report avg latencies */
-//	LPRINTF("IPI latency: %i iterations took %lu ns (CLOCK_MONOTONIC)\n",
-//		ITERATIONS, delta_ns);
-	LPRINTF("TTC [min,max] are in TTC ticks: %d ns per tick\n",
-		NS_PER_TTC_TICK);
-	LPRINTF("APU to RPU: [%lu, %lu] avg: %lu ns\n",
-		a2r.st_min, a2r.st_max,
-		a2r.st_sum * NS_PER_TTC_TICK / ITERATIONS);
-	LPRINTF("RPU to APU: [%lu, %lu] avg: %lu ns\n",
-		r2a.st_min, r2a.st_max,
-		r2a.st_sum * NS_PER_TTC_TICK / ITERATIONS);
 	LPRINTF("Finished IPI latency\n");
-	return 0;
+	return ret;
 }
 
-int ipi_latency_demo()
+int ipi_latency_demo(struct bench_channel *bch)
 {
-	struct channel_s ch;
-	int ipi_irq;
+	static struct channel_s ch OCM_BSS;
 	int ret = 0;
 	//asm volatile ("hvc 0xfffd");
 	print_demo("IPI latency");
 	memset(&ch, 0, sizeof(ch));
 
-	/* Get shared memory device IO region */
-	if (!shm_dev) {
-		ret = -ENODEV;
-		goto out;
-	}
-
-	/* Get SHM IO region */
-	ch.shm_io = metal_device_io_region(shm_dev, 0);
-	if (!ch.shm_io) {
-		LPERROR("Failed to map io region for %s.\n", shm_dev->name);
-		ret = -ENODEV;
-		goto out;
-	}
-
-	/* Get TTC IO region */
-	ch.ttc_io = metal_device_io_region(ttc_dev, 0);
-	if (!ch.ttc_io) {
-		LPERROR("Failed to map io region for %s.\n", ttc_dev->name);
-		ret = -ENODEV;
-		goto out;
-	}
+	/* The regions are looked up once for all the tests */
+	ch.shm_io = bch->shm_io;
+	ch.ttc_io = bch->ttc_io;
+	ch.ipi_io = bch->ipi_io;
 
-	/* Get IPI device IO region */
-	ch.ipi_io = metal_device_io_region(ipi_dev, 0);
-	if (!ch.ipi_io) {
-		LPERROR("Failed to map io region for %s.\n", ipi_dev->name);
-		ret = -ENODEV;
-		goto out;
+	/* Initialize the timestamp source */
+	ret = ts_init(&ch.ts, ch.ttc_io, ch.shm_io);
+	if (ret) {
+		LPERROR("Failed to initialize the timestamp source.\n");
+		return ret;
 	}
 
 	/* disable IPI interrupt */
@@ -277,30 +653,24 @@ int ipi_latency_demo()
 	metal_io_write32(ch.ipi_io, IPI_ISR_OFFSET, IPI_MASK);
 
 	ch.ipi_mask = IPI_MASK;
+	ch.wait_policy = IPI_LATENCY_WAIT_POLICY;
 
-	/* Get the IPI IRQ from the opened IPI device */
-	ipi_irq = (intptr_t)ipi_dev->irq_info;
-
-	/* Register IPI irq handler */
-	metal_irq_register(ipi_irq, ipi_irq_handler, &ch);
-	metal_irq_enable(ipi_irq);
+	/* Attach the IPI irq handler to the channel */
+	bench_irq_attach(bch, ipi_irq_handler, &ch);
 
 	/* initialize remote_nkicked */
-	atomic_flag_clear(&ch.remote_nkicked);
-	atomic_flag_test_and_set(&ch.remote_nkicked);
+	notify_reset(&ch.remote_nkicked);
 
 	/* Enable IPI interrupt */
-	metal_io_write32(ch.ipi_io, IPI_IER_OFFSET, IPI_MASK);
+	notify_irq_enable(ch.ipi_io, IPI_MASK);
 
 	/* Run atomic operation demo */
 	ret = measure_ipi_latency(&ch);
 
 	/* disable IPI interrupt */
 	metal_io_write32(ch.ipi_io, IPI_IDR_OFFSET, IPI_MASK);
-	/* unregister IPI irq handler */
-	metal_irq_disable(ipi_irq);
-	metal_irq_unregister(ipi_irq);
+	/* detach IPI irq handler */
+	bench_irq_detach(bch);
 
-out:
 	return ret;
 }
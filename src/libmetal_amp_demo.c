@@ -1,4 +1,7 @@
 #include "common.h"
+#include "results.h"
+#include "bench.h"
+#include "ocm.h"
 #include <stdbool.h>
 
 #ifdef NOXEN
@@ -26,6 +29,7 @@ int main(void)
 	XUartPs_SetBaudRate(&Uart_Ps, 115200);
 #endif
 
+	static struct bench_channel ch OCM_BSS;
 	int ret;
 	LPRINTF("****** libmetal demo client running on DomU baremetal ******\r\n");
 	ret = sys_init();
@@ -35,27 +39,19 @@ int main(void)
 		return ret;
 	}
 
-	ret = ipi_latency_demo();
+	ret = bench_channel_open(&ch);
 	if (ret) {
-		LPERROR("IPI latency demo failed.\n");
-		goto out;
-	}
-
-	sleep(1);
-	ret = shmem_latency_demo();
-	if (ret) {
-		LPERROR("shared memory latency demo failed.\n");
-		goto out;
-	}
-
-	sleep(1);
-	ret = shmem_throughput_demo();
-	if (ret) {
-		LPERROR("shared memory throughput demo failed.\n");
+		LPERROR("Failed to open the demo channel.\n");
 		goto out;
 	}
+	ret = bench_run(&ch);
+	bench_channel_close(&ch);
 
 out:
+	/* The trace is complete before the results are */
+	trace_sync();
+	/* Let the collector read the results */
+	results_complete(ret);
 	sys_cleanup();
 	return ret;
 }
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * notify.c
+ * Notification backends of the kicks to the remote.
+ * See notify.h for the backends.
+ */
+
+#include <errno.h>
+#include <metal/io.h>
+#include "notify.h"
+
+/* Xen hypercalls, from the Xen public headers */
+#define XEN_HYPERCALL_XEN_VERSION    17
+#define XEN_HYPERCALL_EVTCHN_OP      32
+#define XEN_XENVER_VERSION           0
+#define XEN_EVTCHNOP_SEND            4
+
+enum notify_backend notify_backend = NOTIFY_BACKEND_IPI;
+uint32_t notify_evtchn_port;
+struct notify_doorbell notify_db;
+
+static const char *notify_backend_names[NOTIFY_BACKENDS_NUM] = {
+	"IPI", "Xen event channel", "polled doorbell",
+};
+
+/**
+ * @brief notify_publish() - publish the backend in use to the remote
+ */
+static void notify_publish(void)
+{
+	metal_io_write32(notify_db.io,
+			 SHM_DOORBELL_OFFSET + SHM_DOORBELL_MODE_OFFSET,
+			 notify_backend);
+	shm_cache_flush(notify_db.io,
+			SHM_DOORBELL_OFFSET + SHM_DOORBELL_MODE_OFFSET,
+			sizeof(uint32_t));
+}
+
+#ifndef NOXEN
+/**
+ * @brief xen_hypercall2() - call the hypervisor with two arguments
+ *        The AArch64 Xen ABI: hypercall number in x16, arguments from x0,
+ *        result in x0. The hypercall number and the argument registers
+ *        x0 - x5 are clobbered, debug builds of Xen overwrite them.
+ *
+ * @param[in] op - hypercall number
+ * @param[in] a1 - first argument
+ * @param[in] a2 - second argument
+ * @return - result of the hypercall.
+ */
+static int64_t xen_hypercall2(uint64_t op, uint64_t a1, uint64_t a2)
+{
+	register uint64_t x0 asm("x0") = a1;
+	register uint64_t x1 asm("x1") = a2;
+	register uint64_t x16 asm("x16") = op;
+
+	asm volatile("hvc #0xea1"
+		     : "+r" (x0), "+r" (x1), "+r" (x16)
+		     :
+		     : "x2", "x3", "x4", "x5", "memory");
+	return (int64_t)x0;
+}
+#endif
+
+int xen_version(uint32_t *major, uint32_t *minor)
+{
+#ifdef NOXEN
+	(void)major;
+	(void)minor;
+	return -ENODEV;
+#else
+	int64_t ver;
+
+	ver = xen_hypercall2(XEN_HYPERCALL_XEN_VERSION, XEN_XENVER_VERSION, 0);
+	if (ver < 0)
+		return (int)ver;
+	*major = (uint32_t)ver >> 16;
+	*minor = (uint32_t)ver & 0xFFFF;
+	return 0;
+#endif
+}
+
+int xen_evtchn_send(uint32_t port)
+{
+#ifdef NOXEN
+	(void)port;
+	return -ENODEV;
+#else
+	/* struct evtchn_send, in the guest memory, identity mapped */
+	struct {
+		uint32_t port;
+	} send = { port };
+
+	return (int)xen_hypercall2(XEN_HYPERCALL_EVTCHN_OP, XEN_EVTCHNOP_SEND,
+				   (uintptr_t)&send);
+#endif
+}
+
+int notify_init(struct metal_io_region *shm_io)
+{
+	if (!shm_io || SHM_DOORBELL_OFFSET + SHM_DOORBELL_SIZE >
+	    metal_io_region_size(shm_io))
+		return -EINVAL;
+	notify_db.io = shm_io;
+	notify_db.tx_seq = 0;
+	notify_db.rx_seq = 0;
+	metal_io_write32(shm_io, SHM_DOORBELL_OFFSET + SHM_DOORBELL_TX_OFFSET,
+			 0);
+	metal_io_write32(shm_io, SHM_DOORBELL_OFFSET + SHM_DOORBELL_RX_OFFSET,
+			 0);
+	notify_backend = NOTIFY_BACKEND_IPI;
+	notify_publish();
+	shm_cache_flush(shm_io, SHM_DOORBELL_OFFSET, SHM_DOORBELL_SIZE);
+	return 0;
+}
+
+int notify_set_backend(enum notify_backend backend, uint32_t port)
+{
+	uint32_t major, minor;
+
+	switch (backend) {
+	case NOTIFY_BACKEND_IPI:
+		break;
+	case NOTIFY_BACKEND_DOORBELL:
+		if (!notify_db.io)
+			return -ENODEV;
+		break;
+	case NOTIFY_BACKEND_EVTCHN:
+		if (!port)
+			return -EINVAL;
+		if (xen_version(&major, &minor))
+			return -ENODEV;
+		notify_evtchn_port = port;
+		break;
+	default:
+		return -EINVAL;
+	}
+	notify_backend = backend;
+	if (notify_db.io)
+		notify_publish();
+	return 0;
+}
+
+const char *notify_backend_name(enum notify_backend backend)
+{
+	return backend < NOTIFY_BACKENDS_NUM ?
+	       notify_backend_names[backend] : "unknown";
+}
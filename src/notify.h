@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * notify.h
+ * Notification backends of the kicks to and from the remote.
+ *
+ * The default backend writes the IPI trigger register. Under Xen the IPI
+ * registers are mapped in the DomU, but an access may still trap to the
+ * hypervisor, depending on how the domain is configured. The Xen event
+ * channel backend sends an event with the EVTCHNOP_send hypercall on the
+ * port of the demo_params evtchn_port parameter instead. The RPU is not a
+ * Xen domain: the other end of the port is a domain, e.g. Dom0, which
+ * relays the event to the RPU IPI. Kicks from the RPU arrive as the IPI
+ * interrupt with either backend.
+ *
+ * The polled doorbell backend does without interrupts in both directions:
+ * each side kicks by incrementing its sequence counter in the doorbell
+ * block and the other side polls it, with the IPI interrupt disabled. A
+ * wait returns once the counter has changed since the last wait or reset,
+ * several kicks are seen as one, as with the IPI. The APU publishes the
+ * backend in the doorbell block, the RPU reads it when a demo starts and
+ * kicks back with its doorbell if it is NOTIFY_BACKEND_DOORBELL, with the
+ * IPI otherwise. The DEMO_PARAMS_DOORBELL flag selects it at startup.
+ *
+ * Here is the structure of the doorbell block in the shared memory, each
+ * field is on its own cache line:
+ * |0x00 - 0x03 | APU to RPU sequence counter, written by APU |
+ * |0x40 - 0x43 | RPU to APU sequence counter, written by RPU |
+ * |0x80 - 0x83 | backend, enum notify_backend, written by APU |
+ *
+ * The SMP scaling demo has an IPI channel per core and always uses the IPI
+ * backend.
+ */
+
+#ifndef __NOTIFY_H__
+#define __NOTIFY_H__
+
+#include <stdint.h>
+#include <metal/io.h>
+#include "common.h"
+
+/* Doorbell block in the shared memory */
+#define SHM_DOORBELL_OFFSET      0xFD0000
+#define SHM_DOORBELL_TX_OFFSET   0x00 /* APU to RPU sequence counter */
+#define SHM_DOORBELL_RX_OFFSET   0x40 /* RPU to APU sequence counter */
+#define SHM_DOORBELL_MODE_OFFSET 0x80 /* backend in use */
+#define SHM_DOORBELL_SIZE        0xC0
+
+/**
+ * notification backends
+ */
+enum notify_backend {
+	NOTIFY_BACKEND_IPI = 0, /* IPI trigger register write */
+	NOTIFY_BACKEND_EVTCHN = 1, /* Xen event channel hypercall */
+	NOTIFY_BACKEND_DOORBELL = 2, /* polled shared memory doorbells */
+	NOTIFY_BACKENDS_NUM,
+};
+
+/**
+ * local state of the doorbells
+ */
+struct notify_doorbell {
+	struct metal_io_region *io; /* Shared memory metal i/o region */
+	uint32_t tx_seq; /* last APU to RPU sequence written */
+	uint32_t rx_seq; /* last RPU to APU sequence seen */
+};
+
+extern enum notify_backend notify_backend; /* backend in use */
+extern uint32_t notify_evtchn_port; /* port of the event channel backend */
+extern struct notify_doorbell notify_db; /* doorbells */
+
+/**
+ * @brief notify_init() - Initialize the notification backends
+ *        Reset the doorbells and publish the IPI backend.
+ *
+ * @param[in] shm_io - shared memory i/o region
+ * @return - 0 on success, error code if failure.
+ */
+int notify_init(struct metal_io_region *shm_io);
+
+/**
+ * @brief xen_version() - return the version of the hypervisor
+ *
+ * @param[out] major - major version
+ * @param[out] minor - minor version
+ * @return - 0 on success, -ENODEV if built without Xen (NOXEN).
+ */
+int xen_version(uint32_t *major, uint32_t *minor);
+
+/**
+ * @brief xen_evtchn_send() - send an event on an event channel port
+ *
+ * @param[in] port - local port of the event channel
+ * @return - 0 on success, negative Xen error code if failure, -ENODEV if
+ *           built without Xen (NOXEN).
+ */
+int xen_evtchn_send(uint32_t port);
+
+/**
+ * @brief notify_set_backend() - select the backend of the kicks
+ *        It must not be called while a demo waits for a remote kick.
+ *
+ * @param[in] backend - backend
+ * @param[in] port - event channel port of NOTIFY_BACKEND_EVTCHN, not 0
+ * @return - 0 on success, -EINVAL for an invalid backend or port, -ENODEV
+ *           if the event channel backend is selected without Xen or the
+ *           doorbell backend before notify_init().
+ */
+int notify_set_backend(enum notify_backend backend, uint32_t port);
+
+/**
+ * @brief notify_backend_name() - return name of a backend
+ *
+ * @param[in] backend - backend
+ */
+const char *notify_backend_name(enum notify_backend backend);
+
+/**
+ * @brief notify_kick() - kick the remote with the backend in use
+ *
+ * @param[in] ipi_io - IPI metal i/o region
+ * @param[in] mask - IPI mask of the remote
+ * @return - 0 on success, error code if the event could not be sent.
+ */
+static inline int notify_kick(struct metal_io_region *ipi_io, uint32_t mask)
+{
+	unsigned long offset = SHM_DOORBELL_OFFSET + SHM_DOORBELL_TX_OFFSET;
+
+	switch (notify_backend) {
+	case NOTIFY_BACKEND_EVTCHN:
+		return xen_evtchn_send(notify_evtchn_port);
+	case NOTIFY_BACKEND_DOORBELL:
+		/* metal_io_write32() is sequentially consistent, the data
+		 * written before is visible first */
+		metal_io_write32(notify_db.io, offset, ++notify_db.tx_seq);
+		shm_cache_flush(notify_db.io, offset, sizeof(uint32_t));
+		return 0;
+	default:
+		metal_io_write32(ipi_io, IPI_TRIG_OFFSET, mask);
+		return 0;
+	}
+}
+
+/**
+ * @brief notify_doorbell_read() - read the RPU to APU sequence counter
+ */
+static inline uint32_t notify_doorbell_read(void)
+{
+	unsigned long offset = SHM_DOORBELL_OFFSET + SHM_DOORBELL_RX_OFFSET;
+
+	shm_cache_invalidate(notify_db.io, offset, sizeof(uint32_t));
+	return metal_io_read32(notify_db.io, offset);
+}
+
+/**
+ * @brief notify_wait() - wait for a kick from the remote
+ *        Doorbell backend: poll the RPU to APU sequence counter until it
+ *        changes. Other backends: wait for the IPI handler to clear the
+ *        notified flag, see wait_for_notified().
+ *
+ * @param[in] notified - notified flag of the IPI handler
+ * @param[in] policy - how to wait for the IPI handler
+ */
+static inline void notify_wait(atomic_flag *notified,
+			       enum wait_policy policy)
+{
+	uint32_t seq;
+
+	if (notify_backend != NOTIFY_BACKEND_DOORBELL) {
+		wait_for_notified(notified, policy);
+		return;
+	}
+	trace_event(TRACE_WAIT_START, policy);
+	while ((seq = notify_doorbell_read()) == notify_db.rx_seq)
+		metal_cpu_yield();
+	notify_db.rx_seq = seq;
+	trace_event(TRACE_WAIT_END, policy);
+}
+
+/**
+ * @brief notify_reset() - forget the kicks from the remote not waited for
+ *
+ * @param[in] notified - notified flag of the IPI handler
+ */
+static inline void notify_reset(atomic_flag *notified)
+{
+	atomic_flag_clear(notified);
+	atomic_flag_test_and_set(notified);
+	if (notify_backend == NOTIFY_BACKEND_DOORBELL)
+		notify_db.rx_seq = notify_doorbell_read();
+}
+
+/**
+ * @brief notify_irq_enable() - enable the IPI interrupt from the remote
+ *        The doorbell backend runs with the IPI interrupt disabled.
+ *
+ * @param[in] ipi_io - IPI metal i/o region
+ * @param[in] mask - IPI mask of the remote
+ */
+static inline void notify_irq_enable(struct metal_io_region *ipi_io,
+				     uint32_t mask)
+{
+	if (notify_backend != NOTIFY_BACKEND_DOORBELL)
+		metal_io_write32(ipi_io, IPI_IER_OFFSET, mask);
+}
+
+/**
+ * @brief notify_wait_name() - return name of how notify_wait() waits
+ *
+ * @param[in] policy - wait policy of the IPI backends
+ */
+static inline const char *notify_wait_name(enum wait_policy policy)
+{
+	return notify_backend == NOTIFY_BACKEND_DOORBELL ?
+	       "polled doorbell" : wait_policy_name(policy);
+}
+
+#endif /* __NOTIFY_H__ */
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * ocm.c
+ * Placement of the hot path in the on-chip memory.
+ * See ocm.h for what is placed in the OCM.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <metal/alloc.h>
+#include <xil_cache.h>
+#include "common.h"
+#include "ocm.h"
+
+/* OCM sections, from the linker script */
+extern char __ocm_text_start[], __ocm_text_end[], __ocm_text_load[];
+extern char __ocm_data_start[], __ocm_data_end[], __ocm_data_load[];
+extern char __ocm_bss_start[], __ocm_bss_end[];
+
+#ifdef OCM_PLACEMENT
+
+/* ocm_alloc() pool, allocated from the bottom */
+static uint8_t ocm_pool[OCM_POOL_SIZE] OCM_BSS
+	__attribute__((aligned(OCM_ALIGN)));
+static size_t ocm_pool_used;
+#endif
+
+void ocm_init(void)
+{
+	size_t text_size = __ocm_text_end - __ocm_text_start;
+
+	/* The GIC handler of the BSP is in .ocm_text whatever the build,
+	 * see lscript.ld, so the code is always copied */
+	memcpy(__ocm_text_start, __ocm_text_load, text_size);
+	memcpy(__ocm_data_start, __ocm_data_load,
+	       __ocm_data_end - __ocm_data_start);
+	memset(__ocm_bss_start, 0, __ocm_bss_end - __ocm_bss_start);
+
+	/* The code is fetched by the I-cache: clean it from the D-cache
+	 * and drop what the I-cache may hold of the OCM */
+	Xil_DCacheFlushRange((INTPTR)__ocm_text_start, text_size);
+	asm volatile("dsb ish; ic iallu; dsb ish; isb" ::: "memory");
+
+#ifdef OCM_PLACEMENT
+	ocm_pool_used = 0;
+	LPRINTF("OCM: %lu bytes of code, %lu bytes of data, %u bytes pool\n",
+		(unsigned long)text_size,
+		(unsigned long)(__ocm_bss_end - __ocm_data_start),
+		OCM_POOL_SIZE);
+#endif
+}
+
+void *ocm_alloc(size_t size)
+{
+#ifdef OCM_PLACEMENT
+	void *p;
+
+	size = (size + OCM_ALIGN - 1) & ~(size_t)(OCM_ALIGN - 1);
+	if (size <= OCM_POOL_SIZE - ocm_pool_used) {
+		p = ocm_pool + ocm_pool_used;
+		ocm_pool_used += size;
+		return p;
+	}
+	LPRINTF("OCM pool exhausted, %lu bytes buffer in DDR.\n",
+		(unsigned long)size);
+#endif
+	return metal_allocate_memory(size);
+}
+
+void ocm_free(void *p)
+{
+#ifdef OCM_PLACEMENT
+	uint8_t *b = p;
+
+	if (b >= ocm_pool && b < ocm_pool + OCM_POOL_SIZE) {
+		ocm_pool_used = b - ocm_pool;
+		return;
+	}
+#endif
+	metal_free_memory(p);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * ocm.h
+ * Placement of the hot path in the on-chip memory.
+ *
+ * With OCM_PLACEMENT, the code marked OCM_TEXT, the data marked OCM_DATA
+ * or OCM_BSS and the buffers from ocm_alloc() are in the 256KB OCM at
+ * 0xFFFC0000 instead of the DDR, so their cache misses are served from
+ * the OCM rather than through the DDR controller. The linker script loads
+ * the .ocm_text and .ocm_data sections in the DDR, ocm_init() copies them
+ * to the OCM before anything runs from it. Without OCM_PLACEMENT, the
+ * macros are empty and ocm_alloc() is metal_allocate_memory().
+ *
+ * The GIC handler of the BSP, XScuGic_InterruptHandler(), cannot be
+ * marked: the linker script places the code of xscugic_intr.o in
+ * .ocm_text. The linker script does not see OCM_PLACEMENT, so the GIC
+ * handler is in the OCM in both builds and ocm_init() always copies
+ * .ocm_text, and both placements measure the same GIC handler.
+ *
+ * The records of an OCM_PLACEMENT build are flagged RESULT_OCM, so the
+ * DDR and the OCM placements are compared by running both builds.
+ */
+
+#ifndef __OCM_H__
+#define __OCM_H__
+
+#include <stddef.h>
+
+#define OCM_BASE_ADDR   0xFFFC0000
+#define OCM_SIZE        0x40000
+#define OCM_POOL_SIZE   0x20000 /* OCM left to ocm_alloc() */
+#define OCM_ALIGN       64
+
+#ifdef OCM_PLACEMENT
+#define OCM_TEXT        __attribute__((section(".ocm.text"), noinline))
+#define OCM_DATA        __attribute__((section(".ocm.data")))
+#define OCM_BSS         __attribute__((section(".ocm.bss")))
+#else
+#define OCM_TEXT
+#define OCM_DATA
+#define OCM_BSS
+#endif
+
+/**
+ * @brief ocm_init() - Copy the OCM code and data from their load address
+ *        in the DDR and clear the OCM bss. It must be called before any
+ *        OCM_TEXT function, OCM_DATA or OCM_BSS variable is used, and
+ *        before the GIC handler is connected.
+ */
+void ocm_init(void);
+
+/**
+ * @brief ocm_alloc() - Allocate a buffer in the OCM, in the DDR if the
+ *        OCM pool is exhausted or without OCM_PLACEMENT
+ *        The OCM buffers are allocated and freed in LIFO order.
+ *
+ * @param[in] size - size of the buffer
+ * @return - buffer, aligned on OCM_ALIGN in the OCM, NULL if failure.
+ */
+void *ocm_alloc(size_t size);
+
+/**
+ * @brief ocm_free() - Free a buffer from ocm_alloc()
+ *        Freeing an OCM buffer also frees the ones allocated after it.
+ *
+ * @param[in] p - buffer
+ */
+void ocm_free(void *p);
+
+/**
+ * @brief ocm_contains() - Check a buffer is in the OCM
+ *
+ * @param[in] p - buffer
+ * @return - 1 if it is in the OCM, 0 otherwise.
+ */
+static inline int ocm_contains(const void *p)
+{
+	return (unsigned long)p >= OCM_BASE_ADDR &&
+	       (unsigned long)p - OCM_BASE_ADDR < OCM_SIZE;
+}
+
+#endif /* __OCM_H__ */
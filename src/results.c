@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * results.c
+ * Binary results export to the shared memory.
+ * See results.h for the shared memory structure of the results.
+ */
+
+#include <errno.h>
+#include <metal/io.h>
+#include "common.h"
+#include "results.h"
+#include "timestamp.h"
+#include "notify.h"
+
+#define RESULTS_STATUS_OFFSET  0x08
+#define RESULTS_RET_OFFSET     0x0C
+#define RESULTS_COUNT_OFFSET   0x10
+#define RESULTS_DROPPED_OFFSET 0x1C
+#define RESULTS_RECORDS_MAX \
+	((SHM_RESULTS_SIZE - RESULTS_RECORDS_OFFSET) / RESULTS_RECORD_SIZE)
+
+static struct metal_io_region *results_io;
+static uint32_t results_count;
+static uint32_t results_dropped;
+static uint32_t results_run;
+static uint32_t results_runs = 1;
+static int results_warmup;
+
+int results_init(struct metal_io_region *io)
+{
+	if (!io || metal_io_region_size(io) < SHM_RESULTS_OFFSET +
+					      SHM_RESULTS_SIZE)
+		return -EINVAL;
+	results_io = io;
+	results_count = 0;
+	results_dropped = 0;
+
+	metal_io_write32(io, SHM_RESULTS_OFFSET + 0x00, RESULTS_MAGIC);
+	metal_io_write32(io, SHM_RESULTS_OFFSET + 0x04, RESULTS_VERSION);
+	metal_io_write32(io, SHM_RESULTS_OFFSET + RESULTS_RET_OFFSET, 0);
+	metal_io_write32(io, SHM_RESULTS_OFFSET + RESULTS_COUNT_OFFSET, 0);
+	metal_io_write32(io, SHM_RESULTS_OFFSET + 0x14, RESULTS_RECORD_SIZE);
+#ifdef TS_BACKEND_TTC
+	metal_io_write32(io, SHM_RESULTS_OFFSET + 0x18, TS_BACKEND_TTC_ID);
+#else
+	metal_io_write32(io, SHM_RESULTS_OFFSET + 0x18, TS_BACKEND_GENERIC_ID);
+#endif
+	metal_io_write32(io, SHM_RESULTS_OFFSET + RESULTS_DROPPED_OFFSET, 0);
+	metal_io_write64(io, SHM_RESULTS_OFFSET + 0x20, ts_freq());
+	metal_io_write32(io, SHM_RESULTS_OFFSET + RESULTS_STATUS_OFFSET,
+			 RESULTS_STATUS_RUNNING);
+	shm_cache_flush(io, SHM_RESULTS_OFFSET, RESULTS_RECORDS_OFFSET);
+	return 0;
+}
+
+int results_add(const struct demo_result *r, const struct metal_hist *h)
+{
+	struct demo_result rec = *r;
+	unsigned long offset;
+
+	if (!results_io)
+		return -ENODEV;
+	if (results_warmup)
+		return 0;
+	if (results_count >= RESULTS_RECORDS_MAX) {
+		/* The collector sees the loss in the header and status */
+		if (!results_dropped++)
+			LPERROR("Results area full, dropping records.\n");
+		metal_io_write32(results_io, SHM_RESULTS_OFFSET +
+				 RESULTS_DROPPED_OFFSET, results_dropped);
+		shm_cache_flush(results_io, SHM_RESULTS_OFFSET +
+				RESULTS_DROPPED_OFFSET, sizeof(uint32_t));
+		return -ENOSPC;
+	}
+
+	if (shm_cacheable)
+		rec.flags |= RESULT_CACHEABLE;
+	if (shm_neon_copy)
+		rec.flags |= RESULT_NEON_COPY;
+#ifndef NOXEN
+	rec.flags |= RESULT_XEN;
+#endif
+#ifdef OCM_PLACEMENT
+	rec.flags |= RESULT_OCM;
+#endif
+	rec.backend = notify_backend;
+	rec.run = results_run;
+	rec.runs = results_runs;
+	offset = SHM_RESULTS_OFFSET + RESULTS_RECORDS_OFFSET +
+		 results_count * RESULTS_RECORD_SIZE;
+	metal_io_block_write(results_io, offset, &rec, sizeof(rec));
+	if (h)
+		metal_io_block_write(results_io, offset + sizeof(rec), h,
+				     sizeof(*h));
+	else
+		metal_io_block_set(results_io, offset + sizeof(rec), 0,
+				   sizeof(*h));
+	shm_cache_flush(results_io, offset, RESULTS_RECORD_SIZE);
+
+	/* The record is complete before it is counted */
+	results_count++;
+	metal_io_write32(results_io, SHM_RESULTS_OFFSET + RESULTS_COUNT_OFFSET,
+			 results_count);
+	shm_cache_flush(results_io, SHM_RESULTS_OFFSET + RESULTS_COUNT_OFFSET,
+			sizeof(uint32_t));
+	return 0;
+}
+
+void results_set_run(uint32_t run, uint32_t runs, int warmup)
+{
+	results_run = run;
+	results_runs = runs;
+	results_warmup = warmup;
+}
+
+uint32_t results_num(void)
+{
+	return results_count;
+}
+
+uint32_t results_space(void)
+{
+	return RESULTS_RECORDS_MAX - results_count;
+}
+
+int results_read(uint32_t index, struct demo_result *r)
+{
+	unsigned long offset;
+
+	if (!results_io || index >= results_count)
+		return -EINVAL;
+	offset = SHM_RESULTS_OFFSET + RESULTS_RECORDS_OFFSET +
+		 index * RESULTS_RECORD_SIZE;
+	shm_cache_invalidate(results_io, offset, sizeof(*r));
+	metal_io_block_read(results_io, offset, r, sizeof(*r));
+	return 0;
+}
+
+void results_complete(int ret)
+{
+	if (!results_io)
+		return;
+	metal_io_write32(results_io, SHM_RESULTS_OFFSET + RESULTS_RET_OFFSET,
+			 (uint32_t)ret);
+	shm_cache_flush(results_io, SHM_RESULTS_OFFSET + RESULTS_RET_OFFSET,
+			sizeof(uint32_t));
+	if (results_dropped)
+		LPERROR("%u records dropped, results truncated.\n",
+			results_dropped);
+	/* The status word is written last */
+	metal_io_write32(results_io, SHM_RESULTS_OFFSET + RESULTS_STATUS_OFFSET,
+			 results_dropped ? RESULTS_STATUS_TRUNCATED :
+			 RESULTS_STATUS_DONE);
+	shm_cache_flush(results_io, SHM_RESULTS_OFFSET + RESULTS_STATUS_OFFSET,
+			sizeof(uint32_t));
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * results.h
+ * Binary results export to the shared memory.
+ *
+ * Each demo appends one record per test, package size and direction to
+ * the results area. The Linux side collector polls the status word. When
+ * the status reads RESULTS_STATUS_DONE, it can read all the records
+ * without scraping the UART output. RESULTS_STATUS_TRUNCATED is final too,
+ * but records were dropped once the area was full, the header holds how
+ * many.
+ *
+ * Here is the structure of the results area:
+ * |0x00 - 0x03 | magic, RESULTS_MAGIC |
+ * |0x04 - 0x07 | version, RESULTS_VERSION |
+ * |0x08 - 0x0B | status, RESULTS_STATUS_*, written last |
+ * |0x0C - 0x0F | return code of the demos, valid once done |
+ * |0x10 - 0x13 | number of records |
+ * |0x14 - 0x17 | size of a record, RESULTS_RECORD_SIZE |
+ * |0x18 - 0x1B | timestamp backend ID (enum ts_backend) |
+ * |0x1C - 0x1F | number of records dropped, the area was full |
+ * |0x20 - 0x27 | frequency of the timestamp ticks in Hz |
+ * |0x40 - ...  | records, RESULTS_RECORD_SIZE each |
+ *
+ * A record is a struct demo_result followed by the struct metal_hist of
+ * the samples, with the natural alignment of the AArch64 ABI. All the
+ * times are raw timestamp ticks.
+ */
+
+#ifndef __RESULTS_H__
+#define __RESULTS_H__
+
+#include <stdint.h>
+#include <metal/io.h>
+#include "common.h"
+
+/* Results area in the shared memory */
+#define SHM_RESULTS_OFFSET      0xE00000
+#define SHM_RESULTS_SIZE        0x100000
+#define RESULTS_RECORDS_OFFSET  0x40
+#define RESULTS_RECORD_SIZE     0x480 /* demo_result + metal_hist */
+#define RESULTS_MAGIC           0x52534C54 /* "RSLT" */
+#define RESULTS_VERSION         7
+
+#define RESULTS_STATUS_RUNNING  1 /* demos running, records incomplete */
+#define RESULTS_STATUS_DONE     2 /* all records written */
+#define RESULTS_STATUS_TRUNCATED 3 /* done, records dropped, area full */
+
+/* Record flags */
+#define RESULT_ZERO_COPY        0x1 /* packages built/read in place */
+#define RESULT_CACHEABLE        0x2 /* shared memory mapped cacheable */
+#define RESULT_NEON_COPY        0x4 /* block copies use the NEON copy */
+#define RESULT_DMA              0x8 /* packages copied by the GDMA */
+#define RESULT_FAST_ISR         0x10 /* IPI taken by the fast path ISR */
+#define RESULT_POOL             0x20 /* packages in shared memory pool buffers */
+#define RESULT_CRC              0x40 /* payloads checked with a CRC32C */
+#define RESULT_FIXED_COPY       0x80 /* packages copied by the fixed size copy */
+#define RESULT_XEN              0x100 /* built to run under Xen, not NOXEN */
+#define RESULT_COLD_EVICT       0x200 /* caches and TLBs evicted before each
+				       * sample */
+#define RESULT_COLD_IDLE        0x400 /* idle before each sample */
+#define RESULT_OCM              0x800 /* hot path and buffers in the OCM */
+
+/**
+ * tests
+ */
+enum demo_test {
+	DEMO_TEST_IPI_LATENCY = 1,
+	DEMO_TEST_SHMEM_LATENCY = 2,
+	DEMO_TEST_SHMEM_THROUGHPUT = 3,
+	DEMO_TEST_SMP_LATENCY = 4,
+	DEMO_TEST_SMP_THROUGHPUT = 5,
+	DEMO_TEST_SHMEM_DUPLEX = 6,
+	DEMO_TEST_IPI_SOAK = 7,
+	DEMO_TEST_SHMEM_MSGQ = 8,
+	DEMO_TEST_SHMEM_FLOW = 9,
+	DEMO_TEST_SHMEM_COPY = 10,
+	DEMO_TEST_NOTIFY_COST = 11,
+	DEMO_TEST_SHMEM_PIPELINE = 12,
+};
+
+/**
+ * operations of the notification cost records
+ */
+enum notify_op {
+	NOTIFY_OP_KICK = 1, /* kick of the remote, with the backend in use */
+	NOTIFY_OP_WAKE = 2, /* IPI handler to the waiter running again */
+	NOTIFY_OP_ROUND_TRIP = 3, /* kick to the waiter running again */
+	NOTIFY_OP_IPI_READ = 4, /* read of an IPI register */
+	NOTIFY_OP_GIC_READ = 5, /* read of a GIC distributor register */
+	NOTIFY_OP_NUM,
+};
+
+/* Core of an aggregate record of the SMP scaling demo */
+#define RESULT_CORE_ALL         0xFFFF
+
+/**
+ * result of one test, package size and direction
+ */
+struct demo_result {
+	uint32_t test; /* enum demo_test */
+	uint32_t dir; /* enum ts_dir, upload is APU to RPU */
+	uint32_t pkg_size; /* package size, 0 if not applicable */
+	uint32_t flags; /* RESULT_* flags */
+	uint32_t batch; /* packages per kick, 0 if not applicable */
+	uint16_t core; /* APU core, RESULT_CORE_ALL for an aggregate */
+	uint16_t cores; /* cores running the test, 0 for single core demos */
+	uint64_t apu_ticks; /* APU side interval of a throughput run */
+	uint64_t rpu_ticks; /* RPU side interval of a throughput run */
+	uint64_t idle_ticks; /* APU idle in the interval, waiting for DMA or
+			      * for credits */
+	uint32_t window; /* credit window or messages in flight, 0 if not
+			  * applicable */
+	uint32_t delay_ns; /* RPU delay per slot of a flow control run */
+	uint32_t op; /* enum notify_op of a notification cost record */
+	uint32_t backend; /* enum notify_backend of the kicks */
+	uint32_t run; /* measured run of the suite, from 0 */
+	uint32_t runs; /* measured runs of the suite */
+	uint32_t hist_shift; /* histogram counts are the sample counts shifted
+			      * right by hist_shift, see hist64_export() */
+	struct metal_stat stat; /* statistics of the samples */
+	struct metal_pctl pctl; /* percentiles of the samples */
+};
+
+/**
+ * @brief results_init() - Initialize the results area
+ *        Write the header with no records and the running status.
+ *
+ * @param[in] io - shared memory i/o region
+ * @return - 0 on success, error code if failure.
+ */
+int results_init(struct metal_io_region *io);
+
+/**
+ * @brief results_add() - Append a record to the results area
+ *        RESULT_CACHEABLE and RESULT_NEON_COPY are set from the current
+ *        shared memory mapping and block copy, RESULT_XEN and RESULT_OCM
+ *        from the build, the backend from the notification backend in use
+ *        and the run from results_set_run(). Nothing is added during a
+ *        warm-up run.
+ *
+ * @param[in] r - result
+ * @param[in] h - histogram of the samples, NULL if there is none
+ * @return - 0 on success, -ENOSPC if the area is full, the record is
+ *           then counted as dropped in the header, -ENODEV if the
+ *           results area is not initialized.
+ */
+int results_add(const struct demo_result *r, const struct metal_hist *h);
+
+/**
+ * @brief results_set_run() - Set the run of the suite of the next records
+ *
+ * @param[in] run - measured run, from 0, ignored for a warm-up run
+ * @param[in] runs - measured runs of the suite
+ * @param[in] warmup - 1 for a warm-up run, its records are dropped
+ */
+void results_set_run(uint32_t run, uint32_t runs, int warmup);
+
+/**
+ * @brief results_num() - Number of records in the results area
+ *
+ * @return - number of records.
+ */
+uint32_t results_num(void);
+
+/**
+ * @brief results_space() - Number of records the results area can still
+ *        hold
+ *
+ * @return - number of free records.
+ */
+uint32_t results_space(void);
+
+/**
+ * @brief results_read() - Read a record back from the results area
+ *
+ * @param[in] index - record number, from 0
+ * @param[out] r - result, without the histogram
+ * @return - 0 on success, -EINVAL if there is no such record.
+ */
+int results_read(uint32_t index, struct demo_result *r);
+
+/**
+ * @brief results_complete() - Mark the results as complete
+ *        The status is RESULTS_STATUS_TRUNCATED if records were dropped.
+ *
+ * @param[in] ret - return code of the demos
+ */
+void results_complete(int ret);
+
+#endif /* __RESULTS_H__ */
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_copy.c
+ * NEON block copy backend of the shared memory i/o region.
+ * See shm_copy.h for the access pattern.
+ */
+
+#include <metal/atomic.h>
+#include <metal/io.h>
+#include "common.h"
+#include "shm_copy.h"
+
+void shm_copy_neon(void *dst, const void *src, size_t len, const void *shm)
+{
+	volatile uint8_t *d = dst;
+	const volatile uint8_t *s = src;
+	size_t head;
+
+	/* Align the shared memory side */
+	head = (SHM_COPY_ALIGN - ((uintptr_t)shm & (SHM_COPY_ALIGN - 1))) &
+	       (SHM_COPY_ALIGN - 1);
+	if (head > len)
+		head = len;
+	len -= head;
+	while (head--)
+		*d++ = *s++;
+
+	while (len >= 64) {
+		asm volatile("ld1 {v0.16b-v3.16b}, [%1], #64\n"
+			     "st1 {v0.16b-v3.16b}, [%0], #64\n"
+			     : "+r" (d), "+r" (s)
+			     :: "v0", "v1", "v2", "v3", "memory");
+		len -= 64;
+	}
+	while (len >= 16) {
+		asm volatile("ld1 {v0.16b}, [%1], #16\n"
+			     "st1 {v0.16b}, [%0], #16\n"
+			     : "+r" (d), "+r" (s)
+			     :: "v0", "memory");
+		len -= 16;
+	}
+
+	while (len--)
+		*d++ = *s++;
+}
+
+int shm_copy_neon_block_read(struct metal_io_region *io, unsigned long offset,
+			     void *restrict dst, memory_order order, int len)
+{
+	void *src = metal_io_virt(io, offset);
+
+	/* Same ordering as the generic copy, reads after the fence */
+	atomic_thread_fence(order);
+	shm_copy_neon(dst, src, len, src);
+	return len;
+}
+
+int shm_copy_neon_block_write(struct metal_io_region *io,
+			      unsigned long offset, const void *restrict src,
+			      memory_order order, int len)
+{
+	void *dst = metal_io_virt(io, offset);
+
+	/* Same ordering as the generic copy, writes before the fence */
+	shm_copy_neon(dst, src, len, dst);
+	atomic_thread_fence(order);
+	return len;
+}
+
+/**
+ * @brief SHM_COPY_FIXED() - define the fixed size copy of n bytes
+ *        The .rept blocks unroll the bursts at assembly time: n / 64
+ *        bursts of 64 bytes, then the 16 bytes accesses of the rest.
+ */
+#define SHM_COPY_FIXED(n)						\
+static void shm_copy_fixed_##n(void *dst, const void *src)		\
+{									\
+	void *d = dst;							\
+	const void *s = src;						\
+									\
+	asm volatile(".rept " #n " / 64\n"				\
+		     "ld1 {v0.16b-v3.16b}, [%1], #64\n"		\
+		     "st1 {v0.16b-v3.16b}, [%0], #64\n"		\
+		     ".endr\n"						\
+		     ".rept (" #n " - " #n " / 64 * 64) / 16\n"		\
+		     "ld1 {v0.16b}, [%1], #16\n"			\
+		     "st1 {v0.16b}, [%0], #16\n"			\
+		     ".endr\n"						\
+		     : "+r" (d), "+r" (s)				\
+		     :: "v0", "v1", "v2", "v3", "memory");		\
+}
+
+SHM_COPY_FIXED(16)
+SHM_COPY_FIXED(32)
+SHM_COPY_FIXED(64)
+SHM_COPY_FIXED(128)
+SHM_COPY_FIXED(256)
+SHM_COPY_FIXED(512)
+SHM_COPY_FIXED(1024)
+
+/* Fixed size copies, from SHM_COPY_FIXED_MIN, one per power of two */
+static const shm_copy_fixed_fn shm_copy_fixed_table[] = {
+	shm_copy_fixed_16,
+	shm_copy_fixed_32,
+	shm_copy_fixed_64,
+	shm_copy_fixed_128,
+	shm_copy_fixed_256,
+	shm_copy_fixed_512,
+	shm_copy_fixed_1024,
+};
+
+shm_copy_fixed_fn shm_copy_fixed(size_t len)
+{
+	if (len < SHM_COPY_FIXED_MIN || len > SHM_COPY_FIXED_MAX ||
+	    (len & (len - 1)))
+		return NULL;
+	return shm_copy_fixed_table[__builtin_ctzl(len) -
+				    __builtin_ctzl(SHM_COPY_FIXED_MIN)];
+}
+
+int shm_block_write_fixed(struct metal_io_region *io, unsigned long offset,
+			  const void *src, shm_copy_fixed_fn copy, size_t len)
+{
+	void *dst = metal_io_virt(io, offset);
+
+	if (!copy || !dst || ((uintptr_t)dst & (SHM_COPY_ALIGN - 1)) ||
+	    offset + len > metal_io_region_size(io))
+		return metal_io_block_write(io, offset, src, len);
+	/* Same ordering as the generic copy, writes before the fence */
+	copy(dst, src);
+	atomic_thread_fence(memory_order_seq_cst);
+	return (int)len;
+}
+
+int shm_block_read_fixed(struct metal_io_region *io, unsigned long offset,
+			 void *dst, shm_copy_fixed_fn copy, size_t len)
+{
+	void *src = metal_io_virt(io, offset);
+
+	if (!copy || !src || ((uintptr_t)src & (SHM_COPY_ALIGN - 1)) ||
+	    offset + len > metal_io_region_size(io))
+		return metal_io_block_read(io, offset, dst, len);
+	/* Same ordering as the generic copy, reads after the fence */
+	atomic_thread_fence(memory_order_seq_cst);
+	copy(dst, src);
+	return (int)len;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_copy.h
+ * NEON block copy backend of the shared memory i/o region.
+ *
+ * The generic libmetal block copy moves at most 8 bytes per access. This
+ * backend moves 64 bytes per ld1/st1 burst of four 128-bit registers,
+ * then 16 bytes per access, with byte accesses for the head and the tail.
+ * The head aligns the shared memory side on 16 bytes, so the bursts never
+ * cross a 16-byte boundary there, whatever the alignment of the private
+ * buffer.
+ *
+ * The backend is installed in the block_read/block_write ops of the
+ * shared memory region, see sys_shm_set_neon_copy().
+ *
+ * The fixed size copies are generated per size class, powers of two from
+ * SHM_COPY_FIXED_MIN to SHM_COPY_FIXED_MAX, fully unrolled with bursts of
+ * 64 bytes then 16 bytes and no length or alignment branch. A dispatch
+ * table picks the copy of a package size once, the caller keeps it for
+ * its loop. They need the shared memory side aligned on SHM_COPY_ALIGN.
+ */
+
+#ifndef __SHM_COPY_H__
+#define __SHM_COPY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <metal/io.h>
+
+/* Alignment of the shared memory side of a burst */
+#define SHM_COPY_ALIGN 16
+
+/* Size classes of the fixed size copies */
+#define SHM_COPY_FIXED_MIN 16
+#define SHM_COPY_FIXED_MAX 1024
+
+/* Fixed size copy, the size is the one of its class */
+typedef void (*shm_copy_fixed_fn)(void *dst, const void *src);
+
+/**
+ * @brief shm_copy_neon() - copy with NEON bursts
+ *
+ * @param[in] dst - destination
+ * @param[in] src - source
+ * @param[in] len - number of bytes
+ * @param[in] shm - shared memory side of the copy, dst or src, it is
+ *                  aligned on SHM_COPY_ALIGN before the bursts
+ */
+void shm_copy_neon(void *dst, const void *src, size_t len, const void *shm);
+
+/**
+ * @brief shm_copy_neon_block_read() - block_read op of the NEON backend
+ *
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset in the region
+ * @param[out] dst - destination buffer
+ * @param[in] order - memory order of the read
+ * @param[in] len - number of bytes, within the region
+ * @return - number of bytes read.
+ */
+int shm_copy_neon_block_read(struct metal_io_region *io, unsigned long offset,
+			     void *restrict dst, memory_order order, int len);
+
+/**
+ * @brief shm_copy_neon_block_write() - block_write op of the NEON backend
+ *
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset in the region
+ * @param[in] src - source buffer
+ * @param[in] order - memory order of the write
+ * @param[in] len - number of bytes, within the region
+ * @return - number of bytes written.
+ */
+int shm_copy_neon_block_write(struct metal_io_region *io,
+			      unsigned long offset, const void *restrict src,
+			      memory_order order, int len);
+
+/**
+ * @brief shm_copy_fixed() - return the fixed size copy of a size
+ *
+ * @param[in] len - number of bytes
+ * @return - copy of len bytes, NULL if len is not a size class.
+ */
+shm_copy_fixed_fn shm_copy_fixed(size_t len);
+
+/**
+ * @brief shm_block_write_fixed() - write a package with a fixed size copy
+ *        Same as metal_io_block_write(), which is used if the offset is
+ *        not aligned on SHM_COPY_ALIGN or copy is NULL.
+ *
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset in the region
+ * @param[in] src - source buffer
+ * @param[in] copy - copy of len bytes, from shm_copy_fixed()
+ * @param[in] len - number of bytes
+ * @return - number of bytes written, error code if failure.
+ */
+int shm_block_write_fixed(struct metal_io_region *io, unsigned long offset,
+			  const void *src, shm_copy_fixed_fn copy, size_t len);
+
+/**
+ * @brief shm_block_read_fixed() - read a package with a fixed size copy
+ *        Same as metal_io_block_read(), which is used if the offset is
+ *        not aligned on SHM_COPY_ALIGN or copy is NULL.
+ *
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset in the region
+ * @param[out] dst - destination buffer
+ * @param[in] copy - copy of len bytes, from shm_copy_fixed()
+ * @param[in] len - number of bytes
+ * @return - number of bytes read, error code if failure.
+ */
+int shm_block_read_fixed(struct metal_io_region *io, unsigned long offset,
+			 void *dst, shm_copy_fixed_fn copy, size_t len);
+
+#endif /* __SHM_COPY_H__ */
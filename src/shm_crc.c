@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_crc.c
+ * CRC32C of the messages in shared memory, interleaved with their copy.
+ * See shm_crc.h for the CRC definition.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <metal/atomic.h>
+#include <metal/io.h>
+#include "shm_crc.h"
+
+/**
+ * @brief crc32c_u8() - add one byte to a CRC32C
+ *
+ * @param[in] crc - running CRC
+ * @param[in] v - byte
+ * @return - running CRC.
+ */
+static inline uint32_t crc32c_u8(uint32_t crc, uint8_t v)
+{
+	asm(".arch_extension crc\n"
+	    "crc32cb %w0, %w0, %w1\n"
+	    : "+r" (crc) : "r" (v));
+	return crc;
+}
+
+/**
+ * @brief crc32c_u64() - add one 8 bytes word to a CRC32C
+ *
+ * @param[in] crc - running CRC
+ * @param[in] v - word, little endian
+ * @return - running CRC.
+ */
+static inline uint32_t crc32c_u64(uint32_t crc, uint64_t v)
+{
+	asm(".arch_extension crc\n"
+	    "crc32cx %w0, %w0, %x1\n"
+	    : "+r" (crc) : "r" (v));
+	return crc;
+}
+
+/**
+ * @brief shm_crc_head() - number of bytes before the aligned part
+ *
+ * @param[in] p - shared memory side
+ * @param[in] len - number of bytes
+ */
+static inline size_t shm_crc_head(const void *p, size_t len)
+{
+	size_t head;
+
+	head = (SHM_CRC_ALIGN - ((uintptr_t)p & (SHM_CRC_ALIGN - 1))) &
+	       (SHM_CRC_ALIGN - 1);
+	return head > len ? len : head;
+}
+
+uint32_t shm_crc32c(const void *buf, size_t len, uint32_t crc)
+{
+	const uint8_t *s = buf;
+	size_t head;
+	uint64_t v;
+
+	crc = ~crc;
+	head = shm_crc_head(buf, len);
+	len -= head;
+	while (head--)
+		crc = crc32c_u8(crc, *s++);
+	for (; len >= sizeof(v); len -= sizeof(v), s += sizeof(v)) {
+		memcpy(&v, s, sizeof(v));
+		crc = crc32c_u64(crc, v);
+	}
+	while (len--)
+		crc = crc32c_u8(crc, *s++);
+	return ~crc;
+}
+
+uint32_t shm_copy_crc32c(void *dst, const void *src, size_t len,
+			 const void *shm, uint32_t crc)
+{
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	size_t head;
+	uint64_t v;
+
+	crc = ~crc;
+	/* Align the shared memory side */
+	head = shm_crc_head(shm, len);
+	len -= head;
+	while (head--) {
+		crc = crc32c_u8(crc, *s);
+		*d++ = *s++;
+	}
+
+	/* One load and one store per word, the private side may be
+	 * unaligned, memcpy() of a word compiles to a single access */
+	for (; len >= sizeof(v); len -= sizeof(v)) {
+		memcpy(&v, s, sizeof(v));
+		crc = crc32c_u64(crc, v);
+		memcpy(d, &v, sizeof(v));
+		s += sizeof(v);
+		d += sizeof(v);
+	}
+	while (len--) {
+		crc = crc32c_u8(crc, *s);
+		*d++ = *s++;
+	}
+	return ~crc;
+}
+
+int shm_block_write_crc_chunked(struct metal_io_region *io,
+				unsigned long offset, const void *buf,
+				size_t buf_size, size_t len, uint32_t *crc)
+{
+	uint8_t *dst;
+	size_t chunk, done;
+	uint32_t c = 0;
+
+	dst = metal_io_virt(io, offset);
+	if (!dst || !buf_size || offset + len > metal_io_region_size(io))
+		return -EINVAL;
+	for (done = 0; done < len; done += chunk) {
+		chunk = len - done < buf_size ? len - done : buf_size;
+		c = shm_copy_crc32c(dst + done, buf, chunk, dst + done, c);
+	}
+	/* Same ordering as metal_io_block_write() */
+	atomic_thread_fence(memory_order_seq_cst);
+	*crc = c;
+	return (int)len;
+}
+
+int shm_block_read_crc_chunked(struct metal_io_region *io,
+			       unsigned long offset, void *buf,
+			       size_t buf_size, size_t len, uint32_t *crc)
+{
+	const uint8_t *src;
+	size_t chunk, done;
+	uint32_t c = 0;
+
+	src = metal_io_virt(io, offset);
+	if (!src || !buf_size || offset + len > metal_io_region_size(io))
+		return -EINVAL;
+	/* Same ordering as metal_io_block_read() */
+	atomic_thread_fence(memory_order_seq_cst);
+	for (done = 0; done < len; done += chunk) {
+		chunk = len - done < buf_size ? len - done : buf_size;
+		c = shm_copy_crc32c(buf, src + done, chunk, src + done, c);
+	}
+	*crc = c;
+	return (int)len;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_crc.h
+ * CRC32C (Castagnoli) of the messages in shared memory, with the ARMv8 CRC
+ * instructions.
+ *
+ * The CRC is computed while the data is copied, one 8 bytes word is loaded,
+ * added to the CRC with crc32cx and stored, so the data is only touched
+ * once. As for the NEON copy, the shared memory side is aligned first, the
+ * private buffer side may be unaligned.
+ *
+ * The CRC is the standard CRC32C: initial value 0xFFFFFFFF, final xor
+ * 0xFFFFFFFF. crc arguments and return values are final values, a CRC is
+ * started with 0 and can be continued over several chunks.
+ */
+
+#ifndef __SHM_CRC_H__
+#define __SHM_CRC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <metal/io.h>
+
+/* Alignment of the shared memory side of the CRC copy, one crc32cx word */
+#define SHM_CRC_ALIGN 8
+
+/**
+ * @brief shm_crc32c() - Continue the CRC32C of a buffer, without copying
+ *
+ * @param[in] buf - buffer
+ * @param[in] len - number of bytes
+ * @param[in] crc - CRC of the previous bytes, 0 to start
+ * @return - CRC32C of the previous bytes and the buffer.
+ */
+uint32_t shm_crc32c(const void *buf, size_t len, uint32_t crc);
+
+/**
+ * @brief shm_copy_crc32c() - Copy a buffer and continue its CRC32C
+ *
+ * @param[out] dst - destination
+ * @param[in] src - source
+ * @param[in] len - number of bytes
+ * @param[in] shm - the shared memory side, dst or src, aligned first
+ * @param[in] crc - CRC of the previous bytes, 0 to start
+ * @return - CRC32C of the previous bytes and the copied bytes.
+ */
+uint32_t shm_copy_crc32c(void *dst, const void *src, size_t len,
+			 const void *shm, uint32_t crc);
+
+/**
+ * @brief shm_block_write_crc_chunked() - Write len bytes to the i/o region,
+ *        repeating a private buffer, and return their CRC32C
+ *
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset in the region
+ * @param[in] buf - private buffer
+ * @param[in] buf_size - size of the private buffer
+ * @param[in] len - number of bytes, within the region
+ * @param[out] crc - CRC32C of the written bytes
+ * @return - number of bytes written, error code if failure.
+ */
+int shm_block_write_crc_chunked(struct metal_io_region *io,
+				unsigned long offset, const void *buf,
+				size_t buf_size, size_t len, uint32_t *crc);
+
+/**
+ * @brief shm_block_read_crc_chunked() - Read len bytes from the i/o region,
+ *        into a private buffer chunk by chunk, and return their CRC32C
+ *
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset in the region
+ * @param[out] buf - private buffer, holds the last chunk on return
+ * @param[in] buf_size - size of the private buffer
+ * @param[in] len - number of bytes, within the region
+ * @param[out] crc - CRC32C of the read bytes
+ * @return - number of bytes read, error code if failure.
+ */
+int shm_block_read_crc_chunked(struct metal_io_region *io,
+			       unsigned long offset, void *buf,
+			       size_t buf_size, size_t len, uint32_t *crc);
+
+#endif /* __SHM_CRC_H__ */
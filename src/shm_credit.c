@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_credit.c
+ * Credit based flow control between a producer and a consumer.
+ * See shm_credit.h for the shared memory structure of the credit area.
+ */
+
+#include <errno.h>
+#include <metal/io.h>
+#include "common.h"
+#include "shm_credit.h"
+
+int shm_credit_init(struct shm_credit *c, struct metal_io_region *io,
+		    unsigned long offset)
+{
+	if (!c || !io || offset + SHM_CREDIT_SIZE > metal_io_region_size(io))
+		return -EINVAL;
+	c->io = io;
+	c->offset = offset;
+	c->window = 0;
+	c->count = 0;
+	c->limit = 0;
+	return 0;
+}
+
+void shm_credit_reset(struct shm_credit *c, uint32_t window)
+{
+	c->window = window;
+	c->count = 0;
+	c->limit = window;
+	metal_io_write32(c->io, c->offset + SHM_CREDIT_WINDOW_OFFSET, window);
+	metal_io_write32(c->io, c->offset + SHM_CREDIT_LIMIT_OFFSET, window);
+	shm_cache_flush(c->io, c->offset, SHM_CREDIT_SIZE);
+}
+
+int shm_credit_attach(struct shm_credit *c)
+{
+	shm_cache_invalidate(c->io, c->offset + SHM_CREDIT_WINDOW_OFFSET,
+			     sizeof(uint32_t));
+	c->window = metal_io_read32(c->io,
+				    c->offset + SHM_CREDIT_WINDOW_OFFSET);
+	if (!c->window)
+		return -EINVAL;
+	c->count = 0;
+	c->limit = c->window;
+	return 0;
+}
+
+/**
+ * @brief shm_credit_read_limit() - Producer side: read the credit limit
+ *        granted by the consumer
+ *
+ * @param[in] c - credit flow control
+ */
+static void shm_credit_read_limit(struct shm_credit *c)
+{
+	shm_cache_invalidate(c->io, c->offset + SHM_CREDIT_LIMIT_OFFSET,
+			     sizeof(uint32_t));
+	c->limit = metal_io_read32(c->io, c->offset + SHM_CREDIT_LIMIT_OFFSET);
+}
+
+uint32_t shm_credit_avail(struct shm_credit *c)
+{
+	if (c->limit == c->count)
+		shm_credit_read_limit(c);
+	return c->limit - c->count;
+}
+
+uint32_t shm_credit_inflight(struct shm_credit *c)
+{
+	shm_credit_read_limit(c);
+	return c->count - (c->limit - c->window);
+}
+
+void shm_credit_grant(struct shm_credit *c, uint32_t n)
+{
+	c->count += n;
+	c->limit = c->count + c->window;
+	metal_io_write32(c->io, c->offset + SHM_CREDIT_LIMIT_OFFSET, c->limit);
+	shm_cache_flush(c->io, c->offset + SHM_CREDIT_LIMIT_OFFSET,
+			sizeof(uint32_t));
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_credit.h
+ * Credit based flow control between a producer and a consumer.
+ *
+ * The consumer grants the producer a window of credits, one per unit, e.g.
+ * a ring slot. The producer spends a credit per unit it sends and stalls
+ * once it has none left. The consumer grants a credit back per unit it has
+ * consumed, by advancing the credit limit in the shared memory, and tells
+ * the producer with an IPI kick. Sent and consumed counts and the credit
+ * limit are free running 32bit counters, the producer may send while its
+ * sent count is below the credit limit. The units in flight, sent but not
+ * consumed yet, are never more than the window.
+ *
+ * Here is the structure of the credit area:
+ * |0x00 - 0x03 | credit limit, written by consumer, reset by producer |
+ * |0x40 - 0x43 | window, written by producer |
+ *
+ * A reset must only be done while the consumer is not granting credits.
+ */
+
+#ifndef __SHM_CREDIT_H__
+#define __SHM_CREDIT_H__
+
+#include <stdint.h>
+#include <metal/io.h>
+
+/* Credit control offsets, relative to the credit area */
+#define SHM_CREDIT_LIMIT_OFFSET   0x00 /* credit limit */
+#define SHM_CREDIT_WINDOW_OFFSET  0x40 /* window */
+#define SHM_CREDIT_SIZE           0x80
+
+/**
+ * local state of one end of a credit flow control
+ */
+struct shm_credit {
+	struct metal_io_region *io; /* Shared memory metal i/o region */
+	unsigned long offset; /* credit area offset */
+	uint32_t window; /* number of credits */
+	uint32_t count; /* units sent by producer, consumed by consumer */
+	uint32_t limit; /* last credit limit seen by producer */
+};
+
+/**
+ * @brief shm_credit_init() - Initialize the local state of a credit flow
+ *        control
+ *
+ * @param[in] c - credit flow control to initialize
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset of the credit area
+ * @return - 0 on success, error code if failure.
+ */
+int shm_credit_init(struct shm_credit *c, struct metal_io_region *io,
+		    unsigned long offset);
+
+/**
+ * @brief shm_credit_reset() - Producer side: reset the counts, publish
+ *        the window and grant all of it
+ *
+ * @param[in] c - credit flow control
+ * @param[in] window - number of credits, not 0
+ */
+void shm_credit_reset(struct shm_credit *c, uint32_t window);
+
+/**
+ * @brief shm_credit_attach() - Consumer side: read the window published
+ *        by the producer and reset the consumed count
+ *
+ * @param[in] c - credit flow control
+ * @return - 0 on success, -EINVAL if there is no window.
+ */
+int shm_credit_attach(struct shm_credit *c);
+
+/**
+ * @brief shm_credit_avail() - Producer side: number of credits left
+ *        The credit limit is only read from the shared memory once the
+ *        credits seen are spent.
+ *
+ * @param[in] c - credit flow control
+ * @return - number of units which can be sent.
+ */
+uint32_t shm_credit_avail(struct shm_credit *c);
+
+/**
+ * @brief shm_credit_take() - Producer side: spend credits
+ *
+ * @param[in] c - credit flow control
+ * @param[in] n - number of units sent, at most shm_credit_avail()
+ */
+static inline void shm_credit_take(struct shm_credit *c, uint32_t n)
+{
+	c->count += n;
+}
+
+/**
+ * @brief shm_credit_inflight() - Producer side: number of units sent and
+ *        not consumed yet, from the current credit limit
+ *
+ * @param[in] c - credit flow control
+ * @return - number of units in flight.
+ */
+uint32_t shm_credit_inflight(struct shm_credit *c);
+
+/**
+ * @brief shm_credit_grant() - Consumer side: grant credits back for
+ *        consumed units. The caller kicks the producer afterwards.
+ *
+ * @param[in] c - credit flow control
+ * @param[in] n - number of units consumed
+ */
+void shm_credit_grant(struct shm_credit *c, uint32_t n);
+
+#endif /* __SHM_CREDIT_H__ */
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_layout.c
+ * Layout table of the shared memory device.
+ * See shm_layout.h for the structure of the table.
+ */
+
+#include <errno.h>
+#include <metal/io.h>
+#include "common.h"
+#include "sys_init.h"
+#include "demo_params.h"
+#include "timestamp.h"
+#include "trace.h"
+#include "results.h"
+#include "notify.h"
+#include "shm_credit.h"
+#include "shm_msgq.h"
+#include "shm_layout.h"
+
+/* Size rounded up to whole cache lines */
+#define SHM_LINES(size) \
+	(((size) + SHM_LINE_SIZE - 1) & ~(unsigned long)(SHM_LINE_SIZE - 1))
+
+#define SHM_AREA(a, g, f, o, s) \
+	{ .id = (a), .group = (g), .flags = (f), .offset = (o), .size = (s) }
+
+/* Build time layout, written as is to the shared memory */
+static const struct shm_layout_entry shm_layout[] = {
+	SHM_AREA(SHM_AREA_LAYOUT, SHM_GROUP_COMMON, SHM_AREA_APU_WR,
+		 SHM_LAYOUT_OFFSET, SHM_LAYOUT_SIZE),
+	SHM_AREA(SHM_AREA_DEMO_STATUS, SHM_GROUP_COMMON,
+		 SHM_AREA_CTRL | SHM_AREA_APU_WR,
+		 SHM_DEMO_STATUS_OFFSET, SHM_LINE_SIZE),
+	SHM_AREA(SHM_AREA_DOORBELL_TX, SHM_GROUP_COMMON,
+		 SHM_AREA_CTRL | SHM_AREA_APU_WR,
+		 SHM_DOORBELL_OFFSET + SHM_DOORBELL_TX_OFFSET, SHM_LINE_SIZE),
+	SHM_AREA(SHM_AREA_DOORBELL_RX, SHM_GROUP_COMMON,
+		 SHM_AREA_CTRL | SHM_AREA_RPU_WR,
+		 SHM_DOORBELL_OFFSET + SHM_DOORBELL_RX_OFFSET, SHM_LINE_SIZE),
+	SHM_AREA(SHM_AREA_DOORBELL_MODE, SHM_GROUP_COMMON,
+		 SHM_AREA_CTRL | SHM_AREA_APU_WR,
+		 SHM_DOORBELL_OFFSET + SHM_DOORBELL_MODE_OFFSET, SHM_LINE_SIZE),
+	SHM_AREA(SHM_AREA_READY_BOOT_ID, SHM_GROUP_COMMON,
+		 SHM_AREA_CTRL | SHM_AREA_APU_WR,
+		 SHM_READY_OFFSET + SHM_READY_BOOT_ID, SHM_LINE_SIZE),
+	SHM_AREA(SHM_AREA_READY_ECHO, SHM_GROUP_COMMON,
+		 SHM_AREA_CTRL | SHM_AREA_RPU_WR,
+		 SHM_READY_OFFSET + SHM_READY_ECHO, SHM_LINE_SIZE),
+	SHM_AREA(SHM_AREA_PARAMS, SHM_GROUP_COMMON,
+		 SHM_AREA_CTRL | SHM_AREA_RPU_WR,
+		 SHM_PARAMS_OFFSET, SHM_LINES(sizeof(struct demo_params))),
+	SHM_AREA(SHM_AREA_TIMESTAMPS, SHM_GROUP_COMMON,
+		 SHM_AREA_CTRL | SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SHM_TS_OFFSET, SHM_TS_SIZE),
+	SHM_AREA(SHM_AREA_TRACE, SHM_GROUP_COMMON, SHM_AREA_APU_WR,
+		 SHM_TRACE_OFFSET, SHM_TRACE_SIZE),
+	SHM_AREA(SHM_AREA_RESULTS, SHM_GROUP_COMMON, SHM_AREA_APU_WR,
+		 SHM_RESULTS_OFFSET, SHM_RESULTS_SIZE),
+
+	SHM_AREA(SHM_AREA_LAT_TX, SHM_GROUP_SHMEM_LATENCY, SHM_AREA_APU_WR,
+		 SHM_LAT_TX_OFFSET, SHM_LAT_BUF_SIZE),
+	SHM_AREA(SHM_AREA_LAT_RX, SHM_GROUP_SHMEM_LATENCY, SHM_AREA_RPU_WR,
+		 SHM_LAT_RX_OFFSET, SHM_LAT_BUF_SIZE),
+	SHM_AREA(SHM_AREA_PIPE_DESC_TX, SHM_GROUP_SHMEM_LATENCY,
+		 SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SHM_PIPE_DESC_TX_OFFSET, SHM_PIPE_DESC_SIZE),
+	SHM_AREA(SHM_AREA_PIPE_DESC_RX, SHM_GROUP_SHMEM_LATENCY,
+		 SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SHM_PIPE_DESC_RX_OFFSET, SHM_PIPE_DESC_SIZE),
+
+	SHM_AREA(SHM_AREA_TPUT_DESC_TX, SHM_GROUP_THROUGHPUT,
+		 SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SHM_DESC_OFFSET_TX, SHM_DESC_SIZE_TX),
+	SHM_AREA(SHM_AREA_TPUT_POOL_TX, SHM_GROUP_THROUGHPUT,
+		 SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SHM_POOL_OFFSET_TX, SHM_POOL_SIZE_TX),
+	SHM_AREA(SHM_AREA_TPUT_DESC_RX, SHM_GROUP_THROUGHPUT,
+		 SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SHM_DESC_OFFSET_RX, SHM_DESC_SIZE_RX),
+	SHM_AREA(SHM_AREA_TPUT_BUF_TX, SHM_GROUP_THROUGHPUT, SHM_AREA_APU_WR,
+		 SHM_BUFF_OFFSET_TX, SHM_BUFF_SIZE_TX),
+	SHM_AREA(SHM_AREA_TPUT_BUF_RX, SHM_GROUP_THROUGHPUT, SHM_AREA_RPU_WR,
+		 SHM_BUFF_OFFSET_RX, SHM_BUFF_SIZE_RX),
+	SHM_AREA(SHM_AREA_TPUT_COUNTS, SHM_GROUP_THROUGHPUT,
+		 SHM_AREA_CTRL | SHM_AREA_APU_WR,
+		 SHM_TX_SWEEPS_OFFSET, SHM_TPUT_COUNTS_SIZE),
+	SHM_AREA(SHM_AREA_TPUT_FLOW_DELAY, SHM_GROUP_THROUGHPUT,
+		 SHM_AREA_CTRL | SHM_AREA_APU_WR,
+		 SHM_FLOW_DELAY_OFFSET, SHM_LINE_SIZE),
+	SHM_AREA(SHM_AREA_TPUT_DUPLEX_DONE, SHM_GROUP_THROUGHPUT,
+		 SHM_AREA_CTRL | SHM_AREA_RPU_WR,
+		 SHM_DUPLEX_DONE_OFFSET, SHM_LINE_SIZE),
+	SHM_AREA(SHM_AREA_TPUT_FLOW_DONE, SHM_GROUP_THROUGHPUT,
+		 SHM_AREA_CTRL | SHM_AREA_RPU_WR,
+		 SHM_FLOW_DONE_OFFSET, SHM_LINE_SIZE),
+	SHM_AREA(SHM_AREA_TPUT_CREDIT, SHM_GROUP_THROUGHPUT,
+		 SHM_AREA_CTRL | SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SHM_CREDIT_OFFSET, SHM_CREDIT_SIZE),
+	SHM_AREA(SHM_AREA_TPUT_DMA_SRC, SHM_GROUP_THROUGHPUT, SHM_AREA_APU_WR,
+		 SHM_DMA_SRC_OFFSET, SHM_DMA_SRC_SIZE),
+
+	SHM_AREA(SHM_AREA_MSGQ_CTRL, SHM_GROUP_MSGQ,
+		 SHM_AREA_CTRL | SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SHM_MSGQ_CTRL_OFFSET, SHM_MSGQ_CTRL_SIZE),
+	SHM_AREA(SHM_AREA_MSGQ_BUF, SHM_GROUP_MSGQ, SHM_AREA_APU_WR,
+		 SHM_MSGQ_BUF_OFFSET, SHM_MSGQ_BUF_SIZE),
+
+	SHM_AREA(SHM_AREA_SMP, SHM_GROUP_SMP,
+		 SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SMP_SHM_OFFSET(0), SMP_SHM_PART_SIZE),
+	SHM_AREA(SHM_AREA_SMP, SHM_GROUP_SMP,
+		 SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SMP_SHM_OFFSET(1), SMP_SHM_PART_SIZE),
+	SHM_AREA(SHM_AREA_SMP, SHM_GROUP_SMP,
+		 SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SMP_SHM_OFFSET(2), SMP_SHM_PART_SIZE),
+	SHM_AREA(SHM_AREA_SMP, SHM_GROUP_SMP,
+		 SHM_AREA_APU_WR | SHM_AREA_RPU_WR,
+		 SMP_SHM_OFFSET(3), SMP_SHM_PART_SIZE),
+};
+
+#define SHM_LAYOUT_NUM (sizeof(shm_layout) / sizeof(shm_layout[0]))
+
+/**
+ * @brief shm_layout_check_entry() - Check the placement of an area
+ *
+ * @param[in] e - layout entry
+ * @param[in] shm_size - size of the shared memory
+ * @return - 0 if valid, -EINVAL otherwise.
+ */
+static int shm_layout_check_entry(const struct shm_layout_entry *e,
+				  unsigned long shm_size)
+{
+	unsigned long align;
+
+	align = (e->flags & SHM_AREA_CTRL) ? SHM_LINE_SIZE : SHM_BURST_ALIGN;
+	if (!e->size || (unsigned long)e->offset + e->size > shm_size) {
+		LPERROR("Shared memory area %u: 0x%x + 0x%x out of range.\n",
+			e->id, e->offset, e->size);
+		return -EINVAL;
+	}
+	if (e->offset & (align - 1)) {
+		LPERROR("Shared memory area %u: 0x%x not aligned on 0x%lx.\n",
+			e->id, e->offset, align);
+		return -EINVAL;
+	}
+	if ((e->flags & SHM_AREA_CTRL) && (e->size & (SHM_LINE_SIZE - 1))) {
+		LPERROR("Shared memory area %u: 0x%x not whole lines.\n",
+			e->id, e->size);
+		return -EINVAL;
+	}
+	if (!(e->flags & (SHM_AREA_APU_WR | SHM_AREA_RPU_WR))) {
+		LPERROR("Shared memory area %u: no writer.\n", e->id);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+int shm_layout_check(struct metal_io_region *io)
+{
+	const struct shm_layout_entry *a, *b;
+	unsigned long shm_size;
+	unsigned int i, j;
+	int ret = 0;
+
+	if (!io)
+		return -EINVAL;
+	if (SHM_LAYOUT_ENTRIES_OFFSET + sizeof(shm_layout) > SHM_LAYOUT_SIZE) {
+		LPERROR("Shared memory layout table too large.\n");
+		return -EINVAL;
+	}
+	shm_size = metal_io_region_size(io);
+	for (i = 0; i < SHM_LAYOUT_NUM; i++) {
+		a = &shm_layout[i];
+		if (shm_layout_check_entry(a, shm_size))
+			ret = -EINVAL;
+		for (j = 0; j < i; j++) {
+			b = &shm_layout[j];
+			/* Areas of different demos are not used together */
+			if (a->group != b->group &&
+			    a->group != SHM_GROUP_COMMON &&
+			    b->group != SHM_GROUP_COMMON)
+				continue;
+			if (a->offset < b->offset + b->size &&
+			    b->offset < a->offset + a->size) {
+				LPERROR("Shared memory areas %u, %u overlap.\n",
+					b->id, a->id);
+				ret = -EINVAL;
+			}
+		}
+	}
+	return ret;
+}
+
+int shm_layout_publish(struct metal_io_region *io)
+{
+	int ret;
+
+	ret = shm_layout_check(io);
+	if (ret)
+		return ret;
+	/* The server only reads the entries once the magic is there */
+	metal_io_write32(io, SHM_LAYOUT_OFFSET + SHM_LAYOUT_MAGIC_OFFSET, 0);
+	metal_io_block_write(io, SHM_LAYOUT_OFFSET + SHM_LAYOUT_ENTRIES_OFFSET,
+			     shm_layout, sizeof(shm_layout));
+	metal_io_write32(io, SHM_LAYOUT_OFFSET + SHM_LAYOUT_VERSION_OFFSET,
+			 SHM_LAYOUT_VERSION);
+	metal_io_write32(io, SHM_LAYOUT_OFFSET + SHM_LAYOUT_NUM_OFFSET,
+			 SHM_LAYOUT_NUM);
+	metal_io_write32(io, SHM_LAYOUT_OFFSET + SHM_LAYOUT_ENTRY_SIZE_OFFSET,
+			 sizeof(struct shm_layout_entry));
+	shm_cache_flush(io, SHM_LAYOUT_OFFSET, SHM_LAYOUT_ENTRIES_OFFSET +
+			sizeof(shm_layout));
+	metal_io_write32(io, SHM_LAYOUT_OFFSET + SHM_LAYOUT_MAGIC_OFFSET,
+			 SHM_LAYOUT_MAGIC);
+	shm_cache_flush(io, SHM_LAYOUT_OFFSET, sizeof(uint32_t));
+	return 0;
+}
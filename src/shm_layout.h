@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_layout.h
+ * Layout of the shared memory device, shared with the server.
+ *
+ * The areas of the demos are defined here, or in the header of the module
+ * which owns them, and all of them are listed in the layout table. The APU
+ * checks the table and writes it to the shared memory in sys_init(), the
+ * server may read the offsets from it instead of building them in, once
+ * it has checked the magic and version.
+ *
+ * Each area has a group. The common areas are used by all the demos and
+ * must not overlap any other area. The areas of a demo, or of a phase of
+ * a demo, may overlap the areas of the other groups, as they are never in
+ * use at the same time, but not those of their own group.
+ *
+ * A control area holds words polled or written by both sides. It starts
+ * on a cache line and fills whole lines, and a line is only written by
+ * one side, so the two sides never share a line even when the shared
+ * memory is cacheable. A data area starts on SHM_BURST_ALIGN so that the
+ * block copies, the GDMA and the cache maintenance work on whole bursts.
+ *
+ * Here is the structure of the layout table:
+ * |0x00 - 0x03 | magic, SHM_LAYOUT_MAGIC |
+ * |0x04 - 0x07 | version, SHM_LAYOUT_VERSION |
+ * |0x08 - 0x0B | number of entries |
+ * |0x0C - 0x0F | size of an entry, sizeof(struct shm_layout_entry) |
+ * |0x40 - ...  | entries |
+ */
+
+#ifndef __SHM_LAYOUT_H__
+#define __SHM_LAYOUT_H__
+
+#include <stdint.h>
+#include <metal/io.h>
+
+/* Layout table in the shared memory */
+#define SHM_LAYOUT_OFFSET        0xFC0000
+#define SHM_LAYOUT_SIZE          0x1000
+#define SHM_LAYOUT_MAGIC_OFFSET  0x00
+#define SHM_LAYOUT_VERSION_OFFSET 0x04
+#define SHM_LAYOUT_NUM_OFFSET    0x08
+#define SHM_LAYOUT_ENTRY_SIZE_OFFSET 0x0C
+#define SHM_LAYOUT_ENTRIES_OFFSET 0x40
+#define SHM_LAYOUT_MAGIC         0x54594C53 /* "SLYT" */
+#define SHM_LAYOUT_VERSION       1
+
+/* Cache line and burst alignments */
+#define SHM_LINE_SIZE            64
+#define SHM_BURST_ALIGN          0x1000
+
+/* Demo status word, common to the demos */
+#define SHM_DEMO_STATUS_OFFSET   0xFC1000
+
+/* Shared memory latency demo buffers */
+#define SHM_LAT_TX_OFFSET        0x100000
+#define SHM_LAT_RX_OFFSET        0x500000
+#define SHM_LAT_BUF_SIZE         0x400000
+
+/* Pipelined latency ring descriptor areas, the slots are in the latency
+ * buffers */
+#define SHM_PIPE_DESC_TX_OFFSET  0x0
+#define SHM_PIPE_DESC_RX_OFFSET  0x1000
+#define SHM_PIPE_DESC_SIZE       0x1000
+
+/* Shared memory throughput demo areas */
+#define SHM_DESC_OFFSET_TX       0x0
+#define SHM_DESC_SIZE_TX         0x100000
+#define SHM_POOL_OFFSET_TX       0x100000
+#define SHM_POOL_SIZE_TX         0x100000
+#define SHM_DESC_OFFSET_RX       0x200000
+#define SHM_DESC_SIZE_RX         0x200000
+#define SHM_BUFF_OFFSET_TX       0x400000
+#define SHM_BUFF_SIZE_TX         0x400000
+#define SHM_BUFF_OFFSET_RX       0x800000
+#define SHM_BUFF_SIZE_RX         0x300000 /* RX slots end at the controls */
+#define SHM_MSGQ_CTRL_OFFSET     SHM_DESC_OFFSET_TX
+#define SHM_MSGQ_BUF_OFFSET      SHM_BUFF_OFFSET_TX
+#define SHM_MSGQ_BUF_SIZE        0x400000
+#define SHM_DMA_SRC_OFFSET       0xC00000 /* DMA source, up to the results */
+#define SHM_DMA_SRC_SIZE         0x200000
+
+/* Shared memory throughput demo controls, one cache line each */
+#define SHM_TX_SWEEPS_OFFSET     0xB00000 /* written by APU */
+#define SHM_ROUNDS_OFFSET        0xB00040 /* written by APU */
+#define SHM_RX_SWEEPS_OFFSET     0xB00080 /* written by APU */
+#define SHM_DUPLEX_SWEEPS_OFFSET 0xB000C0 /* written by APU */
+#define SHM_MSGQ_COUNT_OFFSET    0xB00100 /* written by APU */
+#define SHM_FLOW_RUNS_OFFSET     0xB00140 /* written by APU */
+#define SHM_TPUT_COUNTS_SIZE     0x180 /* the APU written counts above */
+#define SHM_FLOW_DELAY_OFFSET    0xB00180 /* written by APU */
+#define SHM_DUPLEX_DONE_OFFSET   0xB001C0 /* written by RPU */
+#define SHM_FLOW_DONE_OFFSET     0xB00200 /* written by RPU */
+#define SHM_CREDIT_OFFSET        0xB00240 /* see shm_credit.h */
+
+/* SMP scaling demo partitions, one per core */
+#define SMP_SHM_PART_SIZE        0x200000
+#define SMP_SHM_OFFSET(core)     ((unsigned long)(core) * SMP_SHM_PART_SIZE)
+
+/**
+ * areas of the layout table
+ */
+enum shm_area_id {
+	SHM_AREA_LAYOUT = 1,
+	SHM_AREA_DEMO_STATUS,
+	SHM_AREA_DOORBELL_TX,
+	SHM_AREA_DOORBELL_RX,
+	SHM_AREA_DOORBELL_MODE,
+	SHM_AREA_READY_BOOT_ID,
+	SHM_AREA_READY_ECHO,
+	SHM_AREA_PARAMS,
+	SHM_AREA_TIMESTAMPS,
+	SHM_AREA_TRACE,
+	SHM_AREA_RESULTS,
+	SHM_AREA_LAT_TX,
+	SHM_AREA_LAT_RX,
+	SHM_AREA_TPUT_DESC_TX,
+	SHM_AREA_TPUT_POOL_TX,
+	SHM_AREA_TPUT_DESC_RX,
+	SHM_AREA_TPUT_BUF_TX,
+	SHM_AREA_TPUT_BUF_RX,
+	SHM_AREA_TPUT_COUNTS,
+	SHM_AREA_TPUT_FLOW_DELAY,
+	SHM_AREA_TPUT_DUPLEX_DONE,
+	SHM_AREA_TPUT_FLOW_DONE,
+	SHM_AREA_TPUT_CREDIT,
+	SHM_AREA_TPUT_DMA_SRC,
+	SHM_AREA_MSGQ_CTRL,
+	SHM_AREA_MSGQ_BUF,
+	SHM_AREA_SMP,
+	SHM_AREA_PIPE_DESC_TX,
+	SHM_AREA_PIPE_DESC_RX,
+};
+
+/**
+ * groups of areas, areas of different groups other than the common one
+ * may overlap
+ */
+enum shm_group {
+	SHM_GROUP_COMMON = 0, /* all the demos */
+	SHM_GROUP_SHMEM_LATENCY = 1,
+	SHM_GROUP_THROUGHPUT = 2,
+	SHM_GROUP_MSGQ = 3, /* message queue phase of the throughput demo */
+	SHM_GROUP_SMP = 4,
+};
+
+/* Area flags */
+#define SHM_AREA_CTRL            0x1 /* control area, on whole lines */
+#define SHM_AREA_APU_WR          0x2 /* written by the APU */
+#define SHM_AREA_RPU_WR          0x4 /* written by the RPU */
+
+/**
+ * entry of the layout table, same layout in the shared memory
+ */
+struct shm_layout_entry {
+	uint32_t id; /* enum shm_area_id */
+	uint32_t group; /* enum shm_group */
+	uint32_t flags; /* SHM_AREA_* flags */
+	uint32_t offset; /* offset of the area in the shared memory */
+	uint32_t size; /* size of the area */
+	uint32_t reserved[3];
+};
+
+/**
+ * @brief shm_layout_check() - Check the layout table
+ *        Check the areas fit in the region and have a writer, control
+ *        areas are on whole cache lines, data areas are aligned on
+ *        SHM_BURST_ALIGN, and no two areas overlap unless they are of
+ *        different groups, neither common. Print the faulty entries.
+ *
+ * @param[in] io - shared memory i/o region
+ * @return - 0 if valid, -EINVAL otherwise.
+ */
+int shm_layout_check(struct metal_io_region *io);
+
+/**
+ * @brief shm_layout_publish() - Check the layout table and write it to the
+ *        shared memory, the magic last
+ *
+ * @param[in] io - shared memory i/o region
+ * @return - 0 on success, error code if failure.
+ */
+int shm_layout_publish(struct metal_io_region *io);
+
+#endif /* __SHM_LAYOUT_H__ */
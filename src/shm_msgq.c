@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_msgq.c
+ * Single producer / single consumer message queue in shared memory.
+ * See shm_msgq.h for the shared memory structure of the queue.
+ */
+
+#include <errno.h>
+#include <metal/io.h>
+#include "common.h"
+#include "shm_msgq.h"
+
+/**
+ * @brief shm_msgq_check() - check the geometry of a queue fits the region
+ *
+ * @param[in] io - shared memory i/o region
+ * @param[in] ctrl_offset - offset of the control area
+ * @param[in] buf_offset - offset of the data area
+ * @param[in] size - size of the data area
+ * @return - 0 if valid, -EINVAL otherwise.
+ */
+static int shm_msgq_check(struct metal_io_region *io,
+			  unsigned long ctrl_offset, unsigned long buf_offset,
+			  uint32_t size)
+{
+	if (size < 4 * SHM_MSGQ_ALIGN || (size & (size - 1)))
+		return -EINVAL;
+	if (ctrl_offset + SHM_MSGQ_CTRL_SIZE > metal_io_region_size(io))
+		return -EINVAL;
+	if (buf_offset + (unsigned long)size > metal_io_region_size(io))
+		return -EINVAL;
+	return 0;
+}
+
+int shm_msgq_init(struct shm_msgq *q, struct metal_io_region *io,
+		  unsigned long ctrl_offset, unsigned long buf_offset,
+		  uint32_t size)
+{
+	if (!q || !io || shm_msgq_check(io, ctrl_offset, buf_offset, size))
+		return -EINVAL;
+
+	q->io = io;
+	q->ctrl_offset = ctrl_offset;
+	q->buf_offset = buf_offset;
+	q->size = size;
+	q->head = 0;
+	q->tail = 0;
+	q->peer = 0;
+	q->next = 0;
+	return 0;
+}
+
+void shm_msgq_reset(struct shm_msgq *q)
+{
+	q->head = 0;
+	q->tail = 0;
+	q->peer = 0;
+	q->next = 0;
+	metal_io_write32(q->io, q->ctrl_offset + SHM_MSGQ_RD_OFFSET, 0);
+	metal_io_write32(q->io, q->ctrl_offset + SHM_MSGQ_SIZE_OFFSET, q->size);
+	metal_io_write32(q->io, q->ctrl_offset + SHM_MSGQ_WR_OFFSET, 0);
+	shm_cache_flush(q->io, q->ctrl_offset, SHM_MSGQ_CTRL_SIZE);
+}
+
+int shm_msgq_attach(struct shm_msgq *q)
+{
+	uint32_t size;
+
+	shm_cache_invalidate(q->io, q->ctrl_offset, SHM_MSGQ_CTRL_SIZE);
+	size = metal_io_read32(q->io, q->ctrl_offset + SHM_MSGQ_SIZE_OFFSET);
+	if (shm_msgq_check(q->io, q->ctrl_offset, q->buf_offset, size))
+		return -EINVAL;
+	q->size = size;
+	q->head = 0;
+	q->tail = 0;
+	q->peer = 0;
+	q->next = 0;
+	return 0;
+}
+
+/**
+ * @brief shm_msgq_has_space() - check the producer can write bytes
+ *
+ * @param[in] q - queue
+ * @param[in] need - number of bytes to write
+ * @return - 1 if they can be written without overwriting data the
+ *           consumer has not released yet, 0 otherwise.
+ */
+static int shm_msgq_has_space(struct shm_msgq *q, uint32_t need)
+{
+	if (q->size - (q->head - q->peer) >= need)
+		return 1;
+	/* Only go to the shared memory if the cached consumer index says
+	 * the queue is too full */
+	shm_cache_invalidate(q->io, q->ctrl_offset + SHM_MSGQ_RD_OFFSET,
+			     sizeof(uint32_t));
+	q->peer = metal_io_read32(q->io, q->ctrl_offset + SHM_MSGQ_RD_OFFSET);
+	return q->size - (q->head - q->peer) >= need;
+}
+
+/**
+ * @brief shm_msgq_write_hdr() - write a record header at the head
+ *
+ * @param[in] q - queue
+ * @param[in] id - message ID
+ * @param[in] len - length of the payload
+ */
+static void shm_msgq_write_hdr(struct shm_msgq *q, uint32_t id, uint32_t len)
+{
+	unsigned long offset;
+
+	offset = q->buf_offset + (q->head & (q->size - 1));
+	metal_io_write32(q->io, offset, len);
+	metal_io_write32(q->io, offset + sizeof(uint32_t), id);
+	shm_cache_flush(q->io, offset, shm_msgq_record_size(len));
+	q->head += shm_msgq_record_size(len);
+}
+
+void *shm_msgq_reserve(struct shm_msgq *q, size_t len)
+{
+	uint32_t rec, room;
+
+	if (len > shm_msgq_max_len(q))
+		return NULL;
+	rec = shm_msgq_record_size(len);
+	room = q->size - (q->head & (q->size - 1));
+	if (!shm_msgq_has_space(q, rec > room ? room + rec : rec))
+		return NULL;
+	if (rec > room)
+		/* Pad the end of the data area, the record goes at the
+		 * start */
+		shm_msgq_write_hdr(q, SHM_MSGQ_ID_PAD,
+				   room - sizeof(struct shm_msg_hdr));
+	return metal_io_virt(q->io, q->buf_offset +
+			     (q->head & (q->size - 1)) +
+			     sizeof(struct shm_msg_hdr));
+}
+
+void shm_msgq_commit(struct shm_msgq *q, uint32_t id, size_t len)
+{
+	shm_msgq_write_hdr(q, id, len);
+}
+
+int shm_msgq_send(struct shm_msgq *q, uint32_t id, const void *src,
+		  size_t len)
+{
+	void *payload;
+
+	payload = shm_msgq_reserve(q, len);
+	if (!payload)
+		return len > shm_msgq_max_len(q) ? -EINVAL : -EAGAIN;
+	metal_io_block_write(q->io, metal_io_virt_to_offset(q->io, payload),
+			     src, len);
+	shm_msgq_commit(q, id, len);
+	return (int)len;
+}
+
+void shm_msgq_publish(struct shm_msgq *q)
+{
+	/* metal_io_write32() is sequentially consistent, the records are
+	 * visible before the new producer index, they have already been
+	 * flushed if the shared memory is cacheable */
+	metal_io_write32(q->io, q->ctrl_offset + SHM_MSGQ_WR_OFFSET, q->head);
+	shm_cache_flush(q->io, q->ctrl_offset + SHM_MSGQ_WR_OFFSET,
+			sizeof(uint32_t));
+}
+
+uint32_t shm_msgq_available(struct shm_msgq *q)
+{
+	shm_cache_invalidate(q->io, q->ctrl_offset + SHM_MSGQ_WR_OFFSET,
+			     sizeof(uint32_t));
+	q->peer = metal_io_read32(q->io, q->ctrl_offset + SHM_MSGQ_WR_OFFSET);
+	return q->peer - q->tail;
+}
+
+void *shm_msgq_peek(struct shm_msgq *q, uint32_t *id, size_t *len)
+{
+	unsigned long offset;
+	uint32_t off, hlen, hid, rec;
+
+	while (1) {
+		if (q->peer == q->tail && !shm_msgq_available(q))
+			return NULL;
+
+		/* Read the record header */
+		off = q->tail & (q->size - 1);
+		offset = q->buf_offset + off;
+		shm_cache_invalidate(q->io, offset, sizeof(struct shm_msg_hdr));
+		hlen = metal_io_read32(q->io, offset);
+		hid = metal_io_read32(q->io, offset + sizeof(uint32_t));
+		if (hlen > q->size)
+			return NULL;
+		rec = shm_msgq_record_size(hlen);
+		if (rec > q->size - off || rec > q->peer - q->tail)
+			return NULL;
+		if (hid != SHM_MSGQ_ID_PAD)
+			break;
+		/* Skip the padding, the message is at the start */
+		q->tail += rec;
+	}
+
+	shm_cache_invalidate(q->io, offset + sizeof(struct shm_msg_hdr), hlen);
+	q->next = q->tail + rec;
+	*id = hid;
+	*len = hlen;
+	return metal_io_virt(q->io, offset + sizeof(struct shm_msg_hdr));
+}
+
+void shm_msgq_consume(struct shm_msgq *q)
+{
+	q->tail = q->next;
+}
+
+int shm_msgq_recv(struct shm_msgq *q, uint32_t *id, void *dst, size_t len)
+{
+	void *payload;
+	size_t msg_len;
+
+	payload = shm_msgq_peek(q, id, &msg_len);
+	if (!payload)
+		return q->peer == q->tail ? -EAGAIN : -EINVAL;
+	/* Leave a message the buffer cannot hold in the queue */
+	if (msg_len > len)
+		return -ENOSPC;
+	len = msg_len;
+
+	/* Read the payload */
+	metal_io_block_read(q->io, metal_io_virt_to_offset(q->io, payload),
+			    dst, len);
+
+	shm_msgq_consume(q);
+	return (int)len;
+}
+
+void shm_msgq_release(struct shm_msgq *q)
+{
+	/* Give the space of the consumed records back to the producer */
+	metal_io_write32(q->io, q->ctrl_offset + SHM_MSGQ_RD_OFFSET, q->tail);
+	shm_cache_flush(q->io, q->ctrl_offset + SHM_MSGQ_RD_OFFSET,
+			sizeof(uint32_t));
+}
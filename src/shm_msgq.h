@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_msgq.h
+ * Single producer / single consumer message queue in shared memory.
+ *
+ * Unlike the slots of shm_ring.h, the messages are variable length
+ * records packed back to back in a data area. A record is a struct
+ * shm_msg_hdr followed by the payload, padded to SHM_MSGQ_ALIGN. A record
+ * never wraps: if it does not fit before the end of the data area, the
+ * producer fills the end with a padding record and writes the message at
+ * the start. The producer and consumer indices are free running 32bit
+ * byte counters, the offset of an index in the data area is
+ * (index & (size - 1)), so size must be a power of two.
+ *
+ * Messages are visible to the consumer once the producer index is
+ * published, a batch of messages is published at once. The consumer
+ * drains all the published messages, then releases their space with one
+ * consumer index update.
+ *
+ * Here is the structure of the control area:
+ * |0x00 - 0x03 | producer index, written by producer |
+ * |0x04 - 0x07 | size of the data area, written by producer |
+ * |0x40 - 0x43 | consumer index, written by consumer |
+ *
+ * The consumer index sits on its own cache line so that the two sides
+ * never write to the same line.
+ */
+
+#ifndef __SHM_MSGQ_H__
+#define __SHM_MSGQ_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <metal/io.h>
+
+/* Queue control offsets, relative to the control area */
+#define SHM_MSGQ_WR_OFFSET        0x00 /* producer index */
+#define SHM_MSGQ_SIZE_OFFSET      0x04 /* size of the data area */
+#define SHM_MSGQ_RD_OFFSET        0x40 /* consumer index */
+#define SHM_MSGQ_CTRL_SIZE        0x80
+
+/* Alignment of the records in the data area */
+#define SHM_MSGQ_ALIGN            8
+
+/* ID of the padding record at the end of the data area */
+#define SHM_MSGQ_ID_PAD           0xFFFFFFFFU
+
+/**
+ * message record header
+ */
+struct shm_msg_hdr {
+	uint32_t len; /* length of the payload */
+	uint32_t id; /* message ID, SHM_MSGQ_ID_PAD for padding */
+};
+
+/**
+ * local state of one end of a shared memory message queue
+ */
+struct shm_msgq {
+	struct metal_io_region *io; /* Shared memory metal i/o region */
+	unsigned long ctrl_offset; /* control area offset */
+	unsigned long buf_offset; /* data area offset */
+	uint32_t size; /* size of the data area, power of two */
+	uint32_t head; /* producer index */
+	uint32_t tail; /* consumer index */
+	uint32_t peer; /* last index seen from the other end */
+	uint32_t next; /* consumer index after the peeked message */
+};
+
+/**
+ * @brief shm_msgq_record_size() - return the size of the record of a
+ *        message in the data area
+ *
+ * @param[in] len - length of the payload
+ */
+static inline uint32_t shm_msgq_record_size(size_t len)
+{
+	return (sizeof(struct shm_msg_hdr) + len + SHM_MSGQ_ALIGN - 1) &
+		~(SHM_MSGQ_ALIGN - 1);
+}
+
+/**
+ * @brief shm_msgq_max_len() - return the largest payload of a queue
+ *        A record is limited to half the data area, so that it always
+ *        fits once the queue is empty, whatever the padding.
+ *
+ * @param[in] q - queue
+ */
+static inline size_t shm_msgq_max_len(struct shm_msgq *q)
+{
+	return q->size / 2 - sizeof(struct shm_msg_hdr);
+}
+
+/**
+ * @brief shm_msgq_init() - Initialize the local state of a queue
+ *
+ * @param[in] q - queue to initialize
+ * @param[in] io - shared memory i/o region
+ * @param[in] ctrl_offset - offset of the control area
+ * @param[in] buf_offset - offset of the data area
+ * @param[in] size - size of the data area, power of two
+ * @return - 0 on success, error code if failure.
+ */
+int shm_msgq_init(struct shm_msgq *q, struct metal_io_region *io,
+		  unsigned long ctrl_offset, unsigned long buf_offset,
+		  uint32_t size);
+
+/**
+ * @brief shm_msgq_reset() - Producer side: reset the queue indices and
+ *        publish the queue geometry in the shared memory. It must only
+ *        be called while the consumer is not accessing the queue.
+ *
+ * @param[in] q - queue
+ */
+void shm_msgq_reset(struct shm_msgq *q);
+
+/**
+ * @brief shm_msgq_attach() - Consumer side: read the queue geometry
+ *        published by the producer and reset the local consumer index.
+ *
+ * @param[in] q - queue
+ * @return - 0 on success, error code if failure.
+ */
+int shm_msgq_attach(struct shm_msgq *q);
+
+/**
+ * @brief shm_msgq_reserve() - Producer side: zero-copy access to the
+ *        payload of the next message. The caller builds the payload in
+ *        place and then calls shm_msgq_commit().
+ *
+ * @param[in] q - queue
+ * @param[in] len - length of the payload to build
+ * @return - pointer to the payload, NULL if the queue is full or if the
+ *           payload is larger than shm_msgq_max_len().
+ */
+void *shm_msgq_reserve(struct shm_msgq *q, size_t len);
+
+/**
+ * @brief shm_msgq_commit() - Producer side: write the header of the
+ *        message reserved with shm_msgq_reserve(). The message is not
+ *        visible to the consumer until shm_msgq_publish().
+ *
+ * @param[in] q - queue
+ * @param[in] id - message ID, not SHM_MSGQ_ID_PAD
+ * @param[in] len - length of the payload built, at most the reserved one
+ */
+void shm_msgq_commit(struct shm_msgq *q, uint32_t id, size_t len);
+
+/**
+ * @brief shm_msgq_send() - Producer side: copy a message to the queue.
+ *        The message is not visible to the consumer until
+ *        shm_msgq_publish().
+ *
+ * @param[in] q - queue
+ * @param[in] id - message ID, not SHM_MSGQ_ID_PAD
+ * @param[in] src - payload
+ * @param[in] len - length of the payload
+ * @return - length of the payload, -EAGAIN if the queue is full,
+ *           -EINVAL if the payload is larger than shm_msgq_max_len().
+ */
+int shm_msgq_send(struct shm_msgq *q, uint32_t id, const void *src,
+		  size_t len);
+
+/**
+ * @brief shm_msgq_publish() - Producer side: make all the messages
+ *        written visible to the consumer.
+ *
+ * @param[in] q - queue
+ */
+void shm_msgq_publish(struct shm_msgq *q);
+
+/**
+ * @brief shm_msgq_available() - Consumer side: number of published bytes
+ *        not read yet, records and padding.
+ *
+ * @param[in] q - queue
+ * @return - number of bytes ready to read, 0 if the queue is empty.
+ */
+uint32_t shm_msgq_available(struct shm_msgq *q);
+
+/**
+ * @brief shm_msgq_peek() - Consumer side: zero-copy access to the payload
+ *        of the next message. The payload stays valid until the message
+ *        is consumed with shm_msgq_consume().
+ *
+ * @param[in] q - queue
+ * @param[out] id - message ID
+ * @param[out] len - length of the payload
+ * @return - pointer to the payload, NULL if the queue is empty or if the
+ *           record is invalid.
+ */
+void *shm_msgq_peek(struct shm_msgq *q, uint32_t *id, size_t *len);
+
+/**
+ * @brief shm_msgq_consume() - Consumer side: move past the message
+ *        returned by shm_msgq_peek(). Its space is given back to the
+ *        producer with shm_msgq_release().
+ *
+ * @param[in] q - queue
+ */
+void shm_msgq_consume(struct shm_msgq *q);
+
+/**
+ * @brief shm_msgq_recv() - Consumer side: copy the payload of the next
+ *        message and consume it. A payload larger than the destination
+ *        buffer is not read and the message is not consumed, its length
+ *        is returned by shm_msgq_peek().
+ *
+ * @param[in] q - queue
+ * @param[out] id - message ID
+ * @param[out] dst - destination buffer
+ * @param[in] len - size of the destination buffer
+ * @return - number of bytes read, -EAGAIN if the queue is empty,
+ *           -EINVAL if the record is invalid, -ENOSPC if the payload is
+ *           larger than the destination buffer.
+ */
+int shm_msgq_recv(struct shm_msgq *q, uint32_t *id, void *dst, size_t len);
+
+/**
+ * @brief shm_msgq_release() - Consumer side: give the space of all the
+ *        consumed messages back to the producer.
+ *
+ * @param[in] q - queue
+ */
+void shm_msgq_release(struct shm_msgq *q);
+
+#endif /* __SHM_MSGQ_H__ */
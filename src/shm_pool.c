@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_pool.c
+ * Fixed size buffer pool in shared memory.
+ * See shm_pool.h for the shared memory structure of the pool.
+ */
+
+#include <errno.h>
+#include <metal/io.h>
+#include "common.h"
+#include "shm_pool.h"
+
+/**
+ * @brief shm_pool_bufs_offset() - return offset of the first buffer in
+ *        the pool area, after the return ring
+ *
+ * @param[in] num_bufs - number of buffers
+ */
+static inline unsigned long shm_pool_bufs_offset(uint32_t num_bufs)
+{
+	return (SHM_POOL_RING_OFFSET + num_bufs * sizeof(uint32_t) +
+		SHM_POOL_ALIGN - 1) & ~(unsigned long)(SHM_POOL_ALIGN - 1);
+}
+
+/**
+ * @brief shm_pool_buf_index() - return the number of a buffer
+ *
+ * @param[in] pool - pool
+ * @param[in] offset - offset of the buffer in the i/o region
+ * @return - buffer number, -EINVAL if it is not a buffer of the pool.
+ */
+static int shm_pool_buf_index(struct shm_pool *pool, unsigned long offset)
+{
+	unsigned long rel;
+
+	if (offset < pool->buf_offset)
+		return -EINVAL;
+	rel = offset - pool->buf_offset;
+	if (rel % pool->buf_size || rel / pool->buf_size >= pool->num_bufs)
+		return -EINVAL;
+	return (int)(rel / pool->buf_size);
+}
+
+int shm_pool_init(struct shm_pool *pool, struct metal_io_region *io,
+		  unsigned long offset, size_t size, uint32_t buf_size)
+{
+	uint32_t num_bufs;
+
+	if (!pool || !io || !buf_size || (offset & (SHM_POOL_ALIGN - 1)) ||
+	    offset + size > metal_io_region_size(io))
+		return -EINVAL;
+	buf_size = (buf_size + SHM_POOL_ALIGN - 1) & ~(SHM_POOL_ALIGN - 1);
+	for (num_bufs = SHM_POOL_BUFS_MAX; num_bufs &&
+	     shm_pool_bufs_offset(num_bufs) +
+	     (unsigned long)num_bufs * buf_size > size; num_bufs >>= 1);
+	if (!num_bufs)
+		return -EINVAL;
+
+	pool->io = io;
+	pool->offset = offset;
+	pool->buf_offset = offset + shm_pool_bufs_offset(num_bufs);
+	pool->num_bufs = num_bufs;
+	pool->buf_size = buf_size;
+	shm_pool_reset(pool);
+	return 0;
+}
+
+void shm_pool_reset(struct shm_pool *pool)
+{
+	uint32_t i;
+
+	/* Buffer 0 is on top of the free list */
+	for (i = 0; i < pool->num_bufs; i++)
+		pool->free_bufs[i] = pool->num_bufs - 1 - i;
+	pool->num_free = pool->num_bufs;
+	pool->ret = 0;
+	metal_io_write32(pool->io, pool->offset + SHM_POOL_RET_OFFSET, 0);
+	metal_io_write32(pool->io, pool->offset + SHM_POOL_NBUFS_OFFSET,
+			 pool->num_bufs);
+	metal_io_write32(pool->io, pool->offset + SHM_POOL_BUF_SIZE_OFFSET,
+			 pool->buf_size);
+	metal_io_write32(pool->io, pool->offset + SHM_POOL_BUFS_OFFSET,
+			 pool->buf_offset - pool->offset);
+	shm_cache_flush(pool->io, pool->offset, SHM_POOL_RING_OFFSET);
+}
+
+int shm_pool_attach(struct shm_pool *pool, struct metal_io_region *io,
+		    unsigned long offset)
+{
+	uint32_t num_bufs, buf_size, bufs_offset;
+
+	if (!pool || !io)
+		return -EINVAL;
+	shm_cache_invalidate(io, offset, SHM_POOL_RING_OFFSET);
+	num_bufs = metal_io_read32(io, offset + SHM_POOL_NBUFS_OFFSET);
+	buf_size = metal_io_read32(io, offset + SHM_POOL_BUF_SIZE_OFFSET);
+	bufs_offset = metal_io_read32(io, offset + SHM_POOL_BUFS_OFFSET);
+	if (!num_bufs || (num_bufs & (num_bufs - 1)) ||
+	    num_bufs > SHM_POOL_BUFS_MAX || !buf_size ||
+	    bufs_offset < shm_pool_bufs_offset(num_bufs) ||
+	    offset + bufs_offset + (unsigned long)num_bufs * buf_size >
+	    metal_io_region_size(io))
+		return -EINVAL;
+
+	pool->io = io;
+	pool->offset = offset;
+	pool->buf_offset = offset + bufs_offset;
+	pool->num_bufs = num_bufs;
+	pool->buf_size = buf_size;
+	pool->ret = 0;
+	pool->num_free = 0;
+	return 0;
+}
+
+uint32_t shm_pool_reclaim(struct shm_pool *pool)
+{
+	unsigned long entry;
+	uint32_t ret, i, n = 0;
+
+	shm_cache_invalidate(pool->io, pool->offset + SHM_POOL_RET_OFFSET,
+			     sizeof(uint32_t));
+	ret = metal_io_read32(pool->io, pool->offset + SHM_POOL_RET_OFFSET);
+	for (; pool->ret != ret; pool->ret++) {
+		entry = pool->offset + SHM_POOL_RING_OFFSET +
+			(pool->ret & (pool->num_bufs - 1)) * sizeof(uint32_t);
+		shm_cache_invalidate(pool->io, entry, sizeof(uint32_t));
+		i = metal_io_read32(pool->io, entry);
+		/* Drop what cannot be a returned buffer */
+		if (i >= pool->num_bufs || pool->num_free >= pool->num_bufs)
+			continue;
+		pool->free_bufs[pool->num_free++] = i;
+		n++;
+	}
+	return n;
+}
+
+unsigned long shm_pool_alloc(struct shm_pool *pool)
+{
+	uint32_t i;
+
+	if (!shm_pool_available(pool))
+		return METAL_BAD_OFFSET;
+	i = pool->free_bufs[--pool->num_free];
+	return pool->buf_offset + (unsigned long)i * pool->buf_size;
+}
+
+int shm_pool_free(struct shm_pool *pool, unsigned long offset)
+{
+	int i;
+
+	i = shm_pool_buf_index(pool, offset);
+	if (i < 0 || pool->num_free >= pool->num_bufs)
+		return -EINVAL;
+	pool->free_bufs[pool->num_free++] = i;
+	return 0;
+}
+
+int shm_pool_return(struct shm_pool *pool, unsigned long offset)
+{
+	unsigned long entry;
+	int i;
+
+	i = shm_pool_buf_index(pool, offset);
+	if (i < 0)
+		return i;
+	entry = pool->offset + SHM_POOL_RING_OFFSET +
+		(pool->ret & (pool->num_bufs - 1)) * sizeof(uint32_t);
+	metal_io_write32(pool->io, entry, i);
+	shm_cache_flush(pool->io, entry, sizeof(uint32_t));
+	/* The entry is visible before the new return index */
+	pool->ret++;
+	metal_io_write32(pool->io, pool->offset + SHM_POOL_RET_OFFSET,
+			 pool->ret);
+	shm_cache_flush(pool->io, pool->offset + SHM_POOL_RET_OFFSET,
+			sizeof(uint32_t));
+	return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_pool.h
+ * Fixed size buffer pool in shared memory.
+ *
+ * The pool carves an area of the shared memory device into buffers of one
+ * size class, aligned on SHM_POOL_ALIGN. The producer owns the pool: it
+ * allocates buffers from a local free list, fills them and hands them to
+ * the consumer, e.g. in the descriptors of a shm_ring. Once done with a
+ * buffer, the consumer hands it back through the return ring of the pool,
+ * and the producer reclaims the returned buffers into its free list when
+ * it runs out. Allocation and free are O(1), the free list is LIFO so the
+ * working set stays as small as the traffic allows.
+ *
+ * The return ring has an entry per buffer and at most all the buffers are
+ * with the consumer, so it cannot overflow and the producer does not
+ * publish its return ring index. Return indices are free running 32bit
+ * counters, the entry of an index is (index & (number of buffers - 1)),
+ * so the number of buffers is a power of two.
+ *
+ * Here is the structure of the pool area:
+ * |0x00 - 0x03 | number of buffers, written by producer |
+ * |0x04 - 0x07 | buffer size, written by producer |
+ * |0x08 - 0x0B | offset of the first buffer in the pool area, written by
+ *                producer |
+ * |0x40 - 0x43 | return index, written by consumer |
+ * |0x80 - ...  | return ring, buffer number per entry, written by
+ *                consumer |
+ * |...         | buffers, from the first buffer offset |
+ */
+
+#ifndef __SHM_POOL_H__
+#define __SHM_POOL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <metal/io.h>
+
+/* Pool control offsets, relative to the pool area */
+#define SHM_POOL_NBUFS_OFFSET     0x00 /* number of buffers */
+#define SHM_POOL_BUF_SIZE_OFFSET  0x04 /* size of one buffer */
+#define SHM_POOL_BUFS_OFFSET      0x08 /* offset of the first buffer */
+#define SHM_POOL_RET_OFFSET       0x40 /* return index */
+#define SHM_POOL_RING_OFFSET      0x80 /* return ring */
+
+/* Alignment of the buffers, a cache line */
+#define SHM_POOL_ALIGN            64
+
+/* Maximum number of buffers of a pool */
+#define SHM_POOL_BUFS_MAX         1024
+
+/**
+ * local state of one end of a shared memory buffer pool
+ */
+struct shm_pool {
+	struct metal_io_region *io; /* Shared memory metal i/o region */
+	unsigned long offset; /* pool area offset */
+	unsigned long buf_offset; /* first buffer offset */
+	uint32_t num_bufs; /* number of buffers, power of two */
+	uint32_t buf_size; /* size of one buffer */
+	uint32_t ret; /* return index */
+	uint32_t num_free; /* number of buffers in the free list */
+	uint16_t free_bufs[SHM_POOL_BUFS_MAX]; /* producer free list */
+};
+
+/**
+ * @brief shm_pool_init() - Producer side: initialize the local state of a
+ *        pool, with as many buffers as fit in the area, up to
+ *        SHM_POOL_BUFS_MAX
+ *
+ * @param[in] pool - pool to initialize
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset of the pool area, aligned on SHM_POOL_ALIGN
+ * @param[in] size - size of the pool area
+ * @param[in] buf_size - size of one buffer, rounded up to SHM_POOL_ALIGN
+ * @return - 0 on success, error code if failure.
+ */
+int shm_pool_init(struct shm_pool *pool, struct metal_io_region *io,
+		  unsigned long offset, size_t size, uint32_t buf_size);
+
+/**
+ * @brief shm_pool_reset() - Producer side: free all the buffers and
+ *        publish the pool geometry in the shared memory. It must only be
+ *        called while the consumer holds no buffer.
+ *
+ * @param[in] pool - pool
+ */
+void shm_pool_reset(struct shm_pool *pool);
+
+/**
+ * @brief shm_pool_attach() - Consumer side: read the pool geometry
+ *        published by the producer and reset the local return index.
+ *
+ * @param[in] pool - pool
+ * @param[in] io - shared memory i/o region
+ * @param[in] offset - offset of the pool area
+ * @return - 0 on success, error code if failure.
+ */
+int shm_pool_attach(struct shm_pool *pool, struct metal_io_region *io,
+		    unsigned long offset);
+
+/**
+ * @brief shm_pool_reclaim() - Producer side: move the buffers returned by
+ *        the consumer to the free list
+ *
+ * @param[in] pool - pool
+ * @return - number of buffers reclaimed.
+ */
+uint32_t shm_pool_reclaim(struct shm_pool *pool);
+
+/**
+ * @brief shm_pool_available() - Producer side: check a buffer can be
+ *        allocated, reclaiming the returned buffers if the free list is
+ *        empty
+ *
+ * @param[in] pool - pool
+ * @return - number of buffers in the free list.
+ */
+static inline uint32_t shm_pool_available(struct shm_pool *pool)
+{
+	if (!pool->num_free)
+		shm_pool_reclaim(pool);
+	return pool->num_free;
+}
+
+/**
+ * @brief shm_pool_alloc() - Producer side: allocate a buffer
+ *
+ * @param[in] pool - pool
+ * @return - offset of the buffer in the i/o region, METAL_BAD_OFFSET if
+ *           all the buffers are allocated.
+ */
+unsigned long shm_pool_alloc(struct shm_pool *pool);
+
+/**
+ * @brief shm_pool_free() - Producer side: free a buffer the consumer has
+ *        not been given
+ *
+ * @param[in] pool - pool
+ * @param[in] offset - offset of the buffer in the i/o region
+ * @return - 0 on success, -EINVAL if it is not a buffer of the pool.
+ */
+int shm_pool_free(struct shm_pool *pool, unsigned long offset);
+
+/**
+ * @brief shm_pool_return() - Consumer side: hand a buffer back to the
+ *        producer
+ *
+ * @param[in] pool - pool
+ * @param[in] offset - offset of the buffer in the i/o region
+ * @return - 0 on success, -EINVAL if it is not a buffer of the pool.
+ */
+int shm_pool_return(struct shm_pool *pool, unsigned long offset);
+
+#endif /* __SHM_POOL_H__ */
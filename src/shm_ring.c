@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_ring.c
+ * Single producer / single consumer descriptor ring in shared memory.
+ * See shm_ring.h for the shared memory structure of the ring.
+ */
+
+#include <errno.h>
+#include <metal/io.h>
+#include "common.h"
+#include "shm_ring.h"
+
+/**
+ * @brief shm_ring_desc_offset() - return offset of the descriptor of index
+ *
+ * @param[in] ring - ring
+ * @param[in] idx - free running ring index
+ */
+static inline unsigned long shm_ring_desc_offset(struct shm_ring *ring,
+						 uint32_t idx)
+{
+	return ring->ctrl_offset + SHM_RING_DESC_OFFSET +
+		(idx & (ring->num_slots - 1)) * sizeof(struct shm_ring_desc);
+}
+
+/**
+ * @brief shm_ring_slot_offset() - return offset of the slot buffer of index
+ *
+ * @param[in] ring - ring
+ * @param[in] idx - free running ring index
+ */
+static inline unsigned long shm_ring_slot_offset(struct shm_ring *ring,
+						 uint32_t idx)
+{
+	return ring->buf_offset +
+		(unsigned long)(idx & (ring->num_slots - 1)) * ring->slot_size;
+}
+
+int shm_ring_init(struct shm_ring *ring, struct metal_io_region *io,
+		  unsigned long ctrl_offset, unsigned long buf_offset,
+		  uint32_t num_slots, uint32_t slot_size)
+{
+	if (!ring || !io || !num_slots || (num_slots & (num_slots - 1)))
+		return -EINVAL;
+	if (ctrl_offset + SHM_RING_DESC_OFFSET +
+	    num_slots * sizeof(struct shm_ring_desc) >
+	    metal_io_region_size(io))
+		return -EINVAL;
+	if (buf_offset + (unsigned long)num_slots * slot_size >
+	    metal_io_region_size(io))
+		return -EINVAL;
+
+	ring->io = io;
+	ring->ctrl_offset = ctrl_offset;
+	ring->buf_offset = buf_offset;
+	ring->num_slots = num_slots;
+	ring->slot_size = slot_size;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->peer = 0;
+	return 0;
+}
+
+void shm_ring_reset(struct shm_ring *ring)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->peer = 0;
+	metal_io_write32(ring->io, ring->ctrl_offset + SHM_RING_USED_OFFSET, 0);
+	metal_io_write32(ring->io, ring->ctrl_offset + SHM_RING_NSLOTS_OFFSET,
+			 ring->num_slots);
+	metal_io_write32(ring->io,
+			 ring->ctrl_offset + SHM_RING_SLOT_SIZE_OFFSET,
+			 ring->slot_size);
+	metal_io_write32(ring->io, ring->ctrl_offset + SHM_RING_AVAIL_OFFSET,
+			 0);
+	shm_cache_flush(ring->io, ring->ctrl_offset, SHM_RING_DESC_OFFSET);
+}
+
+int shm_ring_attach(struct shm_ring *ring)
+{
+	uint32_t num_slots;
+
+	shm_cache_invalidate(ring->io, ring->ctrl_offset, SHM_RING_DESC_OFFSET);
+	num_slots = metal_io_read32(ring->io,
+				ring->ctrl_offset + SHM_RING_NSLOTS_OFFSET);
+	if (!num_slots || (num_slots & (num_slots - 1)))
+		return -EINVAL;
+	if (ring->ctrl_offset + SHM_RING_DESC_OFFSET +
+	    num_slots * sizeof(struct shm_ring_desc) >
+	    metal_io_region_size(ring->io))
+		return -EINVAL;
+	ring->num_slots = num_slots;
+	ring->slot_size = metal_io_read32(ring->io,
+				ring->ctrl_offset + SHM_RING_SLOT_SIZE_OFFSET);
+	ring->head = 0;
+	ring->tail = 0;
+	ring->peer = 0;
+	return 0;
+}
+
+uint32_t shm_ring_space(struct shm_ring *ring)
+{
+	uint32_t space;
+
+	space = ring->num_slots - (ring->head - ring->peer);
+	if (!space) {
+		/* Only go to the shared memory if the cached consumer
+		 * index says the ring is full */
+		shm_cache_invalidate(ring->io,
+				ring->ctrl_offset + SHM_RING_USED_OFFSET,
+				sizeof(uint32_t));
+		ring->peer = metal_io_read32(ring->io,
+				ring->ctrl_offset + SHM_RING_USED_OFFSET);
+		space = ring->num_slots - (ring->head - ring->peer);
+	}
+	return space;
+}
+
+/**
+ * @brief shm_ring_post() - fill in the descriptor of the head slot and
+ *        advance the producer index
+ *
+ * @param[in] ring - ring
+ * @param[in] data_offset - offset of the slot buffer
+ * @param[in] len - length of the data in the slot
+ */
+static void shm_ring_post(struct shm_ring *ring, unsigned long data_offset,
+			  size_t len)
+{
+	unsigned long desc_offset;
+	uint32_t buf_phy_addr_32;
+
+	/* Write the descriptor to tell the other end the buffer address */
+	desc_offset = shm_ring_desc_offset(ring, ring->head);
+	buf_phy_addr_32 = (uint32_t)metal_io_phys(ring->io, data_offset);
+	metal_io_write32(ring->io, desc_offset, buf_phy_addr_32);
+	metal_io_write32(ring->io, desc_offset + sizeof(uint32_t), len);
+	shm_cache_flush(ring->io, desc_offset, sizeof(struct shm_ring_desc));
+
+	ring->head++;
+}
+
+int shm_ring_write(struct shm_ring *ring, const void *src, size_t len)
+{
+	unsigned long data_offset;
+
+	if (len > ring->slot_size)
+		return -EINVAL;
+	if (!shm_ring_space(ring))
+		return -EAGAIN;
+
+	/* Write data to the slot */
+	data_offset = shm_ring_slot_offset(ring, ring->head);
+	metal_io_block_write(ring->io, data_offset, src, len);
+	shm_cache_flush(ring->io, data_offset, len);
+
+	shm_ring_post(ring, data_offset, len);
+	return (int)len;
+}
+
+void *shm_ring_reserve(struct shm_ring *ring, size_t len)
+{
+	if (len > ring->slot_size || !shm_ring_space(ring))
+		return NULL;
+	return metal_io_virt(ring->io, shm_ring_slot_offset(ring, ring->head));
+}
+
+void shm_ring_commit(struct shm_ring *ring, size_t len)
+{
+	unsigned long data_offset;
+
+	data_offset = shm_ring_slot_offset(ring, ring->head);
+	shm_cache_flush(ring->io, data_offset, len);
+	shm_ring_post(ring, data_offset, len);
+}
+
+int shm_ring_post_buf(struct shm_ring *ring, unsigned long offset,
+		      size_t len)
+{
+	if (len > ring->slot_size)
+		return -EINVAL;
+	if (!shm_ring_space(ring))
+		return -EAGAIN;
+
+	shm_cache_flush(ring->io, offset, len);
+	shm_ring_post(ring, offset, len);
+	return (int)len;
+}
+
+void shm_ring_publish(struct shm_ring *ring)
+{
+	/* metal_io_write32() is sequentially consistent, the slot data and
+	 * descriptors are visible before the new producer index, they have
+	 * already been flushed if the shared memory is cacheable */
+	metal_io_write32(ring->io, ring->ctrl_offset + SHM_RING_AVAIL_OFFSET,
+			 ring->head);
+	shm_cache_flush(ring->io, ring->ctrl_offset + SHM_RING_AVAIL_OFFSET,
+			sizeof(uint32_t));
+}
+
+uint32_t shm_ring_available(struct shm_ring *ring)
+{
+	shm_cache_invalidate(ring->io, ring->ctrl_offset + SHM_RING_AVAIL_OFFSET,
+			     sizeof(uint32_t));
+	ring->peer = metal_io_read32(ring->io,
+				ring->ctrl_offset + SHM_RING_AVAIL_OFFSET);
+	return ring->peer - ring->tail;
+}
+
+/**
+ * @brief shm_ring_next() - get the buffer of the tail slot
+ *
+ * @param[in] ring - ring
+ * @param[out] data_offset - offset of the slot buffer
+ * @param[out] len - length of the data in the slot
+ * @return - 0 on success, -EAGAIN if the ring is empty, -EINVAL if the
+ *           descriptor is invalid.
+ */
+static int shm_ring_next(struct shm_ring *ring, unsigned long *data_offset,
+			 uint32_t *len)
+{
+	unsigned long desc_offset;
+	uint32_t buf_phy_addr_32;
+
+	if (ring->peer == ring->tail && !shm_ring_available(ring))
+		return -EAGAIN;
+
+	/* Get the buffer location from the descriptor */
+	desc_offset = shm_ring_desc_offset(ring, ring->tail);
+	shm_cache_invalidate(ring->io, desc_offset,
+			     sizeof(struct shm_ring_desc));
+	buf_phy_addr_32 = metal_io_read32(ring->io, desc_offset);
+	*len = metal_io_read32(ring->io, desc_offset + sizeof(uint32_t));
+	*data_offset = metal_io_phys_to_offset(ring->io,
+					(metal_phys_addr_t)buf_phy_addr_32);
+	if (*data_offset == METAL_BAD_OFFSET || *len > ring->slot_size)
+		return -EINVAL;
+
+	shm_cache_invalidate(ring->io, *data_offset, *len);
+	return 0;
+}
+
+int shm_ring_read(struct shm_ring *ring, void *dst, size_t len)
+{
+	unsigned long data_offset;
+	uint32_t buf_len;
+	int ret;
+
+	ret = shm_ring_next(ring, &data_offset, &buf_len);
+	if (ret)
+		return ret;
+	if (buf_len < len)
+		len = buf_len;
+
+	/* Read data from the slot */
+	metal_io_block_read(ring->io, data_offset, dst, len);
+
+	shm_ring_release(ring);
+	return (int)len;
+}
+
+void *shm_ring_peek(struct shm_ring *ring, size_t *len)
+{
+	unsigned long data_offset;
+	uint32_t buf_len;
+
+	if (shm_ring_next(ring, &data_offset, &buf_len))
+		return NULL;
+	*len = buf_len;
+	return metal_io_virt(ring->io, data_offset);
+}
+
+void shm_ring_release(struct shm_ring *ring)
+{
+	/* Release the slot to the producer */
+	ring->tail++;
+	metal_io_write32(ring->io, ring->ctrl_offset + SHM_RING_USED_OFFSET,
+			 ring->tail);
+	shm_cache_flush(ring->io, ring->ctrl_offset + SHM_RING_USED_OFFSET,
+			sizeof(uint32_t));
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * shm_ring.h
+ * Single producer / single consumer descriptor ring in shared memory.
+ *
+ * The ring lives in a descriptor area of the shared memory device and
+ * points to fixed size slots in a buffer area. Producer and consumer
+ * indices are free running 32bit counters, the slot of an index is
+ * (index & (num_slots - 1)), so num_slots must be a power of two.
+ *
+ * Here is the structure of the descriptor area:
+ * |0x00 - 0x03 | avail: producer index, written by producer |
+ * |0x04 - 0x07 | number of slots, written by producer |
+ * |0x08 - 0x0B | slot size, written by producer |
+ * |0x40 - 0x43 | used: consumer index, written by consumer |
+ * |0x80 - ...  | descriptor array, struct shm_ring_desc per slot |
+ *
+ * The consumer index sits on its own cache line so that the two sides
+ * never write to the same line.
+ */
+
+#ifndef __SHM_RING_H__
+#define __SHM_RING_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <metal/io.h>
+
+/* Ring control offsets, relative to the descriptor area */
+#define SHM_RING_AVAIL_OFFSET     0x00 /* producer index */
+#define SHM_RING_NSLOTS_OFFSET    0x04 /* number of slots */
+#define SHM_RING_SLOT_SIZE_OFFSET 0x08 /* size of one slot */
+#define SHM_RING_USED_OFFSET      0x40 /* consumer index */
+#define SHM_RING_DESC_OFFSET      0x80 /* descriptor array */
+
+/**
+ * ring descriptor, one per slot
+ */
+struct shm_ring_desc {
+	uint32_t addr; /* physical address of the buffer */
+	uint32_t len;  /* length of the data in the buffer */
+};
+
+/**
+ * local state of one end of a shared memory ring
+ */
+struct shm_ring {
+	struct metal_io_region *io; /* Shared memory metal i/o region */
+	unsigned long ctrl_offset; /* descriptor area offset */
+	unsigned long buf_offset; /* slot buffers offset */
+	uint32_t num_slots; /* number of slots, power of two */
+	uint32_t slot_size; /* size of one slot */
+	uint32_t head; /* producer index */
+	uint32_t tail; /* consumer index */
+	uint32_t peer; /* last index seen from the other end */
+};
+
+/**
+ * @brief shm_ring_init() - Initialize the local state of a ring
+ *
+ * @param[in] ring - ring to initialize
+ * @param[in] io - shared memory i/o region
+ * @param[in] ctrl_offset - offset of the descriptor area
+ * @param[in] buf_offset - offset of the slot buffers
+ * @param[in] num_slots - number of slots, power of two
+ * @param[in] slot_size - size of one slot
+ * @return - 0 on success, error code if failure.
+ */
+int shm_ring_init(struct shm_ring *ring, struct metal_io_region *io,
+		  unsigned long ctrl_offset, unsigned long buf_offset,
+		  uint32_t num_slots, uint32_t slot_size);
+
+/**
+ * @brief shm_ring_reset() - Producer side: reset the ring indices and
+ *        publish the ring geometry in the shared memory. It must only
+ *        be called while the consumer is not accessing the ring.
+ *
+ * @param[in] ring - ring
+ */
+void shm_ring_reset(struct shm_ring *ring);
+
+/**
+ * @brief shm_ring_attach() - Consumer side: read the ring geometry
+ *        published by the producer and reset the local consumer index.
+ *
+ * @param[in] ring - ring
+ * @return - 0 on success, error code if failure.
+ */
+int shm_ring_attach(struct shm_ring *ring);
+
+/**
+ * @brief shm_ring_space() - Producer side: number of free slots
+ *
+ * @param[in] ring - ring
+ * @return - number of slots which can be written without overwriting
+ *           data the consumer has not released yet.
+ */
+uint32_t shm_ring_space(struct shm_ring *ring);
+
+/**
+ * @brief shm_ring_write() - Producer side: copy data to the next slot
+ *        and fill in its descriptor. The data is not visible to the
+ *        consumer until shm_ring_publish() is called.
+ *
+ * @param[in] ring - ring
+ * @param[in] src - data to write
+ * @param[in] len - length of the data
+ * @return - number of bytes written, -EAGAIN if the ring is full,
+ *           -EINVAL if the data does not fit in a slot.
+ */
+int shm_ring_write(struct shm_ring *ring, const void *src, size_t len);
+
+/**
+ * @brief shm_ring_reserve() - Producer side: zero-copy access to the next
+ *        slot. The caller builds the data in place and then calls
+ *        shm_ring_commit().
+ *
+ * @param[in] ring - ring
+ * @param[in] len - length of the data to build
+ * @return - pointer to the slot, NULL if the ring is full or if the data
+ *           does not fit in a slot.
+ */
+void *shm_ring_reserve(struct shm_ring *ring, size_t len);
+
+/**
+ * @brief shm_ring_commit() - Producer side: fill in the descriptor of the
+ *        slot returned by shm_ring_reserve(). Like shm_ring_write(), the
+ *        data is not visible to the consumer until shm_ring_publish().
+ *
+ * @param[in] ring - ring
+ * @param[in] len - length of the data built in the slot
+ */
+void shm_ring_commit(struct shm_ring *ring, size_t len);
+
+/**
+ * @brief shm_ring_post_buf() - Producer side: post a buffer outside of the
+ *        slot buffers, e.g. from a shm_pool, in the next descriptor. The
+ *        caller keeps the ownership of the buffer. Like shm_ring_write(),
+ *        the data is not visible to the consumer until shm_ring_publish().
+ *
+ * @param[in] ring - ring
+ * @param[in] offset - offset of the buffer in the shared memory i/o region
+ * @param[in] len - length of the data in the buffer
+ * @return - number of bytes posted, -EAGAIN if the ring is full,
+ *           -EINVAL if the data does not fit in a slot.
+ */
+int shm_ring_post_buf(struct shm_ring *ring, unsigned long offset,
+		      size_t len);
+
+/**
+ * @brief shm_ring_publish() - Producer side: make all written slots
+ *        visible to the consumer.
+ *
+ * @param[in] ring - ring
+ */
+void shm_ring_publish(struct shm_ring *ring);
+
+/**
+ * @brief shm_ring_available() - Consumer side: number of published
+ *        slots not read yet.
+ *
+ * @param[in] ring - ring
+ * @return - number of slots ready to read.
+ */
+uint32_t shm_ring_available(struct shm_ring *ring);
+
+/**
+ * @brief shm_ring_read() - Consumer side: copy the data of the next
+ *        slot and release the slot to the producer.
+ *
+ * @param[in] ring - ring
+ * @param[out] dst - destination buffer
+ * @param[in] len - size of the destination buffer
+ * @return - number of bytes read, -EAGAIN if the ring is empty,
+ *           -EINVAL if the descriptor is invalid.
+ */
+int shm_ring_read(struct shm_ring *ring, void *dst, size_t len);
+
+/**
+ * @brief shm_ring_peek() - Consumer side: zero-copy access to the data of
+ *        the next slot. The slot stays owned by the consumer until
+ *        shm_ring_release() is called.
+ *
+ * @param[in] ring - ring
+ * @param[out] len - length of the data in the slot
+ * @return - pointer to the data, NULL if the ring is empty or if the
+ *           descriptor is invalid.
+ */
+void *shm_ring_peek(struct shm_ring *ring, size_t *len);
+
+/**
+ * @brief shm_ring_release() - Consumer side: release the slot returned by
+ *        shm_ring_peek() to the producer.
+ *
+ * @param[in] ring - ring
+ */
+void shm_ring_release(struct shm_ring *ring);
+
+#endif /* __SHM_RING_H__ */
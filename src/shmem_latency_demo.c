@@ -10,16 +10,29 @@
  * This demo does so via the following steps:
  *
  *  1. Get the shared memory device I/O region.
- *  1. Get the TTC timer device I/O region.
+ *  1. Get the TTC timer device I/O region, initialize the timestamp source.
  *  2. Get the IPI device I/O region.
  *  3. Register IPI interrupt handler.
  *  4. Write to shared memory to indicate demo starts
- *  5. Reset the APU to RPU TTC counter, write data to the shared memory, then
+ *  5. Start the APU to RPU interval, write data to the shared memory, then
  *     kick IPI to notify the remote.
  *  6. When it receives IPI interrupt, the IPI interrupt handler marks the
  *     remote has kicked.
  *  7. Accumulate APU to RPU and RPU to APU counter values.
- *  8. Repeat step 5, 6 and 7 for 1000 times
+ *  8. Repeat step 5, 6 and 7 for 1000 times, for each package size, first
+ *     copying the messages from/to a private buffer, in chunks of the
+ *     private buffer size, then building and reading them in place in the
+ *     shared memory (zero-copy), then copying them with a CRC32C of the
+ *     payload computed during the copy, stored in the message header and
+ *     checked on the echo. The TX and RX buffers are 4MB each.
+ *     The CRC32C cost per package size is reported against the plain
+ *     copy.
+ *     Before, the per package cost of the copies themselves is measured on
+ *     the APU alone for the small sizes, with the generic block copy and
+ *     with the fixed size copies of shm_copy.h.
+ *     After, with demo_params.pipe_window, the pipelined latency is
+ *     measured with several messages in flight, see
+ *     measure_pipelined_latency().
  *  9. Write shared memory to indicate RPU about demo finishes and kick
  *     IPI to notify.
  * 10. Clean up: disable IPI interrupt, deregister the IPI interrupt handler.
@@ -35,91 +48,70 @@
 #include <metal/device.h>
 #include <metal/irq.h>
 #include "common.h"
-
-#define TTC_CNT_APU_TO_RPU 2 /* APU to RPU TTC counter ID */
-#define TTC_CNT_RPU_TO_APU 3 /* RPU to APU TTC counter ID */
-
-#define TTC_CLK_FREQ_HZ	100000000
-#define NS_PER_SEC     1000000000
-#define NS_PER_TTC_TICK	(NS_PER_SEC / TTC_CLK_FREQ_HZ)
-
-/* Shared memory offset */
-#define SHM_DEMO_CNTRL_OFFSET 0x0 /* Shared memory for the demo status */
-#define SHM_BUFF_OFFSET_TX 0x1000 /* Shared memory TX buffer start offset */
-#define SHM_BUFF_OFFSET_RX 0x2000 /* Shared memory RX buffer start offset */
+#include "timestamp.h"
+#include "demo_params.h"
+#include "results.h"
+#include "notify.h"
+#include "shm_copy.h"
+#include "shm_crc.h"
+#include "shm_ring.h"
+#include "shm_layout.h"
+#include "bench.h"
+#include "cold.h"
+#include "ocm.h"
 
 #define DEMO_STATUS_IDLE         0x0
 #define DEMO_STATUS_START        0x1 /* Status value to indicate demo start */
+#define DEMO_STATUS_PIPELINE     0x2 /* Status value of the pipelined phase */
 
-#define ITERATIONS 1000
+/* Pipelined latency rings, a window of messages always fits */
+#define PIPE_RING_SLOTS          PIPE_WINDOW_MAX
+#define PIPE_SLOT_SIZE           (SHM_LAT_BUF_SIZE / PIPE_RING_SLOTS)
+
+/* How to wait for the RPU kick, see enum wait_policy */
+#ifndef SHMEM_LATENCY_WAIT_POLICY
+#define SHMEM_LATENCY_WAIT_POLICY WAIT_POLICY_WFI
+#endif
 
-#define BUF_SIZE_MAX 4096
-#define PKG_SIZE_MIN 16
-#define PKG_SIZE_MAX 1024
 
 struct channel_s {
 	struct metal_io_region *ipi_io; /* IPI metal i/o region */
 	struct metal_io_region *shm_io; /* Shared memory metal i/o region */
 	struct metal_io_region *ttc_io; /* TTC metal i/o region */
+	struct ts_timer ts; /* timestamp source */
 	uint32_t ipi_mask; /* APU IPI mask */
+	enum wait_policy wait_policy; /* how to wait for the remote kick */
 	atomic_flag remote_nkicked; /* 0 - kicked from remote */
 };
 
+/* Copy overhead: package sizes, and packages copied per sample */
+static const size_t copy_overhead_sizes[] = { 16, 32, 64, 128 };
+#define COPY_OVERHEAD_SIZES_NUM \
+	(sizeof(copy_overhead_sizes) / sizeof(copy_overhead_sizes[0]))
+#define COPY_OVERHEAD_BATCH 64
+
+/* Message header flags */
+#define MSG_FLAG_CRC 0x1 /* crc holds the CRC32C of the payload */
+
 struct msg_hdr_s {
 	uint32_t index;
-	uint32_t len;
+	uint32_t len; /* payload length, after the header */
+	uint32_t crc; /* CRC32C of the payload if MSG_FLAG_CRC */
+	uint32_t flags; /* MSG_FLAG_* */
 };
 
-/**
- * @brief read_timer() - return TTC counter value
- *
- * @param[in] ttc_io - TTC timer i/o region
- * @param[in] cnt_id - counter ID
- */
-static inline uint32_t read_timer(struct metal_io_region *ttc_io,
-				unsigned long cnt_id)
-{
-	unsigned long offset = XTTCPS_CNT_VAL_OFFSET +
-				XTTCPS_CNT_OFFSET(cnt_id);
-
-	return metal_io_read32(ttc_io, offset);
-}
-
-/**
- * @brief reset_timer() - function to reset TTC counter
- *        Set the RST bit in the Count Control Reg.
- *
- * @param[in] ttc_io - TTC timer i/o region
- * @param[in] cnt_id - counter id
- */
-static inline void reset_timer(struct metal_io_region *ttc_io,
-				unsigned long cnt_id)
-{
-	uint32_t val;
-	unsigned long offset = XTTCPS_CNT_CNTRL_OFFSET +
-				XTTCPS_CNT_OFFSET(cnt_id);
-
-	val = XTTCPS_CNT_CNTRL_RST_MASK;
-	metal_io_write32(ttc_io, offset, val);
-}
-
-/**
- * @brief stop_timer() - function to stop TTC counter
- *        Set the disable bit in the Count Control Reg.
- *
- * @param[in] ttc_io - TTC timer i/o region
- * @param[in] cnt_id - counter id
- */
-static inline void stop_timer(struct metal_io_region *ttc_io,
-				unsigned long cnt_id)
-{
-	uint32_t val;
-	unsigned long offset = XTTCPS_CNT_CNTRL_OFFSET +
-				XTTCPS_CNT_OFFSET(cnt_id);
+/* How the messages are moved between the private buffer and the shared
+ * memory */
+enum msg_mode {
+	MSG_MODE_COPY = 0, /* copied from/to the private buffer */
+	MSG_MODE_ZERO_COPY, /* built and read in place */
+	MSG_MODE_CRC, /* copied with a CRC32C of the payload */
+	MSG_MODES_NUM,
+};
 
-	val = XTTCPS_CNT_CNTRL_DIS_MASK;
-	metal_io_write32(ttc_io, offset, val);
-}
+static const char *const msg_mode_names[MSG_MODES_NUM] = {
+	"copy", "zero-copy", "copy + CRC32C",
+};
 
 /**
  * @brief ipi_irq_handler() - IPI interrupt handler
@@ -135,23 +127,609 @@ static inline void stop_timer(struct metal_io_region *ttc_io,
  *           not the interrupt it expected.
  *
  */
-static int ipi_irq_handler (int vect_id, void *priv)
+static OCM_TEXT int ipi_irq_handler (int vect_id, void *priv)
 {
 	struct channel_s *ch = (struct channel_s *)priv;
 	uint32_t val;
 	(void)vect_id;
 
+	trace_event(TRACE_IRQ_ENTER, vect_id);
 	if (ch) {
 		val = metal_io_read32(ch->ipi_io, IPI_ISR_OFFSET);
 		if (val & ch->ipi_mask) {
 			metal_io_write32(ch->ipi_io, IPI_ISR_OFFSET, ch->ipi_mask);
 			atomic_flag_clear(&ch->remote_nkicked);
+			trace_event(TRACE_FLAG_CLEAR, vect_id);
 			return METAL_IRQ_HANDLED;
 		}
 	}
 	return METAL_IRQ_NOT_HANDLED;
 }
 
+/**
+ * @brief measure_pkg_latency() - Measure latency of one package size
+ *        Send demo_params.iterations messages of size s to RPU, wait for
+ *        each echo and accumulate the APU to RPU and RPU to APU counter
+ *        values. With cold statistics, send COLD_ITERATIONS messages
+ *        instead, each one from cold, and only accumulate the cold
+ *        statistics.
+ *
+ * @param[in] ch - channel information
+ * @param[in] lbuf - private buffer for the messages
+ * @param[in] s - message size
+ * @param[in] mode - how the messages are moved, see enum msg_mode
+ * @param[out] a2r - APU to RPU statistics
+ * @param[out] r2a - RPU to APU statistics
+ * @param[out] a2r_hist - APU to RPU histogram
+ * @param[out] r2a_hist - RPU to APU histogram
+ * @param[in/out] cold - cold statistics, NULL for the warm messages
+ * @return - 0 on success, error code if failure.
+ */
+static int measure_pkg_latency(struct channel_s *ch, void *lbuf, size_t s,
+			       enum msg_mode mode, struct metal_stat *a2r,
+			       struct metal_stat *r2a,
+			       struct metal_hist *a2r_hist,
+			       struct metal_hist *r2a_hist,
+			       struct cold_stat *cold)
+{
+	struct msg_hdr_s *msg_hdr, rx_hdr;
+	uint64_t a2r_val, r2a_val;
+	uint32_t i, crc, iterations;
+	int ret;
+
+	iterations = cold ? COLD_ITERATIONS : demo_params.iterations;
+	for (i = 1; i <= iterations; i++) {
+		if (cold)
+			cold_prepare(cold->mode);
+		/* Start APU to RPU interval */
+		ts_start(&ch->ts, TS_APU_TO_RPU);
+		if (mode == MSG_MODE_ZERO_COPY) {
+			/* prepare data in place, the payload then the
+			 * header */
+			trace_event(TRACE_COPY_START, s);
+			metal_io_block_set(ch->shm_io,
+				SHM_LAT_TX_OFFSET + sizeof(*msg_hdr), 0xA,
+				s - sizeof(*msg_hdr));
+			trace_event(TRACE_COPY_END, s);
+			msg_hdr = metal_io_virt(ch->shm_io, SHM_LAT_TX_OFFSET);
+			msg_hdr->index = i;
+			msg_hdr->len = s - sizeof(*msg_hdr);
+			msg_hdr->crc = 0;
+			msg_hdr->flags = 0;
+		} else if (mode == MSG_MODE_CRC) {
+			/* prepare the header */
+			msg_hdr = lbuf;
+			msg_hdr->index = i;
+			msg_hdr->len = s - sizeof(*msg_hdr);
+			msg_hdr->flags = MSG_FLAG_CRC;
+			/* Copy the payload to the shared memory, in chunks of
+			 * the private buffer size, with its CRC, then the
+			 * header holding the CRC */
+			trace_event(TRACE_COPY_START, s);
+			ret = shm_block_write_crc_chunked(ch->shm_io,
+					SHM_LAT_TX_OFFSET + sizeof(*msg_hdr),
+					lbuf, demo_params.buf_size_max,
+					msg_hdr->len, &crc);
+			msg_hdr->crc = crc;
+			if (ret >= 0)
+				ret = metal_io_block_write(ch->shm_io,
+						SHM_LAT_TX_OFFSET, msg_hdr,
+						sizeof(*msg_hdr));
+			trace_event(TRACE_COPY_END, s);
+			if (ret != sizeof(*msg_hdr)) {
+				LPERROR("Write shm failure: %lu,%d\n", s, ret);
+				return -1;
+			}
+		} else {
+			/* prepare data */
+			msg_hdr = lbuf;
+			msg_hdr->index = i;
+			msg_hdr->len = s - sizeof(*msg_hdr);
+			msg_hdr->crc = 0;
+			msg_hdr->flags = 0;
+			/* Copy data to the shared memory, in chunks of the
+			 * private buffer size */
+			trace_event(TRACE_COPY_START, s);
+			ret = shm_block_write_chunked(ch->shm_io,
+					SHM_LAT_TX_OFFSET, lbuf,
+					demo_params.buf_size_max, s);
+			trace_event(TRACE_COPY_END, s);
+			if ((size_t)ret != s) {
+				LPERROR("Write shm failure: %lu,%lu\n",
+					s, (size_t)ret);
+				return -1;
+			}
+		}
+		shm_cache_flush(ch->shm_io, SHM_LAT_TX_OFFSET, s);
+		/* Kick IPI to notify the remote */
+		trace_event(TRACE_KICK, ch->ipi_mask);
+		notify_kick(ch->ipi_io, ch->ipi_mask);
+		/* irq handler stops timer for rpu->apu irq */
+		notify_wait(&ch->remote_nkicked, ch->wait_policy);
+		/* Read message */
+		shm_cache_invalidate(ch->shm_io, SHM_LAT_RX_OFFSET, s);
+		if (mode == MSG_MODE_ZERO_COPY) {
+			/* Read the whole message in place */
+			msg_hdr = metal_io_virt(ch->shm_io, SHM_LAT_RX_OFFSET);
+			trace_event(TRACE_COPY_START, s);
+			(void)shm_block_sum(msg_hdr, s);
+			trace_event(TRACE_COPY_END, s);
+		} else if (mode == MSG_MODE_CRC) {
+			/* Read the header, then the payload with its CRC */
+			trace_event(TRACE_COPY_START, s);
+			metal_io_block_read(ch->shm_io, SHM_LAT_RX_OFFSET,
+					    &rx_hdr, sizeof(rx_hdr));
+			msg_hdr = &rx_hdr;
+			crc = 0;
+			if (msg_hdr->len == s - sizeof(*msg_hdr))
+				shm_block_read_crc_chunked(ch->shm_io,
+					SHM_LAT_RX_OFFSET + sizeof(*msg_hdr),
+					lbuf, demo_params.buf_size_max,
+					msg_hdr->len, &crc);
+			trace_event(TRACE_COPY_END, s);
+		} else {
+			/* lbuf holds the first chunk, with the header */
+			trace_event(TRACE_COPY_START, s);
+			shm_block_read_chunked(ch->shm_io,
+					SHM_LAT_RX_OFFSET, lbuf,
+					demo_params.buf_size_max, s);
+			trace_event(TRACE_COPY_END, s);
+			msg_hdr = lbuf;
+		}
+		if (msg_hdr->len != (s - sizeof(*msg_hdr))) {
+			LPERROR("Read shm failure: %lu,%lu\n",
+				s, msg_hdr->len + sizeof(*msg_hdr));
+			return -1;
+		}
+		if (mode == MSG_MODE_CRC &&
+		    (!(msg_hdr->flags & MSG_FLAG_CRC) || msg_hdr->crc != crc)) {
+			LPERROR("Payload CRC mismatch: %lu, %u: 0x%08x,0x%08x\n",
+				s, i, msg_hdr->crc, crc);
+			return -1;
+		}
+		/* Stop RPU to APU interval */
+		ts_stop(&ch->ts, TS_RPU_TO_APU);
+
+		a2r_val = ts_read(&ch->ts, TS_APU_TO_RPU);
+		r2a_val = ts_read(&ch->ts, TS_RPU_TO_APU);
+		if (cold) {
+			cold_stat_update(cold, a2r_val, r2a_val);
+			continue;
+		}
+		update_stat(a2r, a2r_val);
+		update_stat(r2a, r2a_val);
+		update_hist(a2r_hist, a2r_val);
+		update_hist(r2a_hist, r2a_val);
+	}
+	return 0;
+}
+
+/**
+ * @brief measure_copy_path() - Measure the per package cost of one copy
+ *        path, writing then reading back COPY_OVERHEAD_BATCH packages per
+ *        sample to/from the TX buffer. The RPU is not involved.
+ *
+ * @param[in] ch - channel information
+ * @param[in] lbuf - private buffer for the packages
+ * @param[in] s - package size
+ * @param[in] copy - fixed size copy, NULL for the generic block copy
+ * @param[out] wr - write statistics, in system count ticks per sample
+ * @param[out] rd - read statistics, in system count ticks per sample
+ * @param[out] wr_hist - write histogram
+ * @param[out] rd_hist - read histogram
+ */
+static void measure_copy_path(struct channel_s *ch, void *lbuf, size_t s,
+			      shm_copy_fixed_fn copy, struct metal_stat *wr,
+			      struct metal_stat *rd,
+			      struct metal_hist *wr_hist,
+			      struct metal_hist *rd_hist)
+{
+	uint64_t start, val;
+	uint32_t i, j;
+
+	for (i = 0; i < demo_params.iterations; i++) {
+		start = ts_now();
+		if (copy) {
+			for (j = 0; j < COPY_OVERHEAD_BATCH; j++)
+				shm_block_write_fixed(ch->shm_io,
+						      SHM_LAT_TX_OFFSET, lbuf,
+						      copy, s);
+		} else {
+			for (j = 0; j < COPY_OVERHEAD_BATCH; j++)
+				metal_io_block_write(ch->shm_io,
+						     SHM_LAT_TX_OFFSET, lbuf,
+						     s);
+		}
+		val = ts_now() - start;
+		update_stat(wr, val);
+		update_hist(wr_hist, val);
+
+		start = ts_now();
+		if (copy) {
+			for (j = 0; j < COPY_OVERHEAD_BATCH; j++)
+				shm_block_read_fixed(ch->shm_io,
+						     SHM_LAT_TX_OFFSET, lbuf,
+						     copy, s);
+		} else {
+			for (j = 0; j < COPY_OVERHEAD_BATCH; j++)
+				metal_io_block_read(ch->shm_io,
+						    SHM_LAT_TX_OFFSET, lbuf,
+						    s);
+		}
+		val = ts_now() - start;
+		update_stat(rd, val);
+		update_hist(rd_hist, val);
+	}
+}
+
+/**
+ * @brief measure_copy_overhead() - Compare the per package cost of the
+ *        generic block copy and of the fixed size copies for the small
+ *        package sizes, and export the results
+ *
+ * @param[in] ch - channel information
+ * @param[in] lbuf - private buffer for the packages
+ */
+static void measure_copy_overhead(struct channel_s *ch, void *lbuf)
+{
+	static struct metal_hist wr_hist, rd_hist;
+	struct demo_result res;
+	shm_copy_fixed_fn copy;
+	size_t s;
+	uint32_t i;
+	int fixed;
+
+	LPRINTF("Starting copy overhead, %u packages per sample\n\t"
+		"[min,max] are in system count ticks: %lu Hz\n",
+		COPY_OVERHEAD_BATCH, ts_cnt_freq());
+	for (i = 0; i < COPY_OVERHEAD_SIZES_NUM; i++) {
+		s = copy_overhead_sizes[i];
+		if (s > demo_params.buf_size_max)
+			continue;
+		for (fixed = 0; fixed <= 1; fixed++) {
+			struct metal_stat wr = STAT_INIT;
+			struct metal_stat rd = STAT_INIT;
+
+			copy = fixed ? shm_copy_fixed(s) : NULL;
+			if (fixed && !copy)
+				continue;
+			reset_hist(&wr_hist);
+			reset_hist(&rd_hist);
+			measure_copy_path(ch, lbuf, s, copy, &wr, &rd,
+					  &wr_hist, &rd_hist);
+
+			RPRINTF("package size %lu copy overhead (%s):\n", s,
+				fixed ? "fixed size" : "generic");
+			RPRINTF("  write: [%lu, %lu] avg: %lu ns per package\n",
+				wr.st_min, wr.st_max,
+				ts_cnt_to_ns(wr.st_sum) /
+				(wr.st_cnt * COPY_OVERHEAD_BATCH));
+			RPRINTF("  read: [%lu, %lu] avg: %lu ns per package\n",
+				rd.st_min, rd.st_max,
+				ts_cnt_to_ns(rd.st_sum) /
+				(rd.st_cnt * COPY_OVERHEAD_BATCH));
+
+			memset(&res, 0, sizeof(res));
+			res.test = DEMO_TEST_SHMEM_COPY;
+			res.pkg_size = s;
+			res.flags = fixed ? RESULT_FIXED_COPY : 0;
+			res.batch = COPY_OVERHEAD_BATCH;
+			res.dir = TS_APU_TO_RPU;
+			res.stat = wr;
+			hist_percentiles(&wr_hist, wr.st_max, &res.pctl);
+			print_pctl("  write", &res.pctl);
+			results_add(&res, &wr_hist);
+			res.dir = TS_RPU_TO_APU;
+			res.stat = rd;
+			hist_percentiles(&rd_hist, rd.st_max, &res.pctl);
+			print_pctl("  read", &res.pctl);
+			results_add(&res, &rd_hist);
+		}
+	}
+	LPRINTF("Finished copy overhead\n");
+}
+
+/**
+ * @brief report_crc_cost() - Report the cost of the payload CRC32C per
+ *        package size, from the average round trips of the copy and the
+ *        copy + CRC32C runs
+ *
+ * @param[in] rt_ns - average round trip in ns, per mode and package size
+ */
+static void report_crc_cost(uint64_t rt_ns[MSG_MODES_NUM][DEMO_SIZES_MAX])
+{
+	uint64_t copy, crc;
+	size_t s;
+	uint32_t i;
+
+	RPRINTF("CRC32C cost per package size, average round trip:\n");
+	for (i = 0; i < demo_params.num_sizes; i++) {
+		s = demo_params.sizes[i];
+		copy = rt_ns[MSG_MODE_COPY][i];
+		crc = rt_ns[MSG_MODE_CRC][i];
+		if (!copy || !crc)
+			continue;
+		/* A package goes to the RPU and back in a round trip */
+		RPRINTF("  package size %lu: copy %lu ns %lu MB/s, "
+			"copy + CRC32C %lu ns %lu MB/s, cost %ld ns (%ld%%)\n",
+			s, copy, 2 * s * 1000 / copy, crc, 2 * s * 1000 / crc,
+			(long)(crc - copy), (long)(crc - copy) * 100 /
+			(long)copy);
+	}
+}
+
+/**
+ * @brief measure_cold_latency() - Measure the copy messages from cold per
+ *        package size and report them apart from the warm ones, see
+ *        cold.h
+ *
+ * @param[in] ch - channel information
+ * @param[in] lbuf - private buffer for the messages
+ * @param[in] warm_rt_ns - average warm round trip in ns per package size
+ * @return - 0 on success, error code if failure.
+ */
+static int measure_cold_latency(struct channel_s *ch, void *lbuf,
+				const uint64_t warm_rt_ns[DEMO_SIZES_MAX])
+{
+	struct cold_stat cold;
+	struct demo_result res;
+	enum cold_mode mode;
+	size_t s;
+	uint32_t i;
+	int ret;
+
+	for (i = 0; i < demo_params.num_sizes; i++) {
+		s = demo_params.sizes[i];
+		RPRINTF("package size %lu cold latency (%s, %s):\n", s,
+			msg_mode_names[MSG_MODE_COPY],
+			notify_wait_name(ch->wait_policy));
+		memset(&res, 0, sizeof(res));
+		res.test = DEMO_TEST_SHMEM_LATENCY;
+		res.pkg_size = s;
+		for (mode = COLD_MODE_EVICT; mode < COLD_MODES_NUM; mode++) {
+			cold_stat_init(&cold, mode);
+			ret = measure_pkg_latency(ch, lbuf, s, MSG_MODE_COPY,
+						  NULL, NULL, NULL, NULL,
+						  &cold);
+			if (ret)
+				return ret;
+			cold_report(&res, &cold, warm_rt_ns[i]);
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief measure_pipe_window() - Measure the pipelined latency of one
+ *        package size and window
+ *        Send demo_params.iterations messages of size s through the tx
+ *        ring, with up to window of them in flight, and complete each one
+ *        when its echo is read from the rx ring. The round trip of a
+ *        message is from just before it is written to the tx ring to just
+ *        after its echo is read, so it includes the time it queues behind
+ *        the other messages in flight.
+ *        With zero_copy, the messages are built in place in the tx ring
+ *        slots with shm_ring_reserve()/shm_ring_commit() and read in place
+ *        in the rx ring slots with shm_ring_peek()/shm_ring_release(),
+ *        instead of being copied from/to the private buffer.
+ *
+ * @param[in] ch - channel information
+ * @param[in] tx - APU to RPU ring
+ * @param[in] rx - RPU to APU ring
+ * @param[in] lbuf - private buffer for the messages
+ * @param[in] s - message size
+ * @param[in] window - maximum number of messages in flight
+ * @param[in] zero_copy - 1 to build/read the messages in place
+ * @param[out] rt - round trip statistics, in system count ticks
+ * @param[out] rt_hist - round trip histogram
+ * @param[out] elapsed - interval of the run, in system count ticks
+ * @return - 0 on success, error code if failure.
+ */
+static int measure_pipe_window(struct channel_s *ch, struct shm_ring *tx,
+			       struct shm_ring *rx, void *lbuf, size_t s,
+			       uint32_t window, int zero_copy,
+			       struct metal_stat *rt,
+			       struct metal_hist *rt_hist, uint64_t *elapsed)
+{
+	static uint64_t sent_at[PIPE_RING_SLOTS];
+	struct msg_hdr_s *msg_hdr;
+	uint32_t sent = 0, done = 0, posted;
+	uint64_t start, val;
+	size_t len;
+	int ret;
+
+	start = ts_now();
+	while (done < demo_params.iterations) {
+		/* Fill the window, the messages are tagged by their index */
+		for (posted = 0; sent < demo_params.iterations &&
+		     sent - done < window; posted++, sent++) {
+			sent_at[sent & (PIPE_RING_SLOTS - 1)] = ts_now();
+			msg_hdr = zero_copy ? shm_ring_reserve(tx, s) : lbuf;
+			if (!msg_hdr)
+				break;
+			if (zero_copy)
+				/* Build the payload in place in the slot */
+				metal_io_block_set(ch->shm_io,
+					metal_io_virt_to_offset(ch->shm_io,
+								msg_hdr + 1),
+					0xA, s - sizeof(*msg_hdr));
+			msg_hdr->index = sent;
+			msg_hdr->len = s - sizeof(*msg_hdr);
+			msg_hdr->crc = 0;
+			msg_hdr->flags = 0;
+			if (zero_copy) {
+				shm_ring_commit(tx, s);
+				continue;
+			}
+			ret = shm_ring_write(tx, lbuf, s);
+			if (ret == -EAGAIN)
+				break;
+			if (ret < 0) {
+				LPERROR("Write ring failure: %lu,%d\n", s, ret);
+				return ret;
+			}
+		}
+		if (posted) {
+			shm_ring_publish(tx);
+			trace_event(TRACE_KICK, ch->ipi_mask);
+			notify_kick(ch->ipi_io, ch->ipi_mask);
+		}
+		notify_wait(&ch->remote_nkicked, ch->wait_policy);
+
+		/* Complete the echoed messages, they come back in order */
+		while (done < sent && shm_ring_available(rx)) {
+			if (zero_copy) {
+				/* Read the whole message in place in the
+				 * slot */
+				msg_hdr = shm_ring_peek(rx, &len);
+				ret = msg_hdr ? (int)len : -EINVAL;
+				if (msg_hdr)
+					(void)shm_block_sum(msg_hdr, len);
+			} else {
+				ret = shm_ring_read(rx, lbuf, s);
+				msg_hdr = lbuf;
+			}
+			val = ts_now() - sent_at[done & (PIPE_RING_SLOTS - 1)];
+			if (ret != (int)s || msg_hdr->index != done ||
+			    msg_hdr->len != s - sizeof(*msg_hdr)) {
+				LPERROR("Read ring failure: %lu, %u: %d,%u\n",
+					s, done, ret,
+					msg_hdr ? msg_hdr->index : 0);
+				return -EINVAL;
+			}
+			if (zero_copy)
+				shm_ring_release(rx);
+			update_stat(rt, val);
+			update_hist(rt_hist, val);
+			done++;
+		}
+	}
+	*elapsed = ts_now() - start;
+	return 0;
+}
+
+/**
+ * @brief measure_pipelined_latency() - Measure the latency with several
+ *        messages in flight and export the throughput/latency curve
+ *        For each package size, the window of messages in flight goes
+ *        from 1 to demo_params.pipe_window, doubling each run. The sizes
+ *        are measured copying the messages, then building and reading
+ *        them in place in the ring slots, so the latency of the zero-copy
+ *        ring API is measured too.
+ *        The messages go through a pair of rings, see shm_ring.h, with
+ *        their descriptor areas at SHM_PIPE_DESC_TX_OFFSET and
+ *        SHM_PIPE_DESC_RX_OFFSET and their slots in the latency TX and RX
+ *        buffers. The APU resets the tx ring, sets the demo status to
+ *        DEMO_STATUS_PIPELINE and kicks. On this first kick the RPU
+ *        attaches to the tx ring, resets the rx ring and kicks back. On
+ *        each next kick, it echoes the available messages of the tx ring
+ *        to the rx ring, as they are and in order, publishes them and
+ *        kicks. The rings are not reset between the runs.
+ *        On a failure the phase stops with messages possibly in flight,
+ *        the caller releases the RPU with the demo finished status.
+ *
+ * @param[in] ch - channel information
+ * @param[in] lbuf - private buffer for the messages
+ * @return - 0 on success, error code if failure.
+ */
+static int measure_pipelined_latency(struct channel_s *ch, void *lbuf)
+{
+	static struct metal_hist rt_hist;
+	struct shm_ring tx, rx;
+	struct demo_result res;
+	uint64_t elapsed, elapsed_ns;
+	uint32_t i, window, last = demo_params.pipe_window;
+	size_t s;
+	int zero_copy;
+	int ret;
+
+	ret = shm_ring_init(&tx, ch->shm_io, SHM_PIPE_DESC_TX_OFFSET,
+			    SHM_LAT_TX_OFFSET, PIPE_RING_SLOTS,
+			    PIPE_SLOT_SIZE);
+	if (!ret)
+		ret = shm_ring_init(&rx, ch->shm_io, SHM_PIPE_DESC_RX_OFFSET,
+				    SHM_LAT_RX_OFFSET, PIPE_RING_SLOTS,
+				    PIPE_SLOT_SIZE);
+	if (ret) {
+		LPERROR("Failed to initialize the pipelined rings.\n");
+		return ret;
+	}
+
+	LPRINTF("Starting pipelined latency, %u messages per window\n\t"
+		"[min,max] are in system count ticks: %lu Hz\n",
+		demo_params.iterations, ts_cnt_freq());
+	shm_ring_reset(&tx);
+	metal_io_write32(ch->shm_io, SHM_DEMO_STATUS_OFFSET,
+			 DEMO_STATUS_PIPELINE);
+	shm_cache_flush(ch->shm_io, SHM_DEMO_STATUS_OFFSET, sizeof(uint32_t));
+	notify_kick(ch->ipi_io, ch->ipi_mask);
+	notify_wait(&ch->remote_nkicked, ch->wait_policy);
+	ret = shm_ring_attach(&rx);
+	if (ret) {
+		LPERROR("Failed to attach to the RPU ring.\n");
+		return ret;
+	}
+
+	/* Every package size copying the messages, then in place */
+	for (i = 0; i < 2 * demo_params.num_sizes; i++) {
+		s = demo_params.sizes[i % demo_params.num_sizes];
+		zero_copy = i >= demo_params.num_sizes;
+		if (s > demo_params.buf_size_max || s > PIPE_SLOT_SIZE) {
+			if (!zero_copy)
+				LPRINTF("package size %lu: skipped, larger "
+					"than a ring slot or the private "
+					"buffer\n", s);
+			continue;
+		}
+		RPRINTF("package size %lu pipelined latency%s (%s):\n", s,
+			zero_copy ? ", zero-copy" : "",
+			notify_wait_name(ch->wait_policy));
+		for (window = 1; ; window <<= 1) {
+			struct metal_stat rt = STAT_INIT;
+
+			/* The last window is the largest, even if it is not a
+			 * power of two */
+			window = window > last ? last : window;
+			reset_hist(&rt_hist);
+			ret = measure_pipe_window(ch, &tx, &rx, lbuf, s, window,
+						  zero_copy, &rt, &rt_hist,
+						  &elapsed);
+			if (ret) {
+				LPERROR("package size %lu window %u: "
+					"pipelined run failed: %d\n",
+					s, window, ret);
+				return ret;
+			}
+
+			/* A message goes to the RPU and back */
+			elapsed_ns = ts_cnt_to_ns(elapsed);
+			elapsed_ns = elapsed_ns ? elapsed_ns : 1;
+			RPRINTF("  window %u: %lu msg/s, %lu MB/s each way, "
+				"round trip [%lu, %lu] avg: %lu ns\n", window,
+				(uint64_t)rt.st_cnt * 1000000000 / elapsed_ns,
+				(uint64_t)rt.st_cnt * s * 1000 / elapsed_ns,
+				rt.st_min, rt.st_max,
+				ts_cnt_to_ns(rt.st_sum) / rt.st_cnt);
+
+			memset(&res, 0, sizeof(res));
+			res.test = DEMO_TEST_SHMEM_PIPELINE;
+			res.pkg_size = s;
+			res.window = window;
+			res.flags = zero_copy ? RESULT_ZERO_COPY : 0;
+			res.dir = TS_APU_TO_RPU;
+			res.apu_ticks = elapsed;
+			res.stat = rt;
+			hist_percentiles(&rt_hist, rt.st_max, &res.pctl);
+			print_pctl("  round trip", &res.pctl);
+			results_add(&res, &rt_hist);
+			if (window == last)
+				break;
+		}
+	}
+	LPRINTF("Finished pipelined latency\n");
+	return 0;
+}
+
 /**
  * @brief measure_shmem_latency() - Measure latency of using shared memory
  *        and IPI with libmetal.
@@ -170,132 +748,137 @@ static int ipi_irq_handler (int vect_id, void *priv)
  */
 static int measure_shmem_latency(struct channel_s *ch)
 {
+	static struct metal_hist a2r_hist, r2a_hist;
+	static uint64_t rt_ns[MSG_MODES_NUM][DEMO_SIZES_MAX];
+	struct demo_result res;
+	enum msg_mode mode;
 	size_t s;
-	struct msg_hdr_s *msg_hdr;
+	uint32_t i;
 	void *lbuf;
-	int ret, i;
+	int ret = 0;
 
 	LPRINTF("Starting shared memory latency\n\t"
-		"TTC [min,max] are in TTC ticks: %d ns per tick\n",
-		NS_PER_TTC_TICK);
+		"[min,max] are in %s ticks: %lu Hz\n\t"
+		"wait policy: %s\n",
+		ts_backend_name(), ts_freq(),
+		notify_wait_name(ch->wait_policy));
 	/* allocate memory for receiving data */
-	lbuf = metal_allocate_memory(BUF_SIZE_MAX);
+	lbuf = ocm_alloc(demo_params.buf_size_max);
 	if (!lbuf) {
 		LPERROR("Failed to allocate memory.\r\n");
 		return -1;
 	}
-	memset(lbuf, 0xA, BUF_SIZE_MAX);
+	memset(lbuf, 0xA, demo_params.buf_size_max);
+
+	/* APU only, before the RPU is told the demo has started */
+	measure_copy_overhead(ch, lbuf);
 
 	/* write to shared memory to indicate demo has started */
-	metal_io_write32(ch->shm_io, SHM_DEMO_CNTRL_OFFSET, DEMO_STATUS_START);
-
-	for (s = PKG_SIZE_MIN; s <= PKG_SIZE_MAX; s <<= 1) {
-		struct metal_stat a2r = STAT_INIT;
-		struct metal_stat r2a = STAT_INIT;
-		for (i = 1; i <= ITERATIONS; i++) {
-			/* Reset TTC counter */
-			reset_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU);
-			/* prepare data */
-			msg_hdr = lbuf;
-			msg_hdr->index = i;
-			msg_hdr->len = s - sizeof(*msg_hdr);
-			/* Copy data to the shared memory */
-			ret = metal_io_block_write(ch->shm_io,
-					SHM_BUFF_OFFSET_TX, lbuf, s);
-			if ((size_t)ret != s) {
-				LPERROR("Write shm failure: %lu,%lu\n",
-					s, (size_t)ret);
-				ret = -1;
+	metal_io_write32(ch->shm_io, SHM_DEMO_STATUS_OFFSET, DEMO_STATUS_START);
+	shm_cache_flush(ch->shm_io, SHM_DEMO_STATUS_OFFSET, sizeof(uint32_t));
+
+	memset(rt_ns, 0, sizeof(rt_ns));
+	for (mode = MSG_MODE_COPY; mode < MSG_MODES_NUM; mode++) {
+		for (i = 0; i < demo_params.num_sizes; i++) {
+			struct metal_stat a2r = STAT_INIT;
+			struct metal_stat r2a = STAT_INIT;
+
+			s = demo_params.sizes[i];
+			reset_hist(&a2r_hist);
+			reset_hist(&r2a_hist);
+			ret = measure_pkg_latency(ch, lbuf, s, mode,
+						  &a2r, &r2a,
+						  &a2r_hist, &r2a_hist, NULL);
+			if (ret)
 				goto out;
-			}
-			/* Kick IPI to notify the remote */
-			metal_io_write32(ch->ipi_io, IPI_TRIG_OFFSET, ch->ipi_mask);
-			/* irq handler stops timer for rpu->apu irq */
-			wait_for_notified(&ch->remote_nkicked);
-			/* Read message */
-			metal_io_block_read(ch->shm_io,
-					SHM_BUFF_OFFSET_RX,
-					lbuf, s);
-			msg_hdr = lbuf;
-			if (msg_hdr->len != (s - sizeof(*msg_hdr))) {
-				LPERROR("Read shm failure: %lu,%lu\n",
-					s, msg_hdr->len + sizeof(*msg_hdr));
-				ret = -1;
-				goto out;
-			}
-			/* Stop RPU to APU TTC counter */
-			stop_timer(ch->ttc_io, TTC_CNT_RPU_TO_APU);
 
-			update_stat(&a2r, read_timer(ch->ttc_io,
-					TTC_CNT_APU_TO_RPU));
-			update_stat(&r2a, read_timer(ch->ttc_io,
-					TTC_CNT_RPU_TO_APU));
+			/* report avg latencies */
+			RPRINTF("package size %lu latency (%s, %s):\n", s,
+				msg_mode_names[mode],
+				notify_wait_name(ch->wait_policy));
+			RPRINTF("  APU to RPU: [%lu, %lu] avg: %lu ns\n",
+				a2r.st_min, a2r.st_max,
+				ts_ticks_to_ns(a2r.st_sum) /
+				demo_params.iterations);
+			RPRINTF("  RPU to APU: [%lu, %lu] avg: %lu ns\n",
+				r2a.st_min, r2a.st_max,
+				ts_ticks_to_ns(r2a.st_sum) /
+				demo_params.iterations);
+			rt_ns[mode][i] = ts_ticks_to_ns(a2r.st_sum +
+							r2a.st_sum) /
+					 demo_params.iterations;
+
+			/* report percentiles and export the results */
+			memset(&res, 0, sizeof(res));
+			res.test = DEMO_TEST_SHMEM_LATENCY;
+			res.pkg_size = s;
+			res.flags = mode == MSG_MODE_ZERO_COPY ?
+				    RESULT_ZERO_COPY : 0;
+			if (mode == MSG_MODE_CRC)
+				res.flags |= RESULT_CRC;
+			res.dir = TS_APU_TO_RPU;
+			res.stat = a2r;
+			hist_percentiles(&a2r_hist, a2r.st_max, &res.pctl);
+			print_pctl("  APU to RPU", &res.pctl);
+			results_add(&res, &a2r_hist);
+			res.dir = TS_RPU_TO_APU;
+			res.stat = r2a;
+			hist_percentiles(&r2a_hist, r2a.st_max, &res.pctl);
+			print_pctl("  RPU to APU", &res.pctl);
+			results_add(&res, &r2a_hist);
 		}
+	}
 
-		/* report avg latencies */
-		LPRINTF("package size %lu latency:\n", s);
-		LPRINTF("  APU to RPU: [%lu, %lu] avg: %lu ns\n",
-			a2r.st_min, a2r.st_max,
-			a2r.st_sum * NS_PER_TTC_TICK / ITERATIONS);
-		LPRINTF("  RPU to APU: [%lu, %lu] avg: %lu ns\n",
-			r2a.st_min, r2a.st_max,
-			r2a.st_sum * NS_PER_TTC_TICK / ITERATIONS);
+	report_crc_cost(rt_ns);
+	if (demo_params.flags & DEMO_PARAMS_COLD) {
+		ret = measure_cold_latency(ch, lbuf, rt_ns[MSG_MODE_COPY]);
+		if (ret)
+			goto out;
+	}
+	if (demo_params.pipe_window) {
+		ret = measure_pipelined_latency(ch, lbuf);
+		if (ret)
+			goto out;
 	}
 
-	/* write to shared memory to indicate demo has finished */
-	metal_io_write32(ch->shm_io, SHM_DEMO_CNTRL_OFFSET, 0);
+out:
+	/* write to shared memory to indicate demo has finished, on a failure
+	 * too, so that the RPU stops waiting for messages */
+	metal_io_write32(ch->shm_io, SHM_DEMO_STATUS_OFFSET, 0);
+	shm_cache_flush(ch->shm_io, SHM_DEMO_STATUS_OFFSET, sizeof(uint32_t));
 	/* Kick IPI to notify the remote */
-	metal_io_write32(ch->ipi_io, IPI_TRIG_OFFSET, ch->ipi_mask);
+	notify_kick(ch->ipi_io, ch->ipi_mask);
 
-	LPRINTF("Finished shared memory latency\n");
-
-out:
-	metal_free_memory(lbuf);
-	return 0;
+	if (ret)
+		LPERROR("Shared memory latency failed: %d\n", ret);
+	else
+		LPRINTF("Finished shared memory latency\n");
+	ocm_free(lbuf);
+	return ret;
 }
 
-int shmem_latency_demo()
+int shmem_latency_demo(struct bench_channel *bch)
 {
-	struct channel_s ch;
-	int ipi_irq;
+	static struct channel_s ch OCM_BSS;
 	int ret = 0;
 
 	print_demo("shared memory latency");
 	memset(&ch, 0, sizeof(ch));
 
-	/* Get shared memory device IO region */
-	if (!shm_dev) {
-		ret = -ENODEV;
-		goto out;
-	}
-
-	/* Get SHM IO region */
-	ch.shm_io = metal_device_io_region(shm_dev, 0);
-	if (!ch.shm_io) {
-		LPERROR("Failed to map io region for %s.\n", shm_dev->name);
-		ret = -ENODEV;
-		goto out;
-	}
+	/* The regions are looked up once for all the tests */
+	ch.shm_io = bch->shm_io;
+	ch.ttc_io = bch->ttc_io;
+	ch.ipi_io = bch->ipi_io;
 
-	/* Get TTC IO region */
-	ch.ttc_io = metal_device_io_region(ttc_dev, 0);
-	if (!ch.ttc_io) {
-		LPERROR("Failed to map io region for %s.\n", ttc_dev->name);
-		ret = -ENODEV;
-		goto out;
-	}
-
-	/* Get IPI device IO region */
-	ch.ipi_io = metal_device_io_region(ipi_dev, 0);
-	if (!ch.ipi_io) {
-		LPERROR("Failed to map io region for %s.\n", ipi_dev->name);
-		ret = -ENODEV;
-		goto out;
+	/* Initialize the timestamp source */
+	ret = ts_init(&ch.ts, ch.ttc_io, ch.shm_io);
+	if (ret) {
+		LPERROR("Failed to initialize the timestamp source.\n");
+		return ret;
 	}
 
 	/* initialize remote_nkicked */
-	atomic_flag_clear(&ch.remote_nkicked);
-	atomic_flag_test_and_set(&ch.remote_nkicked);
+	notify_reset(&ch.remote_nkicked);
 
 	/* disable IPI interrupt */
 	metal_io_write32(ch.ipi_io, IPI_IDR_OFFSET, IPI_MASK);
@@ -303,26 +886,21 @@ int shmem_latency_demo()
 	metal_io_write32(ch.ipi_io, IPI_ISR_OFFSET, IPI_MASK);
 
 	ch.ipi_mask = IPI_MASK;
+	ch.wait_policy = SHMEM_LATENCY_WAIT_POLICY;
 
-	/* Get the IPI IRQ from the opened IPI device */
-	ipi_irq = (intptr_t)ipi_dev->irq_info;
-
-	/* Register IPI irq handler */
-	metal_irq_register(ipi_irq, ipi_irq_handler, &ch);
-	metal_irq_enable(ipi_irq);
+	/* Attach the IPI irq handler to the channel */
+	bench_irq_attach(bch, ipi_irq_handler, &ch);
 
 	/* Enable IPI interrupt */
-	metal_io_write32(ch.ipi_io, IPI_IER_OFFSET, IPI_MASK);
+	notify_irq_enable(ch.ipi_io, IPI_MASK);
 
 	/* Run atomic operation demo */
 	ret = measure_shmem_latency(&ch);
 
 	/* disable IPI interrupt */
 	metal_io_write32(ch.ipi_io, IPI_IDR_OFFSET, IPI_MASK);
-	/* unregister IPI irq handler */
-	metal_irq_disable(ipi_irq);
-	metal_irq_unregister(ipi_irq);
+	/* detach IPI irq handler */
+	bench_irq_detach(bch);
 
-out:
 	return ret;
 }
@@ -12,32 +12,122 @@
  *  1. Get the shared memory device libmetal I/O region.
  *  1. Get the TTC timer device libemtal I/O region.
  *  2. Get IPI device libmetal I/O region and the IPI interrupt vector.
- *  3. Register IPI interrupt handler.
+ *  2. Get the GDMA channel libmetal I/O region and interrupt vector.
+ *  3. Register IPI and GDMA interrupt handlers.
  *  6. Upload throughput measurement:
- *     Start TTC APU counter, write data to shared memory and kick IPI to
- *     notify remote. It will iterate for 1000 times, stop TTC APU counter.
+ *     Start APU interval, write data to shared memory and kick IPI to
+ *     notify remote. It will iterate for 1000 times, stop APU interval.
  *     Wait for RPU IPI kick to know RPU has finished receiving packages
  *     and RPU TX counter is ready to read. Read the APU TX and RPU RX
  *     counter values and save them. Repeat for different package sizes.
  *     After this measurement, kick IPI to notify the remote, the
  *     measurement has finished.
  *  7. Download throughput measurement:
- *     Start TTC APU counter, wait for IPI kick, check if data is available,
+ *     Start APU interval, wait for IPI kick, check if data is available,
  *     if yes, read as much data as possible from shared memory. It will
- *     iterates untill 1000 packages have been received, stop TTC APU counter.
- *     Wait for RPU IPI kick so that APU can get the TTC RPU TX counter
- *     value. Kick IPI to notify the remote it has read the TTCi counter.
+ *     iterates untill 1000 packages have been received, stop APU interval.
+ *     Wait for RPU IPI kick so that APU can get the RPU TX interval
+ *     value. Kick IPI to notify the remote it has read the interval.
  *     Repeat for different package size.
  *  8. Cleanup resource:
  *     disable IPI interrupt and deregister the IPI interrupt handler.
  *
  * Here is the Shared memory structure of this demo:
- * |0x0   - 0x03         | number of APU to RPU buffers available to RPU |
- * |0x04  - 0x1FFFFF     | address array for shared buffers from APU to RPU |
- * |0x200000 - 0x200004  | number of RPU to APU buffers available to APU |
- * |0x200004 - 0x3FFFFF  | address array for shared buffers from RPU to APU |
- * |0x400000 - 0x7FFFFF  | APU to RPU buffers |
- * |0x800000 - 0xAFFFFF  | RPU to APU buffers |
+ * |0x0   - 0xFFFFF      | APU to RPU ring descriptor area (see shm_ring.h) |
+ * |0x100000 - 0x1FFFFF  | APU to RPU buffer pool area (see shm_pool.h) |
+ * |0x200000 - 0x3FFFFF  | RPU to APU ring descriptor area (see shm_ring.h) |
+ * |0x400000 - 0x7FFFFF  | APU to RPU ring slot buffers |
+ * |0x800000 - 0xAFFFFF  | RPU to APU ring slot buffers |
+ * |0xB00000 - 0xB00003  | number of upload sweeps over all package sizes |
+ * |0xB00040 - 0xB00043  | number of measurement rounds |
+ * |0xB00080 - 0xB00083  | number of download sweeps over all package sizes |
+ * |0xB000C0 - 0xB000C3  | number of full duplex sweeps over all package sizes |
+ * |0xB00100 - 0xB00103  | number of messages of the message queue run |
+ * |0xB00140 - 0xB00143  | number of flow control runs over all package sizes |
+ * |0xB00180 - 0xB00183  | RPU delay per slot of the flow control run, in ns |
+ * |0xB001C0 - 0xB001C3  | last full duplex run done by RPU, from 1 |
+ * |0xB00200 - 0xB00203  | last flow control run done by RPU, from 1 |
+ * |0xB00240 - 0xB002BF  | flow control credit area (see shm_credit.h) |
+ * |0xC00000 - 0xDFFFFF  | DMA source, staging copy of the private buffer |
+ * Each control word is on a cache line of its own, see shm_layout.h.
+ *
+ * Both directions use a single producer / single consumer ring, slots are
+ * recycled once the consumer has released them, so the amount of data
+ * moved per package size is not limited by the size of the shared memory.
+ * A slot holds the largest package, up to the private buffer size. Larger
+ * packages are sent in chunks of the slot size in consecutive slots, the
+ * consumer counts the bytes of the packages. The RPU ring must not use
+ * larger slots than the APU ring.
+ * Before each package size the producer resets its ring, the consumer
+ * attaches to it when it is notified data has arrived.
+ *
+ * The upload measurement is repeated once per entry of tx_sweeps[], the
+ * download measurement once per entry of rx_sweeps[]:
+ * - batch: a batch of slots is published with a single avail update and
+ *   a single IPI kick, the RPU drains everything available on each kick.
+ * - zero_copy: packages are built in place in the ring slots and read in
+ *   place, instead of being copied from/to the private buffer.
+ * - pool: upload only, with zero_copy, packages are built in place in
+ *   buffers of the tx pool, see shm_pool.h, instead of the ring slots, and
+ *   the descriptors point to them. The pool area is the second half of the
+ *   APU to RPU descriptor area. The RPU returns each buffer to the pool
+ *   once it has read it, the APU reclaims the returned buffers when it
+ *   runs out, so the amount of shared memory the upload touches is the
+ *   pool whatever the ring size.
+ * - dma: upload only, each slot is filled by the GDMA channel, see zdma.h,
+ *   and published once the DMA is done. The upload is two deep: the DMA
+ *   fills the next slot while the APU publishes the filled ones. The APU
+ *   sleeps when it waits for the DMA, that idle time is reported. The DMA
+ *   source is a staging copy of the private buffer in the shared memory,
+ *   at SHM_DMA_SRC_OFFSET, so its physical address is known in a DomU too.
+ * Each DMA sweep is compared with the CPU copy sweep of the same batch,
+ * the first package size where it is faster is reported as the crossover
+ * size.
+ *
+ * After the download measurement, the full duplex measurement is run once
+ * per entry of duplex_sweeps[]: for each package size, the APU resets the
+ * tx ring and waits for a kick telling the RPU has reset the rx ring.
+ * Both sides then stream their packages and drain the other ring in the
+ * same loop, with the batch of the sweep for the APU uploads. There is
+ * one IPI channel for both directions: each side kicks once per loop
+ * iteration which published or released slots, and checks both rings on
+ * each kick. Once it has sent and received everything, the RPU writes
+ * its interval, then the run number (from 1) to the duplex done word
+ * and kicks. The APU kicks back once it has read the interval.
+ * The interference is the slowdown of each direction compared with the
+ * unidirectional sweep of the same options.
+ *
+ * Last, the message queue measurement uploads a mix of package sizes
+ * through a message queue, see shm_msgq.h, with its control area at the
+ * APU to RPU descriptor area and its 4MB data area from the APU to RPU
+ * slot buffers. Messages of the package sizes alternate with
+ * MSGQ_CTRL_MSG_SIZE control messages, the message ID is the message
+ * index. MSGQ_BATCH messages are published per IPI kick, the RPU drains
+ * all the published messages on each kick and releases them at once.
+ * Once it has received all the messages, the RPU writes its interval and
+ * kicks, the APU kicks back once it has read it.
+ *
+ * Then the flow control measurement uploads through the tx ring with credit
+ * based flow control, see shm_credit.h, once per entry of flow_runs[] and
+ * package size. The credit unit is a slot. For each run, the APU writes the
+ * RPU delay, resets the credits and the tx ring and streams, publishing
+ * FLOW_BATCH slots per kick or less when it runs out of credits. Out of
+ * credits, it stalls until the RPU kicks. On the first kick the RPU
+ * attaches to the ring and the credits. It reads each slot, then spins for
+ * the delay of the run to act as a slow consumer. On each kick it drains
+ * the available slots, granting the credits back every window / 4 slots
+ * and once the ring is drained, with a kick after each grant. Once it has
+ * received everything, the RPU writes its interval, then the run number
+ * (from 1) to the flow control done word and kicks. The APU kicks back
+ * once it has read the interval. The APU reports the time it stalled and
+ * the ring occupancy, the slots in flight after each publication.
+ *
+ * The whole measurement is run once per shared memory mapping (non-cacheable
+ * and cacheable) and block copy (generic and NEON, see shm_copy.h), one
+ * round each. In the cacheable rounds the APU cleans payload, descriptors
+ * and indices before kicking and invalidates them before reading, see
+ * shm_cache_flush()/shm_cache_invalidate(). The block copy only changes
+ * the APU side copies, the zero-copy sweeps do not use it.
  */
 
 #include <unistd.h>
@@ -48,141 +138,1030 @@
 #include <metal/alloc.h>
 #include <metal/irq.h>
 #include "common.h"
+#include "shm_ring.h"
+#include "shm_msgq.h"
+#include "shm_pool.h"
+#include "shm_credit.h"
+#include "timestamp.h"
+#include "demo_params.h"
+#include "results.h"
+#include "notify.h"
+#include "zdma.h"
+#include "shm_layout.h"
+#include "bench.h"
+#include "ocm.h"
 
-#define TTC_CNT_APU_TO_RPU 2 /* APU to RPU TTC counter ID */
-#define TTC_CNT_RPU_TO_APU 3 /* RPU to APU TTC counter ID */
+/* Shared memory offsets are in shm_layout.h */
 
-#define TTC_CLK_FREQ_HZ	100000000
-#define NS_PER_SEC 1000000000
+/* Shared memory mappings measured, one round each */
+static const int shm_cache_modes[] = { 0, 1 };
+#define SHM_CACHE_MODES_NUM (sizeof(shm_cache_modes) / sizeof(shm_cache_modes[0]))
 
-/* Shared memory offsets */
-#define SHM_DESC_OFFSET_TX 0x0
-#define SHM_BUFF_OFFSET_TX 0x400000
-#define SHM_DESC_OFFSET_RX 0x200000
-#define SHM_BUFF_OFFSET_RX 0x800000
+/* Shared memory block copies measured, one round each per mapping */
+static const int shm_copy_modes[] = { 0, 1 };
+#define SHM_COPY_MODES_NUM (sizeof(shm_copy_modes) / sizeof(shm_copy_modes[0]))
 
-/* Shared memory descriptors offset */
-#define SHM_DESC_AVAIL_OFFSET 0x00
-#define SHM_DESC_ADDR_ARRAY_OFFSET 0x04
+/* Maximum number of slots of each ring, a slot holds one package */
+#define SHM_RING_NUM_SLOTS 1024
 
-#define ITERATIONS 1000
+/**
+ * options of one sweep over all the package sizes
+ */
+struct sweep_opts {
+	uint32_t batch; /* slots published per avail update and IPI kick */
+	int zero_copy; /* 1 - build/read packages in place in the slots */
+	int dma; /* 1 - fill the slots with the GDMA, upload only */
+	int pool; /* 1 - build the packages in tx pool buffers, upload only */
+};
 
-#define BUF_SIZE_MAX 4096
-#define PKG_SIZE_MAX 1024
-#define PKG_SIZE_MIN 16
-#define TOTAL_DATA_SIZE (1024 * 4096)
+static const struct sweep_opts tx_sweeps[] = {
+	{ .batch = 1, },
+	{ .batch = 4, },
+	{ .batch = 16, },
+	{ .batch = 64, },
+	{ .batch = 1, .zero_copy = 1, },
+	{ .batch = 64, .zero_copy = 1, },
+	{ .batch = 64, .zero_copy = 1, .pool = 1, },
+	{ .batch = 1, .dma = 1, },
+	{ .batch = 64, .dma = 1, },
+};
+#define TX_SWEEPS_NUM (sizeof(tx_sweeps) / sizeof(tx_sweeps[0]))
+
+static const struct sweep_opts rx_sweeps[] = {
+	{ .batch = 1, },
+	{ .batch = 1, .zero_copy = 1, },
+};
+#define RX_SWEEPS_NUM (sizeof(rx_sweeps) / sizeof(rx_sweeps[0]))
+
+static const struct sweep_opts duplex_sweeps[] = {
+	{ .batch = 1, },
+	{ .batch = 16, },
+};
+#define DUPLEX_SWEEPS_NUM (sizeof(duplex_sweeps) / sizeof(duplex_sweeps[0]))
+
+/* A batch is published earlier once it holds this amount of data */
+#define TX_BATCH_BYTES_MAX (16 * 1024)
+
+/* Message queue run: messages per IPI kick and size of the control
+ * messages between the packages */
+#define MSGQ_BATCH 16
+#define MSGQ_CTRL_MSG_SIZE 16
+
+/**
+ * options of one flow control run over all the package sizes
+ */
+struct flow_opts {
+	uint32_t window; /* credits, at most the ring slots */
+	uint32_t delay_ns; /* RPU delay per slot, to slow the consumer down */
+};
+
+static const struct flow_opts flow_runs[] = {
+	{ .window = 64, .delay_ns = 0, },
+	{ .window = 64, .delay_ns = 2000, },
+	{ .window = 16, .delay_ns = 2000, },
+};
+#define FLOW_RUNS_NUM (sizeof(flow_runs) / sizeof(flow_runs[0]))
+
+/* Flow control run: slots published per IPI kick at most */
+#define FLOW_BATCH 16
+
+/* How to wait for the RPU kick, see enum wait_policy */
+#ifndef SHMEM_THROUGHPUT_WAIT_POLICY
+#define SHMEM_THROUGHPUT_WAIT_POLICY WAIT_POLICY_WFI
+#endif
 
 #define MB (1024 * 1024) /* Mega Bytes */
 
+/* Distribution of the interval between publications (upload) and between
+ * notifications (download), in timestamp ticks, per sweep and package size */
+static struct metal_pctl tx_pctl[TX_SWEEPS_NUM * DEMO_SIZES_MAX];
+static struct metal_pctl rx_pctl[RX_SWEEPS_NUM * DEMO_SIZES_MAX];
+/* APU time waiting for the DMA, per upload sweep and package size */
+static uint64_t tx_idle[TX_SWEEPS_NUM * DEMO_SIZES_MAX];
+/* Buffers of the pool sweeps, handed back by RPU */
+static struct shm_pool tx_pool;
+/* Full duplex intervals, per duplex sweep and package size: APU send,
+ * APU receive, whole APU run and whole RPU run */
+static uint64_t duplex_tx[DUPLEX_SWEEPS_NUM * DEMO_SIZES_MAX];
+static uint64_t duplex_rx[DUPLEX_SWEEPS_NUM * DEMO_SIZES_MAX];
+static uint64_t duplex_apu[DUPLEX_SWEEPS_NUM * DEMO_SIZES_MAX];
+static uint64_t duplex_rpu[DUPLEX_SWEEPS_NUM * DEMO_SIZES_MAX];
+static struct metal_hist intv_hist;
+
 struct channel_s {
 	struct metal_io_region *ipi_io; /* IPI metal i/o region */
 	struct metal_io_region *shm_io; /* Shared memory metal i/o region */
 	struct metal_io_region *ttc_io; /* TTC metal i/o region */
+	struct metal_io_region *dma_io; /* GDMA channel metal i/o region */
+	struct ts_timer ts; /* timestamp source */
 	uint32_t ipi_mask; /* APU IPI mask */
+	enum wait_policy wait_policy; /* how to wait for the remote kick */
 	atomic_flag remote_nkicked; /* 0 - kicked from remote */
+	atomic_flag dma_nbusy; /* 0 - DMA transfer completed */
+	uint32_t dma_status; /* ZDMA_IRQ_* bits of the last transfer */
 };
 
 /**
- * @brief read_timer() - return TTC counter value
+ * @brief ipi_irq_handler() - IPI interrupt handler
+ *        It will clear the notified flag to mark it's got an IPI interrupt.
+ *        It will stop the RPU->APU timer and will clear the notified
+ *        flag to mark it's got an IPI interrupt
+ *
+ * @param[in] vect_id - IPI interrupt vector ID
+ * @param[in/out] priv - communication channel data for this application.
+ *
+ * @return - If the IPI interrupt is triggered by its remote, it returns
+ *           METAL_IRQ_HANDLED. It returns METAL_IRQ_NOT_HANDLED, if it is
+ *           not the interrupt it expected.
  *
- * @param[in] ttc_io - TTC timer i/o region
- * @param[in] cnt_id - counter ID
  */
-static inline uint32_t read_timer(struct metal_io_region *ttc_io,
-				unsigned long cnt_id)
+static OCM_TEXT int ipi_irq_handler (int vect_id, void *priv)
 {
-	unsigned long offset = XTTCPS_CNT_VAL_OFFSET +
-				XTTCPS_CNT_OFFSET(cnt_id);
+	struct channel_s *ch = (struct channel_s *)priv;
+	uint32_t val;
 
-	return metal_io_read32(ttc_io, offset);
+	(void)vect_id;
+	trace_event(TRACE_IRQ_ENTER, vect_id);
+	if (ch) {
+		val = metal_io_read32(ch->ipi_io, IPI_ISR_OFFSET);
+		if (val & ch->ipi_mask) {
+			metal_io_write32(ch->ipi_io, IPI_ISR_OFFSET,
+					ch->ipi_mask);
+			atomic_flag_clear(&ch->remote_nkicked);
+			trace_event(TRACE_FLAG_CLEAR, vect_id);
+			return METAL_IRQ_HANDLED;
+		}
+	}
+	return METAL_IRQ_NOT_HANDLED;
 }
 
 /**
- * @brief reset_timer() - function to reset TTC counter
- *        Set the RST bit in the Count Control Reg.
+ * @brief dma_irq_handler() - GDMA interrupt handler
+ *        It saves the status of the transfer and clears the busy flag.
+ *
+ * @param[in] vect_id - GDMA interrupt vector ID
+ * @param[in/out] priv - communication channel data for this application.
  *
- * @param[in] ttc_io - TTC timer i/o region
- * @param[in] cnt_id - counter id
+ * @return - METAL_IRQ_HANDLED if the transfer is done or failed,
+ *           METAL_IRQ_NOT_HANDLED otherwise.
  */
-static inline void reset_timer(struct metal_io_region *ttc_io,
-				unsigned long cnt_id)
+static OCM_TEXT int dma_irq_handler(int vect_id, void *priv)
 {
+	struct channel_s *ch = (struct channel_s *)priv;
 	uint32_t val;
-	unsigned long offset = XTTCPS_CNT_CNTRL_OFFSET +
-				XTTCPS_CNT_OFFSET(cnt_id);
 
-	val = XTTCPS_CNT_CNTRL_RST_MASK;
-	metal_io_write32(ttc_io, offset, val);
+	(void)vect_id;
+
+	if (ch) {
+		val = zdma_ack(ch->dma_io);
+		if (val & (ZDMA_IRQ_DONE | ZDMA_IRQ_ERR)) {
+			ch->dma_status = val;
+			atomic_flag_clear(&ch->dma_nbusy);
+			return METAL_IRQ_HANDLED;
+		}
+	}
+	return METAL_IRQ_NOT_HANDLED;
 }
 
 /**
- * @brief stop_timer() - function to stop TTC counter
- *        Set the disable bit in the Count Control Reg.
+ * @brief dma_submit_slot() - Start filling a slot from the DMA source.
+ *        The channel must be idle.
  *
- * @param[in] ttc_io - TTC timer i/o region
- * @param[in] cnt_id - counter id
+ * @param[in] ch - channel information
+ * @param[in] slot - slot buffer
+ * @param[in] len - number of bytes
+ * @return - 0 on success, error code if failure.
  */
-static inline void stop_timer(struct metal_io_region *ttc_io,
-				unsigned long cnt_id)
+static int dma_submit_slot(struct channel_s *ch, void *slot, size_t len)
 {
-	uint32_t val;
-	unsigned long offset = XTTCPS_CNT_CNTRL_OFFSET +
-				XTTCPS_CNT_OFFSET(cnt_id);
+	unsigned long offset = metal_io_virt_to_offset(ch->shm_io, slot);
 
-	val = XTTCPS_CNT_CNTRL_DIS_MASK;
-	metal_io_write32(ttc_io, offset, val);
+	/* No stale line may be written back over the DMA data */
+	shm_cache_invalidate(ch->shm_io, offset, len);
+	atomic_flag_test_and_set(&ch->dma_nbusy);
+	return zdma_submit(ch->dma_io, metal_io_phys(ch->shm_io, offset),
+			   metal_io_phys(ch->shm_io, SHM_DMA_SRC_OFFSET), len);
 }
 
 /**
- * @brief ipi_irq_handler() - IPI interrupt handler
- *        It will clear the notified flag to mark it's got an IPI interrupt.
- *        It will stop the RPU->APU timer and will clear the notified
- *        flag to mark it's got an IPI interrupt
+ * @brief dma_wait_slot() - Wait for the end of the transfer started by
+ *        dma_submit_slot().
  *
- * @param[in] vect_id - IPI interrupt vector ID
- * @param[in/out] priv - communication channel data for this application.
+ * @param[in] ch - channel information
+ * @param[in/out] idle - accumulated timestamp ticks waiting for the DMA
+ * @return - 0 on success, error code if failure.
+ */
+static int dma_wait_slot(struct channel_s *ch, uint64_t *idle)
+{
+	uint64_t start;
+
+	start = ts_sample(&ch->ts);
+	wait_for_notified(&ch->dma_nbusy, ch->wait_policy);
+	*idle += ts_sample(&ch->ts) - start;
+	if (ch->dma_status & ZDMA_IRQ_ERR) {
+		LPERROR("DMA transfer failed: 0x%x\n", ch->dma_status);
+		return -EIO;
+	}
+	return 0;
+}
+
+/**
+ * @brief send_packages_dma() - Send packages through the tx ring, the
+ *        slots being filled by the GDMA.
+ *        The upload is two deep: the DMA fills a slot while the APU posts
+ *        and publishes the slots already filled, so a slot is published
+ *        once its transfer is done and the next one is started. A batch
+ *        is published with one avail update and one IPI kick when it holds
+ *        batch filled slots, when the pending data reaches
+ *        TX_BATCH_BYTES_MAX, when the ring is full or on the last slot.
+ *        A running timestamp is sampled after each kick to record the
+ *        interval between publications.
  *
- * @return - If the IPI interrupt is triggered by its remote, it returns
- *           METAL_IRQ_HANDLED. It returns METAL_IRQ_NOT_HANDLED, if it is
- *           not the interrupt it expected.
+ * @param[in] ch - channel information
+ * @param[in] ring - tx ring
+ * @param[in] s - package size
+ * @param[in] iterations - number of packages to send
+ * @param[in] opts - sweep options
+ * @param[out] stat - statistics of the publication intervals
+ * @param[out] hist - histogram of the publication intervals
+ * @param[out] idle - timestamp ticks waiting for the DMA
+ * @return - 0 on success, error code if failure.
+ */
+static int send_packages_dma(struct channel_s *ch, struct shm_ring *ring,
+			     size_t s, uint32_t iterations,
+			     const struct sweep_opts *opts,
+			     struct metal_stat *stat, struct metal_hist *hist,
+			     uint64_t *idle)
+{
+	uint32_t tx_count = 0, pending = 0;
+	uint64_t now, last;
+	size_t pending_bytes = 0, pkg_left = s, len, dma_len = 0;
+	void *slot;
+	int ret;
+
+	*idle = 0;
+	/* The samples are a running count, the first interval is from here */
+	last = ts_sample(&ch->ts);
+
+	while (tx_count < iterations || dma_len) {
+		if (dma_len) {
+			/* The slot in flight is filled, post it */
+			ret = dma_wait_slot(ch, idle);
+			if (ret)
+				return ret;
+			shm_ring_commit(ring, dma_len);
+			pending++;
+			pending_bytes += dma_len;
+			dma_len = 0;
+		}
+		len = pkg_left < ring->slot_size ? pkg_left : ring->slot_size;
+		slot = tx_count < iterations ? shm_ring_reserve(ring, len) :
+					       NULL;
+		if (slot) {
+			/* Let the DMA fill the next slot while the filled
+			 * ones are published */
+			ret = dma_submit_slot(ch, slot, len);
+			if (ret)
+				return ret;
+			dma_len = len;
+			pkg_left -= len;
+			if (!pkg_left) {
+				tx_count++;
+				pkg_left = s;
+			}
+			if (pending < opts->batch &&
+			    pending_bytes < TX_BATCH_BYTES_MAX)
+				continue;
+		} else if (!pending) {
+			/* Ring is full, RPU can only free slots once it
+			 * knows about the pending ones */
+			continue;
+		}
+		/* Increase number of available buffers */
+		shm_ring_publish(ring);
+		/* Kick IPI to notify RPU data is ready in the shared memory */
+		trace_event(TRACE_KICK, ch->ipi_mask);
+		notify_kick(ch->ipi_io, ch->ipi_mask);
+		pending = 0;
+		pending_bytes = 0;
+		now = ts_sample(&ch->ts);
+		update_stat(stat, now - last);
+		update_hist(hist, now - last);
+		last = now;
+	}
+	return 0;
+}
+
+/**
+ * @brief send_packages() - Send packages through the tx ring in batches.
+ *        A package larger than a slot is sent in chunks of the slot size,
+ *        in consecutive slots. A batch is published with one avail update
+ *        and one IPI kick when it holds batch slots, when the pending data
+ *        reaches TX_BATCH_BYTES_MAX, or when the ring is full.
  *
+ *        With zero_copy, the package is built in place in the slot: the
+ *        slot is filled then its sequence number is written, the private
+ *        buffer is not copied.
+ *        With dma, the slots are filled by the GDMA, see
+ *        send_packages_dma().
+ *        A running timestamp is sampled after each kick to record
+ *        the interval between publications.
+ *
+ * @param[in] ch - channel information
+ * @param[in] ring - tx ring
+ * @param[in] lbuf - package data, at least the slot size
+ * @param[in] s - package size
+ * @param[in] iterations - number of packages to send
+ * @param[in] opts - sweep options
+ * @param[out] stat - statistics of the publication intervals
+ * @param[out] hist - histogram of the publication intervals
+ * @param[out] idle - timestamp ticks waiting for the DMA
+ * @return - 0 on success, error code if failure.
  */
-static int ipi_irq_handler (int vect_id, void *priv)
+static int send_packages(struct channel_s *ch, struct shm_ring *ring,
+			 void *lbuf, size_t s, uint32_t iterations,
+			 const struct sweep_opts *opts,
+			 struct metal_stat *stat, struct metal_hist *hist,
+			 uint64_t *idle)
 {
-	struct channel_s *ch = (struct channel_s *)priv;
-	uint32_t val;
+	uint32_t tx_count = 0, pending = 0;
+	uint64_t now, last;
+	size_t pending_bytes = 0, pkg_left = s, len;
+	unsigned long offset;
+	uint32_t *pkg;
 
-	(void)vect_id;
+	if (opts->dma)
+		return send_packages_dma(ch, ring, s, iterations, opts, stat,
+					 hist, idle);
 
-	if (ch) {
-		val = metal_io_read32(ch->ipi_io, IPI_ISR_OFFSET);
-		if (val & ch->ipi_mask) {
-			metal_io_write32(ch->ipi_io, IPI_ISR_OFFSET,
-					ch->ipi_mask);
-			atomic_flag_clear(&ch->remote_nkicked);
-			return METAL_IRQ_HANDLED;
+	*idle = 0;
+	/* The samples are a running count, the first interval is from here */
+	last = ts_sample(&ch->ts);
+
+	while (tx_count < iterations) {
+		if (!shm_ring_space(ring) ||
+		    (opts->pool && !shm_pool_available(&tx_pool))) {
+			/* Ring or pool is full, RPU can only free slots and
+			 * buffers once it knows about the pending ones */
+			if (!pending)
+				continue;
+		} else {
+			len = pkg_left < ring->slot_size ? pkg_left :
+							   ring->slot_size;
+			if (opts->pool) {
+				/* Build the package in a pool buffer */
+				offset = shm_pool_alloc(&tx_pool);
+				metal_io_block_set(ring->io, offset, 0xA, len);
+				pkg = metal_io_virt(ring->io, offset);
+				*pkg = tx_count;
+				shm_ring_post_buf(ring, offset, len);
+			} else if (opts->zero_copy) {
+				/* Build the package in the slot */
+				pkg = shm_ring_reserve(ring, len);
+				metal_io_block_set(ring->io,
+					metal_io_virt_to_offset(ring->io, pkg),
+					0xA, len);
+				*pkg = tx_count;
+				shm_ring_commit(ring, len);
+			} else {
+				/* Write data and descriptor to the shared
+				 * memory */
+				trace_event(TRACE_COPY_START, len);
+				shm_ring_write(ring, lbuf, len);
+				trace_event(TRACE_COPY_END, len);
+			}
+			pkg_left -= len;
+			if (!pkg_left) {
+				tx_count++;
+				pkg_left = s;
+			}
+			pending++;
+			pending_bytes += len;
+			if (pending < opts->batch &&
+			    pending_bytes < TX_BATCH_BYTES_MAX &&
+			    tx_count < iterations)
+				continue;
 		}
+		/* Increase number of available buffers */
+		shm_ring_publish(ring);
+		/* Kick IPI to notify RPU data is ready in the shared memory */
+		trace_event(TRACE_KICK, ch->ipi_mask);
+		notify_kick(ch->ipi_io, ch->ipi_mask);
+		pending = 0;
+		pending_bytes = 0;
+		now = ts_sample(&ch->ts);
+		update_stat(stat, now - last);
+		update_hist(hist, now - last);
+		last = now;
 	}
-	return METAL_IRQ_NOT_HANDLED;
+	return 0;
+}
+
+/**
+ * @brief receive_packages() - Receive packages from the rx ring.
+ *        Wait for IPI kicks and read as many slots as available on
+ *        each kick, until the data of all the packages has been read.
+ *        With zero_copy, the slot is read in place: the whole package
+ *        is read, it is not copied to the private buffer.
+ *        A running timestamp is sampled after each notification to record
+ *        the interval between notifications.
+ *
+ * @param[in] ch - channel information
+ * @param[in] ring - rx ring
+ * @param[in] lbuf - buffer for the package data, at least the slot size
+ * @param[in] s - package size
+ * @param[in] iterations - number of packages to receive
+ * @param[in] opts - sweep options
+ * @param[out] stat - statistics of the notification intervals
+ * @param[out] hist - histogram of the notification intervals
+ * @return - 0 on success, error code if failure.
+ */
+static int receive_packages(struct channel_s *ch, struct shm_ring *ring,
+			    void *lbuf, size_t s, uint32_t iterations,
+			    const struct sweep_opts *opts,
+			    struct metal_stat *stat, struct metal_hist *hist)
+{
+	uint64_t rx_bytes = 0, total = (uint64_t)iterations * s;
+	uint64_t now, last;
+	uint32_t rx_avail;
+	void *pkg;
+	size_t len;
+	int ret;
+
+	/* The samples are a running count, the first interval is from here */
+	last = ts_sample(&ch->ts);
+	while (1) {
+		rx_avail = shm_ring_available(ring);
+		for (; rx_avail; rx_avail--) {
+			if (opts->zero_copy) {
+				/* Read the package in the slot and release
+				 * the slot to RPU */
+				pkg = shm_ring_peek(ring, &len);
+				ret = -EINVAL;
+				if (pkg) {
+					(void)shm_block_sum(pkg, len);
+					shm_ring_release(ring);
+					ret = (int)len;
+				}
+			} else {
+				/* Read data from shared memory and release
+				 * the slot to RPU */
+				trace_event(TRACE_COPY_START, ring->slot_size);
+				ret = shm_ring_read(ring, lbuf,
+						    ring->slot_size);
+				trace_event(TRACE_COPY_END, ret);
+			}
+			if (ret < 0) {
+				LPERROR("[%lu]failed to read rx ring.\n",
+					rx_bytes);
+				return ret;
+			}
+			rx_bytes += ret;
+		}
+		if (rx_bytes >= total)
+			break;
+		/* Need to wait for more data */
+		notify_wait(&ch->remote_nkicked, ch->wait_policy);
+		now = ts_sample(&ch->ts);
+		update_stat(stat, now - last);
+		update_hist(hist, now - last);
+		last = now;
+	}
+	return 0;
+}
+
+/**
+ * @brief duplex_packages() - Send and receive packages at the same time.
+ *        Each loop iteration publishes up to a batch of slots on the tx
+ *        ring, drains the rx ring, and kicks the RPU once if it did
+ *        either. It only waits for a kick when it could do neither.
+ *
+ * @param[in] ch - channel information
+ * @param[in] tx_ring - tx ring
+ * @param[in] rx_ring - rx ring, attached
+ * @param[in] lbuf - package data and receive buffer, at least the slot size
+ * @param[in] s - package size
+ * @param[in] iterations - number of packages to send and to receive
+ * @param[in] opts - sweep options
+ * @param[out] tx_ticks - timestamp ticks until the last publication
+ * @param[out] rx_ticks - timestamp ticks until the last package read
+ * @return - 0 on success, error code if failure.
+ */
+static int duplex_packages(struct channel_s *ch, struct shm_ring *tx_ring,
+			   struct shm_ring *rx_ring, void *lbuf, size_t s,
+			   uint32_t iterations, const struct sweep_opts *opts,
+			   uint64_t *tx_ticks, uint64_t *rx_ticks)
+{
+	uint64_t rx_bytes = 0, total = (uint64_t)iterations * s;
+	uint64_t start = ts_sample(&ch->ts);
+	uint32_t tx_count = 0, pending, rx_avail, released;
+	size_t pkg_left = s, len;
+	int ret;
+
+	*tx_ticks = 0;
+	*rx_ticks = 0;
+	while (tx_count < iterations || rx_bytes < total) {
+		/* Stream up to a batch of slots */
+		for (pending = 0; tx_count < iterations &&
+		     pending < opts->batch && shm_ring_space(tx_ring);
+		     pending++) {
+			len = pkg_left < tx_ring->slot_size ? pkg_left :
+							      tx_ring->slot_size;
+			shm_ring_write(tx_ring, lbuf, len);
+			pkg_left -= len;
+			if (!pkg_left) {
+				tx_count++;
+				pkg_left = s;
+			}
+		}
+		if (pending) {
+			shm_ring_publish(tx_ring);
+			if (tx_count == iterations)
+				*tx_ticks = ts_sample(&ch->ts) - start;
+		}
+
+		/* Drain the rx ring */
+		released = 0;
+		if (rx_bytes < total) {
+			rx_avail = shm_ring_available(rx_ring);
+			for (; rx_avail; rx_avail--, released++) {
+				ret = shm_ring_read(rx_ring, lbuf,
+						    rx_ring->slot_size);
+				if (ret < 0) {
+					LPERROR("[%lu]failed to read rx ring.\n",
+						rx_bytes);
+					return ret;
+				}
+				rx_bytes += ret;
+			}
+			if (released && rx_bytes >= total)
+				*rx_ticks = ts_sample(&ch->ts) - start;
+		}
+
+		if (pending || released) {
+			/* One kick for both directions */
+			trace_event(TRACE_KICK, ch->ipi_mask);
+			notify_kick(ch->ipi_io, ch->ipi_mask);
+		} else {
+			notify_wait(&ch->remote_nkicked, ch->wait_policy);
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief find_sweep() - find the unidirectional sweep to compare a full
+ *        duplex sweep with
+ *
+ * @param[in] sweeps - unidirectional sweeps
+ * @param[in] num - number of unidirectional sweeps
+ * @param[in] opts - full duplex sweep options
+ * @param[in] match_batch - 1 if the batch has to match
+ * @return - index of the sweep, -1 if there is none.
+ */
+static int find_sweep(const struct sweep_opts *sweeps, size_t num,
+		      const struct sweep_opts *opts, int match_batch)
+{
+	size_t b;
+
+	for (b = 0; b < num; b++) {
+		if (sweeps[b].zero_copy != opts->zero_copy ||
+		    sweeps[b].dma != opts->dma || sweeps[b].pool != opts->pool)
+			continue;
+		if (!match_batch || sweeps[b].batch == opts->batch)
+			return (int)b;
+	}
+	return -1;
+}
+
+/**
+ * @brief print_slowdown() - print the slowdown of a full duplex direction
+ *
+ * @param[in] name - direction name
+ * @param[in] duplex - full duplex interval
+ * @param[in] simplex - unidirectional interval, 0 if there is none
+ */
+static void print_slowdown(const char *name, uint64_t duplex,
+			   uint64_t simplex)
+{
+	if (simplex)
+		RPRINTF("      %s interference: %ld%%\n", name,
+			(long)(duplex * 100 / simplex) - 100);
+	else
+		RPRINTF("      %s interference: n/a\n", name);
+}
+
+/**
+ * @brief print_sweep_opts() - print sweep options
+ *
+ * @param[in] name - sweep direction name
+ * @param[in] opts - sweep options
+ */
+static void print_sweep_opts(const char *name, const struct sweep_opts *opts)
+{
+	RPRINTF("    %s batch %u%s:\n", name, opts->batch,
+		opts->dma ? ", DMA" : opts->pool ? ", zero-copy, pool" :
+		opts->zero_copy ? ", zero-copy" : "");
+}
+
+/**
+ * @brief export_result() - append the result of one sweep and package size
+ *        to the results area, with the interval histogram intv_hist
+ *
+ * @param[in] dir - TS_APU_TO_RPU for upload, TS_RPU_TO_APU for download
+ * @param[in] s - package size
+ * @param[in] opts - sweep options
+ * @param[in] apu_ticks - APU side interval
+ * @param[in] rpu_ticks - RPU side interval
+ * @param[in] idle_ticks - APU time waiting for the DMA
+ * @param[in] intv - statistics of the kick or notification intervals
+ * @param[in] pctl - percentiles of the kick or notification intervals
+ */
+static void export_result(enum ts_dir dir, size_t s,
+			  const struct sweep_opts *opts,
+			  uint64_t apu_ticks, uint64_t rpu_ticks,
+			  uint64_t idle_ticks, struct metal_stat *intv,
+			  struct metal_pctl *pctl)
+{
+	struct demo_result res;
+
+	memset(&res, 0, sizeof(res));
+	res.test = DEMO_TEST_SHMEM_THROUGHPUT;
+	res.dir = dir;
+	res.pkg_size = s;
+	res.flags = opts->zero_copy ? RESULT_ZERO_COPY : 0;
+	if (opts->dma)
+		res.flags |= RESULT_DMA;
+	if (opts->pool)
+		res.flags |= RESULT_POOL;
+	res.batch = opts->batch;
+	res.apu_ticks = apu_ticks;
+	res.rpu_ticks = rpu_ticks;
+	res.idle_ticks = idle_ticks;
+	res.stat = *intv;
+	res.pctl = *pctl;
+	results_add(&res, &intv_hist);
+}
+
+/**
+ * @brief export_duplex() - append the results of one full duplex sweep and
+ *        package size to the results area, one record per direction
+ *
+ * @param[in] s - package size
+ * @param[in] opts - sweep options
+ * @param[in] tx_ticks - APU send interval
+ * @param[in] rx_ticks - APU receive interval
+ * @param[in] rpu_ticks - RPU interval of the whole run
+ */
+static void export_duplex(size_t s, const struct sweep_opts *opts,
+			  uint64_t tx_ticks, uint64_t rx_ticks,
+			  uint64_t rpu_ticks)
+{
+	struct demo_result res;
+
+	memset(&res, 0, sizeof(res));
+	res.test = DEMO_TEST_SHMEM_DUPLEX;
+	res.dir = TS_APU_TO_RPU;
+	res.pkg_size = s;
+	res.batch = opts->batch;
+	res.apu_ticks = tx_ticks;
+	res.rpu_ticks = rpu_ticks;
+	results_add(&res, NULL);
+	res.dir = TS_RPU_TO_APU;
+	res.apu_ticks = rx_ticks;
+	results_add(&res, NULL);
+}
+
+/**
+ * @brief msgq_msg_size() - return the payload length of a message of the
+ *        message queue run, a package size for the even messages and a
+ *        control message for the odd ones
+ *
+ * @param[in] n - message index
+ * @param[in] max_len - largest payload
+ */
+static size_t msgq_msg_size(uint32_t n, size_t max_len)
+{
+	size_t len;
+
+	if (n & 1)
+		return MSGQ_CTRL_MSG_SIZE;
+	len = demo_params.sizes[(n / 2) % demo_params.num_sizes];
+	return len < max_len ? len : max_len;
+}
+
+/**
+ * @brief msgq_msg_count() - return the number of messages of the message
+ *        queue run, enough to move the total data size
+ *
+ * @param[in] max_len - largest payload
+ */
+static uint32_t msgq_msg_count(size_t max_len)
+{
+	uint64_t total = 0;
+	uint32_t n;
+
+	for (n = 0; total < demo_params.total_data_size; n++)
+		total += msgq_msg_size(n, max_len);
+	return n;
+}
+
+/**
+ * @brief send_messages() - Send the messages of the message queue run.
+ *        A batch is published with one producer index update and one IPI
+ *        kick when it holds MSGQ_BATCH messages or when the queue is full.
+ *
+ * @param[in] ch - channel information
+ * @param[in] q - message queue
+ * @param[in] lbuf - message data, at least max_len
+ * @param[in] count - number of messages
+ * @param[in] max_len - largest payload
+ * @param[out] bytes - payload bytes sent
+ * @param[out] rec_bytes - queue bytes used by the records
+ * @return - 0 on success, error code if failure.
+ */
+static int send_messages(struct channel_s *ch, struct shm_msgq *q,
+			 void *lbuf, uint32_t count, size_t max_len,
+			 uint64_t *bytes, uint64_t *rec_bytes)
+{
+	uint32_t n = 0, pending = 0;
+	size_t len;
+	int ret;
+
+	*bytes = 0;
+	*rec_bytes = 0;
+	while (n < count) {
+		len = msgq_msg_size(n, max_len);
+		trace_event(TRACE_COPY_START, len);
+		ret = shm_msgq_send(q, n, lbuf, len);
+		trace_event(TRACE_COPY_END, len);
+		if (ret >= 0) {
+			n++;
+			pending++;
+			*bytes += len;
+			*rec_bytes += shm_msgq_record_size(len);
+			if (pending < MSGQ_BATCH && n < count)
+				continue;
+		} else if (ret != -EAGAIN) {
+			return ret;
+		} else if (!pending) {
+			/* Queue is full, RPU releases the published
+			 * messages */
+			continue;
+		}
+		shm_msgq_publish(q);
+		trace_event(TRACE_KICK, ch->ipi_mask);
+		notify_kick(ch->ipi_io, ch->ipi_mask);
+		pending = 0;
+	}
+	return 0;
+}
+
+/**
+ * @brief measure_msgq() - Measure the upload of mixed size messages
+ *        through the message queue and report it.
+ *
+ * @param[in] ch - channel information
+ * @param[in] q - message queue
+ * @param[in] lbuf - message data, at least max_len
+ * @param[in] count - number of messages
+ * @param[in] max_len - largest payload
+ * @return - 0 on success, error code if failure.
+ */
+static int measure_msgq(struct channel_s *ch, struct shm_msgq *q,
+			void *lbuf, uint32_t count, size_t max_len)
+{
+	struct demo_result res;
+	uint64_t bytes, rec_bytes, apu, rpu;
+	float mbs;
+	int ret;
+
+	/* Start from an empty queue */
+	shm_msgq_reset(q);
+	ts_start(&ch->ts, TS_APU_TO_RPU);
+	ret = send_messages(ch, q, lbuf, count, max_len, &bytes, &rec_bytes);
+	if (ret) {
+		LPERROR("Failed to send messages.\n");
+		return ret;
+	}
+	ts_stop(&ch->ts, TS_APU_TO_RPU);
+	/* Wait for RPU to signal RPU receive interval is ready to read */
+	notify_wait(&ch->remote_nkicked, ch->wait_policy);
+	apu = ts_read(&ch->ts, TS_APU_TO_RPU);
+	rpu = ts_read(&ch->ts, TS_RPU_TO_APU);
+	/* Kick IPI to notify RPU APU has read the RPU receive interval */
+	notify_kick(ch->ipi_io, ch->ipi_mask);
+
+	mbs = ts_freq() * ((float)bytes / MB);
+	RPRINTF("Message queue upload, %u mixed size messages, batch %u:\n",
+		count, MSGQ_BATCH);
+	RPRINTF("      APU send:    %lu, %d MB/s\n", apu, (int)(mbs / apu)*100);
+	RPRINTF("      RPU receive: %lu, %d MB/s\n", rpu, (int)(mbs / rpu)*100);
+	RPRINTF("      queue bytes: %lu for %lu payload bytes, %lu in fixed "
+		"slots\n", rec_bytes, bytes, (uint64_t)count * max_len);
+
+	memset(&res, 0, sizeof(res));
+	res.test = DEMO_TEST_SHMEM_MSGQ;
+	res.dir = TS_APU_TO_RPU;
+	res.pkg_size = bytes / count;
+	res.batch = MSGQ_BATCH;
+	res.apu_ticks = apu;
+	res.rpu_ticks = rpu;
+	results_add(&res, NULL);
+	return 0;
+}
+
+/**
+ * @brief flow_packages() - Send packages through the tx ring with credit
+ *        flow control. A batch is published with one avail update and one
+ *        IPI kick when it holds FLOW_BATCH slots or when the credits run
+ *        out. Without credits and nothing to publish, the APU waits for
+ *        the RPU kick granting more. The occupancy of the ring is sampled
+ *        after each publication.
+ *
+ * @param[in] ch - channel information
+ * @param[in] ring - tx ring
+ * @param[in] credit - credit flow control of the tx ring
+ * @param[in] lbuf - package data, at least the slot size
+ * @param[in] s - package size
+ * @param[in] iterations - number of packages to send
+ * @param[out] occ - statistics of the occupancy, in slots
+ * @param[out] hist - histogram of the occupancy, in slots
+ * @param[out] stall - timestamp ticks waiting for credits
+ * @return - 0 on success, error code if failure.
+ */
+static int flow_packages(struct channel_s *ch, struct shm_ring *ring,
+			 struct shm_credit *credit, void *lbuf, size_t s,
+			 uint32_t iterations, struct metal_stat *occ,
+			 struct metal_hist *hist, uint64_t *stall)
+{
+	uint32_t tx_count = 0, pending = 0, inflight;
+	size_t pkg_left = s, len;
+	uint64_t start;
+
+	*stall = 0;
+	while (tx_count < iterations) {
+		if (shm_credit_avail(credit) && shm_ring_space(ring)) {
+			len = pkg_left < ring->slot_size ? pkg_left :
+							   ring->slot_size;
+			trace_event(TRACE_COPY_START, len);
+			shm_ring_write(ring, lbuf, len);
+			trace_event(TRACE_COPY_END, len);
+			shm_credit_take(credit, 1);
+			pkg_left -= len;
+			if (!pkg_left) {
+				tx_count++;
+				pkg_left = s;
+			}
+			if (++pending < FLOW_BATCH && tx_count < iterations)
+				continue;
+		} else if (!pending) {
+			/* Out of credits, wait for RPU to grant more */
+			start = ts_sample(&ch->ts);
+			notify_wait(&ch->remote_nkicked, ch->wait_policy);
+			*stall += ts_sample(&ch->ts) - start;
+			continue;
+		}
+		shm_ring_publish(ring);
+		trace_event(TRACE_KICK, ch->ipi_mask);
+		notify_kick(ch->ipi_io, ch->ipi_mask);
+		pending = 0;
+		inflight = shm_credit_inflight(credit);
+		update_stat(occ, inflight);
+		update_hist(hist, inflight);
+	}
+	return 0;
+}
+
+/**
+ * @brief measure_flow_control() - Measure the upload with credit flow
+ *        control for each flow control run and package size, and report
+ *        it.
+ *
+ * @param[in] ch - channel information
+ * @param[in] ring - tx ring
+ * @param[in] lbuf - package data, at least the slot size
+ * @return - 0 on success, error code if failure.
+ */
+static int measure_flow_control(struct channel_s *ch, struct shm_ring *ring,
+				void *lbuf)
+{
+	struct shm_credit credit;
+	struct demo_result res;
+	struct metal_stat occ;
+	uint64_t apu, rpu, stall;
+	uint32_t iterations, window, run = 0;
+	size_t r, i, s;
+	float mbs;
+	int ret;
+
+	ret = shm_credit_init(&credit, ch->shm_io, SHM_CREDIT_OFFSET);
+	if (ret) {
+		LPERROR("Failed to initialize the credits.\n");
+		return ret;
+	}
+	for (r = 0; r < FLOW_RUNS_NUM; r++) {
+		window = flow_runs[r].window < ring->num_slots ?
+			 flow_runs[r].window : ring->num_slots;
+		for (i = 0; i < demo_params.num_sizes; i++) {
+			s = demo_params.sizes[i];
+			iterations = demo_params.total_data_size / s;
+			run++;
+			metal_io_write32(ch->shm_io, SHM_FLOW_DELAY_OFFSET,
+					 flow_runs[r].delay_ns);
+			shm_cache_flush(ch->shm_io, SHM_FLOW_DELAY_OFFSET,
+					sizeof(uint32_t));
+			/* Start from an empty tx ring and all the credits */
+			shm_credit_reset(&credit, window);
+			shm_ring_reset(ring);
+			occ = (struct metal_stat)STAT_INIT;
+			reset_hist(&intv_hist);
+			ts_start(&ch->ts, TS_APU_TO_RPU);
+			ret = flow_packages(ch, ring, &credit, lbuf, s,
+					    iterations, &occ, &intv_hist,
+					    &stall);
+			if (ret) {
+				LPERROR("Failed to send packages.\n");
+				return ret;
+			}
+			ts_stop(&ch->ts, TS_APU_TO_RPU);
+			/* Kicks granting credits may still be pending, wait
+			 * for the done word of this run */
+			while (1) {
+				shm_cache_invalidate(ch->shm_io,
+						     SHM_FLOW_DONE_OFFSET,
+						     sizeof(uint32_t));
+				if (metal_io_read32(ch->shm_io,
+						    SHM_FLOW_DONE_OFFSET) ==
+				    run)
+					break;
+				notify_wait(&ch->remote_nkicked,
+					    ch->wait_policy);
+			}
+			apu = ts_read(&ch->ts, TS_APU_TO_RPU);
+			rpu = ts_read(&ch->ts, TS_RPU_TO_APU);
+			/* Clear remote kicked flag -- 0 is kicked */
+			notify_reset(&ch->remote_nkicked);
+			/* Kick IPI to notify RPU APU has read the RPU
+			 * interval */
+			notify_kick(ch->ipi_io, ch->ipi_mask);
+
+			memset(&res, 0, sizeof(res));
+			res.test = DEMO_TEST_SHMEM_FLOW;
+			res.dir = TS_APU_TO_RPU;
+			res.pkg_size = s;
+			res.batch = FLOW_BATCH;
+			res.window = window;
+			res.delay_ns = flow_runs[r].delay_ns;
+			res.apu_ticks = apu;
+			res.rpu_ticks = rpu;
+			res.idle_ticks = stall;
+			res.stat = occ;
+			hist_percentiles(&intv_hist, occ.st_max, &res.pctl);
+			results_add(&res, &intv_hist);
+
+			mbs = ts_freq() * ((float)iterations * s / MB);
+			RPRINTF("Flow control upload of pkg size %lu, window "
+				"%u, RPU delay %u ns:\n", s, window,
+				flow_runs[r].delay_ns);
+			RPRINTF("      APU send:    %lu, %d MB/s\n", apu, (int)(mbs / apu)*100);
+			RPRINTF("      RPU receive: %lu, %d MB/s\n", rpu, (int)(mbs / rpu)*100);
+			RPRINTF("      APU stalled: %lu, %lu%%\n", stall,
+				apu ? stall * 100 / apu : 0);
+			RPRINTF("      occupancy: avg %lu p50: %lu p99: %lu "
+				"max: %lu slots\n",
+				occ.st_cnt ? occ.st_sum / occ.st_cnt : 0,
+				res.pctl.p50, res.pctl.p99, res.pctl.max);
+		}
+	}
+	return 0;
 }
 
 /**
  * @brief measure_shmem_throughput() - Show throughput of using shared memory.
  *        - Upload throughput measurement:
- *          Start TTC APU counter, write data to shared memory and kick IPI to
- *          notify remote. It will iterate for 1000 times, stop TTC APU
- *          counter. Wait for RPU IPI kick to know RPU has finished receiving
+ *          Start APU interval, write data to shared memory and kick IPI to
+ *          notify remote. It will iterate for 1000 times, stop APU
+ *          interval. Wait for RPU IPI kick to know RPU has finished receiving
  *          packages and RPU TX counter is ready to read. Read the APU TX and
  *          RPU RX counter values and save them. Repeat for different package
  *          sizes. After this measurement, kick IPI to notify the remote, the
  *          measurement has finished.
  *        - Download throughput measurement:
- *          Start TTC APU counter, wait for IPI kick, check if data is
+ *          Start APU interval, wait for IPI kick, check if data is
  *          available, if yes, read as much data as possible from shared
  *          memory. It will iterates untill 1000 packages have been received,
- *          stop TTC APU counter. Wait for RPU IPI kick so that APU can get
- *          the TTC RPU TX counter value. Kick IPI to notify the remote it
- *          has read the TTCi counter. Repeat for different package size.
+ *          stop APU interval. Wait for RPU IPI kick so that APU can get
+ *          the RPU TX interval. Kick IPI to notify the remote it
+ *          has read the interval. Repeat for different package size.
+ *        - Full duplex throughput measurement:
+ *          Reset the tx ring, wait for RPU IPI kick, attach to the rx
+ *          ring, then send and receive at the same time until all the
+ *          packages are through in both directions. Wait for the RPU
+ *          done word, read the RPU interval and kick IPI to notify the
+ *          remote. Repeat for different package size.
+ *        - Message queue measurement, see measure_msgq().
+ *        - Flow control measurement, see measure_flow_control().
  *
  * @param[in] ch - channel information, which contains the IPI i/o region,
  *                 shared memory i/o region and the ttc timer i/o region.
@@ -192,168 +1171,366 @@ static int measure_shmem_throughput(struct channel_s* ch)
 {
 	void *lbuf = NULL;
 	int ret = 0;
-	size_t s, i;
-	uint32_t rx_count, rx_avail, tx_count, iterations;
-	unsigned long tx_avail_offset, rx_avail_offset;
-	unsigned long tx_addr_offset, rx_addr_offset;
-	unsigned long tx_data_offset, rx_data_offset;
-	uint32_t buf_phy_addr_32;
-	uint32_t *apu_tx_count = NULL;
-	uint32_t *apu_rx_count = NULL;
-	uint32_t *rpu_tx_count = NULL;
-	uint32_t *rpu_rx_count = NULL;
+	size_t s, i, b, num_sizes, crossover, run;
+	int tb, rb;
+	uint32_t iterations, num_slots, slot_size;
+	struct metal_stat intv;
+	struct shm_ring tx_ring, rx_ring;
+	struct shm_msgq msgq;
+	uint32_t msgq_count;
+	size_t msgq_len;
+	uint64_t *apu_tx_count = NULL;
+	uint64_t *apu_rx_count = NULL;
+	uint64_t *rpu_tx_count = NULL;
+	uint64_t *rpu_rx_count = NULL;
 
 	/* allocate memory for receiving data */
-	lbuf = metal_allocate_memory(BUF_SIZE_MAX);
+	lbuf = ocm_alloc(demo_params.buf_size_max);
 	if (!lbuf) {
 		LPERROR("Failed to allocate memory.\r\n");
 		return -ENOMEM;
 	}
-	memset(lbuf, 0xA, BUF_SIZE_MAX);
+	memset(lbuf, 0xA, demo_params.buf_size_max);
 
 	/* allocate memory for saving counter values */
-	for (s = PKG_SIZE_MIN, i = 0; s <= PKG_SIZE_MAX; s <<=1, i++);
-	apu_tx_count = metal_allocate_memory(i * sizeof(uint32_t));
-	apu_rx_count = metal_allocate_memory(i * sizeof(uint32_t));
-	rpu_tx_count = metal_allocate_memory(i * sizeof(uint32_t));
-	rpu_rx_count = metal_allocate_memory(i * sizeof(uint32_t));
+	num_sizes = demo_params.num_sizes;
+	apu_tx_count = metal_allocate_memory(TX_SWEEPS_NUM * num_sizes *
+					     sizeof(uint64_t));
+	apu_rx_count = metal_allocate_memory(RX_SWEEPS_NUM * num_sizes *
+					     sizeof(uint64_t));
+	rpu_tx_count = metal_allocate_memory(RX_SWEEPS_NUM * num_sizes *
+					     sizeof(uint64_t));
+	rpu_rx_count = metal_allocate_memory(TX_SWEEPS_NUM * num_sizes *
+					     sizeof(uint64_t));
 	if (!apu_tx_count || !apu_rx_count || !rpu_tx_count || !rpu_rx_count) {
 		LPERROR("Failed to allocate memory.\r\n");
 		ret = -ENOMEM;
 		goto out;
 	}
 
-	/* Clear shared memory */
-	metal_io_block_set(ch->shm_io, 0, 0, metal_io_region_size(ch->shm_io));
-
-	LPRINTF("Starting shared mem throughput demo\n");
-
-	/* for each data size, measure send throughput */
-	for (s = PKG_SIZE_MIN, i = 0; s <= PKG_SIZE_MAX; s <<= 1, i++) {
-		tx_count = 0;
-		iterations = TOTAL_DATA_SIZE / s;
-		/* Set tx buffer address offset */
-		tx_avail_offset = SHM_DESC_OFFSET_TX + SHM_DESC_AVAIL_OFFSET;
-		tx_addr_offset = SHM_DESC_OFFSET_TX +
-				SHM_DESC_ADDR_ARRAY_OFFSET;
-		tx_data_offset = SHM_DESC_OFFSET_TX + SHM_BUFF_OFFSET_TX;
-		/* Reset APU TTC counter */
-		reset_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU);
-		while (tx_count < iterations) {
-			/* Write data to the shared memory*/
-			metal_io_block_write(ch->shm_io, tx_data_offset,
-					lbuf, s);
-
-			/* Write to the address array to tell the other end
-			 * the buffer address.
-			 */
-			buf_phy_addr_32 = (uint32_t)metal_io_phys(ch->shm_io,
-						tx_data_offset);
-			metal_io_write32(ch->shm_io, tx_addr_offset,
-					buf_phy_addr_32);
-			tx_data_offset += s;
-			tx_addr_offset += sizeof(buf_phy_addr_32);
-
-			/* Increase number of available buffers */
-			tx_count++;
-			metal_io_write32(ch->shm_io, tx_avail_offset,
-					tx_count);
-			/* Kick IPI to notify RPU data is ready in
-			 * the shared memory */
-			metal_io_write32(ch->ipi_io, IPI_TRIG_OFFSET, ch->ipi_mask);
+	/* Clear shared memory, up to the results area */
+	metal_io_block_set(ch->shm_io, 0, 0, SHM_RESULTS_OFFSET);
+	shm_cache_flush(ch->shm_io, 0, SHM_RESULTS_OFFSET);
+
+	/* A slot holds the largest package, or a chunk of the private
+	 * buffer size for larger packages. Both rings have as many slots as
+	 * fit in the smaller slot buffer area. */
+	slot_size = demo_params.pkg_size_max < demo_params.buf_size_max ?
+		    demo_params.pkg_size_max : demo_params.buf_size_max;
+	for (num_slots = SHM_RING_NUM_SLOTS;
+	     num_slots * slot_size > SHM_BUFF_SIZE_RX; num_slots >>= 1);
+	ret = shm_ring_init(&tx_ring, ch->shm_io, SHM_DESC_OFFSET_TX,
+			    SHM_BUFF_OFFSET_TX, num_slots, slot_size);
+	if (!ret)
+		ret = shm_ring_init(&rx_ring, ch->shm_io, SHM_DESC_OFFSET_RX,
+				    SHM_BUFF_OFFSET_RX, num_slots, slot_size);
+	if (ret) {
+		LPERROR("Failed to initialize shared memory rings.\r\n");
+		goto out;
+	}
+
+	/* The message queue takes messages up to the slot size */
+	ret = shm_msgq_init(&msgq, ch->shm_io, SHM_MSGQ_CTRL_OFFSET,
+			    SHM_MSGQ_BUF_OFFSET, SHM_MSGQ_BUF_SIZE);
+	if (ret) {
+		LPERROR("Failed to initialize the message queue.\r\n");
+		goto out;
+	}
+	msgq_len = slot_size < shm_msgq_max_len(&msgq) ? slot_size :
+		   shm_msgq_max_len(&msgq);
+	msgq_count = msgq_msg_count(msgq_len);
+
+	/* A pool buffer holds a slot */
+	ret = shm_pool_init(&tx_pool, ch->shm_io, SHM_POOL_OFFSET_TX,
+			    SHM_POOL_SIZE_TX, slot_size);
+	if (ret) {
+		LPERROR("Failed to initialize the tx buffer pool.\r\n");
+		goto out;
+	}
+
+	/* Staging copy of the private buffer for the DMA sweeps */
+	if (slot_size > SHM_DMA_SRC_SIZE) {
+		LPERROR("Slots are larger than the DMA source.\r\n");
+		ret = -EINVAL;
+		goto out;
+	}
+	metal_io_block_write(ch->shm_io, SHM_DMA_SRC_OFFSET, lbuf, slot_size);
+	shm_cache_flush(ch->shm_io, SHM_DMA_SRC_OFFSET, slot_size);
+
+	/* Tell RPU how many sweeps to expect */
+	metal_io_write32(ch->shm_io, SHM_TX_SWEEPS_OFFSET, TX_SWEEPS_NUM);
+	metal_io_write32(ch->shm_io, SHM_ROUNDS_OFFSET,
+			 SHM_CACHE_MODES_NUM * SHM_COPY_MODES_NUM);
+	metal_io_write32(ch->shm_io, SHM_RX_SWEEPS_OFFSET, RX_SWEEPS_NUM);
+	metal_io_write32(ch->shm_io, SHM_DUPLEX_SWEEPS_OFFSET,
+			 DUPLEX_SWEEPS_NUM);
+	metal_io_write32(ch->shm_io, SHM_MSGQ_COUNT_OFFSET, msgq_count);
+	metal_io_write32(ch->shm_io, SHM_FLOW_RUNS_OFFSET, FLOW_RUNS_NUM);
+	shm_cache_flush(ch->shm_io, SHM_TX_SWEEPS_OFFSET, SHM_TPUT_COUNTS_SIZE);
+
+	LPRINTF("tx pool: %u buffers of %u bytes\n", tx_pool.num_bufs,
+		tx_pool.buf_size);
+	LPRINTF("Starting shared mem throughput demo, wait policy: %s, "
+		"shm %s, %s copy\n", notify_wait_name(ch->wait_policy),
+		shm_cacheable ? "cacheable" : "non-cacheable",
+		shm_neon_copy ? "NEON" : "generic");
+
+	/* for each sweep and data size, measure send throughput */
+	for (b = 0; b < TX_SWEEPS_NUM; b++) {
+		for (i = 0; i < num_sizes; i++) {
+			s = demo_params.sizes[i];
+			iterations = demo_params.total_data_size / s;
+			/* Start from an empty tx ring, and all the pool
+			 * buffers free */
+			shm_ring_reset(&tx_ring);
+			if (tx_sweeps[b].pool)
+				shm_pool_reset(&tx_pool);
+			intv = (struct metal_stat)STAT_INIT;
+			reset_hist(&intv_hist);
+			/* Start APU send interval */
+			ts_start(&ch->ts, TS_APU_TO_RPU);
+			ret = send_packages(ch, &tx_ring, lbuf, s, iterations,
+					    &tx_sweeps[b], &intv, &intv_hist,
+					    &tx_idle[b * num_sizes + i]);
+			if (ret) {
+				LPERROR("Failed to send packages.\n");
+				goto out;
+			}
+			/* Stop APU send interval */
+			ts_stop(&ch->ts, TS_APU_TO_RPU);
+			/* Wait for RPU to signal RPU receive interval is
+			 * ready to read */
+			notify_wait(&ch->remote_nkicked, ch->wait_policy);
+			/* Read interval values */
+			apu_tx_count[b * num_sizes + i] =
+				ts_read(&ch->ts, TS_APU_TO_RPU);
+			rpu_rx_count[b * num_sizes + i] =
+				ts_read(&ch->ts, TS_RPU_TO_APU);
+			hist_percentiles(&intv_hist, intv.st_max,
+					 &tx_pctl[b * num_sizes + i]);
+			export_result(TS_APU_TO_RPU, s, &tx_sweeps[b],
+				      apu_tx_count[b * num_sizes + i],
+				      rpu_rx_count[b * num_sizes + i],
+				      tx_idle[b * num_sizes + i],
+				      &intv, &tx_pctl[b * num_sizes + i]);
 		}
-		/* Stop RPU TTC counter */
-		stop_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU);
-		/* Wait for RPU to signal RPU RX TTC counter is ready to
-		 * read */
-		wait_for_notified(&ch->remote_nkicked);
-		/* Read TTC counter values */
-		apu_tx_count[i] = read_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU);
-		rpu_rx_count[i] = read_timer(ch->ttc_io, TTC_CNT_RPU_TO_APU);
 	}
 
-	/* Kick IPI to notify RPU that APU has read the RPU RX TTC counter
-	 * value */
-	metal_io_write32(ch->ipi_io, IPI_TRIG_OFFSET, ch->ipi_mask);
-
-	/* for each data size, measure block read throughput */
-	for (s = PKG_SIZE_MIN, i = 0; s <= PKG_SIZE_MAX; s <<= 1, i++) {
-		rx_count = 0;
-		iterations = TOTAL_DATA_SIZE / s;
-		/* Set rx buffer address offset */
-		rx_avail_offset = SHM_DESC_OFFSET_RX + SHM_DESC_AVAIL_OFFSET;
-		rx_addr_offset = SHM_DESC_OFFSET_RX +
-				SHM_DESC_ADDR_ARRAY_OFFSET;
-		rx_data_offset = SHM_DESC_OFFSET_RX + SHM_BUFF_OFFSET_RX;
-
-		wait_for_notified(&ch->remote_nkicked);
-		/* Data has arrived, measure start. Reset RPU TTC counter */
-		reset_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU);
-		while (1) {
-			rx_avail = metal_io_read32(ch->shm_io, rx_avail_offset);
-			while(rx_count != rx_avail) {
-				/* Get the buffer location from the shared
-				 * memory rx address array.
-			         */
-				buf_phy_addr_32 = metal_io_read32(ch->shm_io,
-							rx_addr_offset);
-				rx_data_offset = metal_io_phys_to_offset(
-					ch->shm_io,
-					(metal_phys_addr_t)buf_phy_addr_32);
-				if (rx_data_offset == METAL_BAD_OFFSET) {
-					LPERROR(
-					"[%u]failed to get rx offset: 0x%x, 0x%lx.\n",
-					rx_count, buf_phy_addr_32,
-					metal_io_phys(ch->shm_io,
-						rx_addr_offset));
-					ret = -EINVAL;
-					goto out;
-				}
-				rx_addr_offset += sizeof(buf_phy_addr_32);
-				/* Read data from shared memory */
-				metal_io_block_read(ch->shm_io, rx_data_offset,
-						lbuf, s);
-				rx_count++;
+	/* Kick IPI to notify RPU that APU has read the RPU receive interval */
+	notify_kick(ch->ipi_io, ch->ipi_mask);
+
+	/* for each sweep and data size, measure block read throughput */
+	for (b = 0; b < RX_SWEEPS_NUM; b++) {
+		for (i = 0; i < num_sizes; i++) {
+			s = demo_params.sizes[i];
+			iterations = demo_params.total_data_size / s;
+			intv = (struct metal_stat)STAT_INIT;
+			reset_hist(&intv_hist);
+
+			notify_wait(&ch->remote_nkicked, ch->wait_policy);
+			/* Data has arrived, measure start. Start APU
+			 * receive interval */
+			ts_start(&ch->ts, TS_APU_TO_RPU);
+			ret = shm_ring_attach(&rx_ring);
+			if (ret) {
+				LPERROR("Failed to attach to the rx ring.\n");
+				goto out;
 			}
-			if (rx_count < iterations)
-				/* Need to wait for more data */
-				wait_for_notified(&ch->remote_nkicked);
-			else
-				break;
+			if (rx_ring.slot_size > slot_size) {
+				LPERROR("RPU slots are larger than %u.\n",
+					slot_size);
+				ret = -EINVAL;
+				goto out;
+			}
+			ret = receive_packages(ch, &rx_ring, lbuf, s,
+					       iterations, &rx_sweeps[b],
+					       &intv, &intv_hist);
+			if (ret)
+				goto out;
+			/* Stop APU receive interval */
+			ts_stop(&ch->ts, TS_APU_TO_RPU);
+			/* Clear remote kicked flag -- 0 is kicked */
+			notify_reset(&ch->remote_nkicked);
+			/* Kick IPI to notify remote it is ready to read data */
+			notify_kick(ch->ipi_io, ch->ipi_mask);
+			/* Wait for RPU to signal RPU send interval is ready
+			 * to read */
+			notify_wait(&ch->remote_nkicked, ch->wait_policy);
+			/* Read interval values */
+			apu_rx_count[b * num_sizes + i] =
+				ts_read(&ch->ts, TS_APU_TO_RPU);
+			rpu_tx_count[b * num_sizes + i] =
+				ts_read(&ch->ts, TS_RPU_TO_APU);
+			hist_percentiles(&intv_hist, intv.st_max,
+					 &rx_pctl[b * num_sizes + i]);
+			export_result(TS_RPU_TO_APU, s, &rx_sweeps[b],
+				      apu_rx_count[b * num_sizes + i],
+				      rpu_tx_count[b * num_sizes + i], 0,
+				      &intv, &rx_pctl[b * num_sizes + i]);
+			/* Kick IPI to notify RPU APU has read the RPU send
+			 * interval */
+			notify_kick(ch->ipi_io, ch->ipi_mask);
+		}
+	}
+
+	/* for each sweep and data size, measure full duplex throughput */
+	run = 0;
+	for (b = 0; b < DUPLEX_SWEEPS_NUM; b++) {
+		for (i = 0; i < num_sizes; i++) {
+			s = demo_params.sizes[i];
+			iterations = demo_params.total_data_size / s;
+			run++;
+			/* Start from an empty tx ring */
+			shm_ring_reset(&tx_ring);
+			/* Wait for RPU to reset the rx ring */
+			notify_wait(&ch->remote_nkicked, ch->wait_policy);
+			ret = shm_ring_attach(&rx_ring);
+			if (ret) {
+				LPERROR("Failed to attach to the rx ring.\n");
+				goto out;
+			}
+			if (rx_ring.slot_size > slot_size) {
+				LPERROR("RPU slots are larger than %u.\n",
+					slot_size);
+				ret = -EINVAL;
+				goto out;
+			}
+			ts_start(&ch->ts, TS_APU_TO_RPU);
+			ret = duplex_packages(ch, &tx_ring, &rx_ring, lbuf, s,
+					      iterations, &duplex_sweeps[b],
+					      &duplex_tx[b * num_sizes + i],
+					      &duplex_rx[b * num_sizes + i]);
+			if (ret)
+				goto out;
+			ts_stop(&ch->ts, TS_APU_TO_RPU);
+			/* Kicks of the streaming may still be pending, wait
+			 * for the done word of this run */
+			while (1) {
+				shm_cache_invalidate(ch->shm_io,
+						     SHM_DUPLEX_DONE_OFFSET,
+						     sizeof(uint32_t));
+				if (metal_io_read32(ch->shm_io,
+						    SHM_DUPLEX_DONE_OFFSET) ==
+				    run)
+					break;
+				notify_wait(&ch->remote_nkicked,
+					    ch->wait_policy);
+			}
+			duplex_apu[b * num_sizes + i] =
+				ts_read(&ch->ts, TS_APU_TO_RPU);
+			duplex_rpu[b * num_sizes + i] =
+				ts_read(&ch->ts, TS_RPU_TO_APU);
+			export_duplex(s, &duplex_sweeps[b],
+				      duplex_tx[b * num_sizes + i],
+				      duplex_rx[b * num_sizes + i],
+				      duplex_rpu[b * num_sizes + i]);
+			/* Clear remote kicked flag -- 0 is kicked */
+			notify_reset(&ch->remote_nkicked);
+			/* Kick IPI to notify RPU APU has read the RPU
+			 * interval */
+			notify_kick(ch->ipi_io, ch->ipi_mask);
 		}
-		/* Stop RPU TTC counter */
-		stop_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU);
-		/* Clear remote kicked flag -- 0 is kicked */
-		atomic_flag_clear(&ch->remote_nkicked);
-		atomic_flag_test_and_set(&ch->remote_nkicked);
-		/* Kick IPI to notify remote it is ready to read data */
-		metal_io_write32(ch->ipi_io, IPI_TRIG_OFFSET, ch->ipi_mask);
-		/* Wait for RPU to signal RPU TX TTC counter is ready to
-		 * read */
-		wait_for_notified(&ch->remote_nkicked);
-		/* Read TTC counter values */
-		apu_rx_count[i] = read_timer(ch->ttc_io, TTC_CNT_APU_TO_RPU);
-		rpu_tx_count[i] = read_timer(ch->ttc_io, TTC_CNT_RPU_TO_APU);
-		/* Kick IPI to notify RPU APU has read the RPU TX TTC counter
-		 * value */
-		metal_io_write32(ch->ipi_io, IPI_TRIG_OFFSET, ch->ipi_mask);
 	}
 
+	/* measure mixed size messages through the message queue */
+	ret = measure_msgq(ch, &msgq, lbuf, msgq_count, msgq_len);
+	if (ret)
+		goto out;
+
+	/* measure the upload with credit flow control */
+	ret = measure_flow_control(ch, &tx_ring, lbuf);
+	if (ret)
+		goto out;
+
 	/* Print the measurement result */
-	float mbs = TTC_CLK_FREQ_HZ * (TOTAL_DATA_SIZE / MB);
-	for (s = PKG_SIZE_MIN, i = 0; s <= PKG_SIZE_MAX; s <<= 1, i++) {
-		LPRINTF("Shared memory throughput of pkg size %lu : \n", s);
-		LPRINTF("    APU send:    %u, %d MB/s\n", apu_tx_count[i], (int)(mbs / apu_tx_count[i])*100);
-		LPRINTF("    RPU receive: %u, %d MB/s\n", rpu_rx_count[i], (int)(mbs / rpu_rx_count[i])*100);
-		LPRINTF("    RPU send:    %u, %d MB/s\n", rpu_tx_count[i], (int)(mbs / rpu_tx_count[i])*100);
-		LPRINTF("    APU receive: %u, %d MB/s\n", apu_rx_count[i], (int)(mbs / apu_rx_count[i])*100);
+	for (i = 0; i < num_sizes; i++) {
+		s = demo_params.sizes[i];
+		/* Whole packages of odd sizes fit less than the total */
+		float mbs = ts_freq() *
+			((float)(demo_params.total_data_size / s) * s / MB);
+
+		RPRINTF("Shared memory throughput of pkg size %lu (%s, %s copy, %s ticks): \n",
+			s, shm_cacheable ? "cacheable" : "non-cacheable",
+			shm_neon_copy ? "NEON" : "generic", ts_backend_name());
+		for (b = 0; b < TX_SWEEPS_NUM; b++) {
+			uint64_t apu_tx = apu_tx_count[b * num_sizes + i];
+			uint64_t rpu_rx = rpu_rx_count[b * num_sizes + i];
+
+			print_sweep_opts("upload", &tx_sweeps[b]);
+			RPRINTF("      APU send:    %lu, %d MB/s\n", apu_tx, (int)(mbs / apu_tx)*100);
+			RPRINTF("      RPU receive: %lu, %d MB/s\n", rpu_rx, (int)(mbs / rpu_rx)*100);
+			if (tx_sweeps[b].dma)
+				RPRINTF("      APU idle:    %lu, %lu%%\n",
+					tx_idle[b * num_sizes + i],
+					apu_tx ? tx_idle[b * num_sizes + i] *
+						 100 / apu_tx : 0);
+			print_pctl("      kick interval",
+				   &tx_pctl[b * num_sizes + i]);
+		}
+		for (b = 0; b < RX_SWEEPS_NUM; b++) {
+			uint64_t rpu_tx = rpu_tx_count[b * num_sizes + i];
+			uint64_t apu_rx = apu_rx_count[b * num_sizes + i];
+
+			print_sweep_opts("download", &rx_sweeps[b]);
+			RPRINTF("      RPU send:    %lu, %d MB/s\n", rpu_tx, (int)(mbs / rpu_tx)*100);
+			RPRINTF("      APU receive: %lu, %d MB/s\n", apu_rx, (int)(mbs / apu_rx)*100);
+			print_pctl("      notification interval",
+				   &rx_pctl[b * num_sizes + i]);
+		}
+		for (b = 0; b < DUPLEX_SWEEPS_NUM; b++) {
+			uint64_t dtx = duplex_tx[b * num_sizes + i];
+			uint64_t drx = duplex_rx[b * num_sizes + i];
+			uint64_t apu = duplex_apu[b * num_sizes + i];
+			uint64_t rpu = duplex_rpu[b * num_sizes + i];
+
+			tb = find_sweep(tx_sweeps, TX_SWEEPS_NUM,
+					&duplex_sweeps[b], 1);
+			rb = find_sweep(rx_sweeps, RX_SWEEPS_NUM,
+					&duplex_sweeps[b], 0);
+			print_sweep_opts("full duplex", &duplex_sweeps[b]);
+			RPRINTF("      APU send:    %lu, %d MB/s\n", dtx, (int)(mbs / dtx)*100);
+			RPRINTF("      APU receive: %lu, %d MB/s\n", drx, (int)(mbs / drx)*100);
+			RPRINTF("      APU both:    %lu, %d MB/s\n", apu, (int)(2 * mbs / apu)*100);
+			RPRINTF("      RPU both:    %lu, %d MB/s\n", rpu, (int)(2 * mbs / rpu)*100);
+			print_slowdown("send", dtx, tb < 0 ? 0 :
+				       apu_tx_count[tb * num_sizes + i]);
+			print_slowdown("receive", drx, rb < 0 ? 0 :
+				       apu_rx_count[rb * num_sizes + i]);
+		}
+	}
+
+	/* Smallest package size the DMA uploads faster than the CPU copy of
+	 * the same batch */
+	for (b = 0; b < TX_SWEEPS_NUM; b++) {
+		struct sweep_opts copy_opts = { .batch = tx_sweeps[b].batch, };
+
+		if (!tx_sweeps[b].dma)
+			continue;
+		tb = find_sweep(tx_sweeps, TX_SWEEPS_NUM, &copy_opts, 1);
+		if (tb < 0) {
+			RPRINTF("CPU copy vs DMA crossover, batch %u: n/a\n",
+				tx_sweeps[b].batch);
+			continue;
+		}
+		crossover = 0;
+		for (i = 0; i < num_sizes && !crossover; i++) {
+			if (apu_tx_count[b * num_sizes + i] <
+			    apu_tx_count[tb * num_sizes + i])
+				crossover = demo_params.sizes[i];
+		}
+		if (crossover)
+			RPRINTF("CPU copy vs DMA crossover, batch %u: %lu\n",
+				tx_sweeps[b].batch, crossover);
+		else
+			RPRINTF("CPU copy vs DMA crossover, batch %u: none\n",
+				tx_sweeps[b].batch);
 	}
 
 	LPRINTF("Finished shared memory throughput\n");
 
 out:
 	if (lbuf)
-		metal_free_memory(lbuf);
+		ocm_free(lbuf);
 	if (apu_tx_count)
 		metal_free_memory(apu_tx_count);
 	if (apu_rx_count)
@@ -365,46 +1542,46 @@ out:
 	return ret;
 }
 
-int shmem_throughput_demo()
+int shmem_throughput_demo(struct bench_channel *bch)
 {
-	struct channel_s ch;
-	int ipi_irq;
+	static struct channel_s ch OCM_BSS;
+	int cacheable = shm_cacheable;
+	int neon_copy = shm_neon_copy;
+	int dma_irq;
 	int ret = 0;
+	size_t i, j;
 
 	print_demo("shared memory throughput");
 	memset(&ch, 0, sizeof(ch));
 
-	/* Get shared memory device IO region */
-	if (!shm_dev) {
-		ret = -ENODEV;
-		goto out;
-	}
-	ch.shm_io = metal_device_io_region(shm_dev, 0);
-	if (!ch.shm_io) {
-		LPERROR("Failed to map io region for %s.\n", shm_dev->name);
-		ret = -ENODEV;
-		goto out;
-	}
+	/* The regions are looked up once for all the tests */
+	ch.shm_io = bch->shm_io;
+	ch.ttc_io = bch->ttc_io;
+	ch.ipi_io = bch->ipi_io;
 
-	/* Get TTC IO region */
-	ch.ttc_io = metal_device_io_region(ttc_dev, 0);
-	if (!ch.ttc_io) {
-		LPERROR("Failed to map io region for %s.\n", ttc_dev->name);
-		ret = -ENODEV;
+	/* Initialize the timestamp source */
+	ret = ts_init(&ch.ts, ch.ttc_io, ch.shm_io);
+	if (ret) {
+		LPERROR("Failed to initialize the timestamp source.\n");
 		goto out;
 	}
 
-	/* Get IPI device IO region */
-	ch.ipi_io = metal_device_io_region(ipi_dev, 0);
-	if (!ch.ipi_io) {
-		LPERROR("Failed to map io region for %s.\n", ipi_dev->name);
+	/* Get GDMA channel IO region */
+	ch.dma_io = metal_device_io_region(gdma_dev, 0);
+	if (!ch.dma_io) {
+		LPERROR("Failed to map io region for %s.\n", gdma_dev->name);
 		ret = -ENODEV;
 		goto out;
 	}
 
 	/* initialize remote_nkicked */
-	atomic_flag_clear(&ch.remote_nkicked);
-	atomic_flag_test_and_set(&ch.remote_nkicked);
+	notify_reset(&ch.remote_nkicked);
+
+	/* Reset the GDMA channel and register its irq handler */
+	zdma_init(ch.dma_io);
+	dma_irq = (intptr_t)gdma_dev->irq_info;
+	metal_irq_register(dma_irq, dma_irq_handler, &ch);
+	metal_irq_enable(dma_irq);
 
 	/* disable IPI interrupt */
 	metal_io_write32(ch.ipi_io, IPI_IDR_OFFSET, IPI_MASK);
@@ -412,25 +1589,45 @@ int shmem_throughput_demo()
 	metal_io_write32(ch.ipi_io, IPI_ISR_OFFSET, IPI_MASK);
 
 	ch.ipi_mask = IPI_MASK;
+	ch.wait_policy = SHMEM_THROUGHPUT_WAIT_POLICY;
 
-	/* Get the IPI IRQ from the opened IPI device */
-	ipi_irq = (intptr_t)ipi_dev->irq_info;
-
-	/* Register IPI irq handler */
-	metal_irq_register(ipi_irq, ipi_irq_handler, &ch);
-	metal_irq_enable(ipi_irq);
+	/* Attach the IPI irq handler to the channel */
+	bench_irq_attach(bch, ipi_irq_handler, &ch);
 
 	/* Enable IPI interrupt */
-	metal_io_write32(ch.ipi_io, IPI_IER_OFFSET, IPI_MASK);
+	notify_irq_enable(ch.ipi_io, IPI_MASK);
 
-	/* Run atomic operation demo */
-	ret = measure_shmem_throughput(&ch);
+	/* Run the demo once per shared memory mapping and block copy */
+	for (i = 0; i < SHM_CACHE_MODES_NUM && !ret; i++) {
+		ret = sys_shm_set_cacheable(shm_cache_modes[i]);
+		if (ret) {
+			LPERROR("Failed to remap shared memory.\n");
+			break;
+		}
+		for (j = 0; j < SHM_COPY_MODES_NUM; j++) {
+			ret = sys_shm_set_neon_copy(shm_copy_modes[j]);
+			if (ret) {
+				LPERROR("Failed to set shared memory copy.\n");
+				break;
+			}
+			ret = measure_shmem_throughput(&ch);
+			if (ret)
+				break;
+		}
+	}
+	/* Restore the default mapping and copy */
+	sys_shm_set_cacheable(cacheable);
+	sys_shm_set_neon_copy(neon_copy);
 
 	/* disable IPI interrupt */
 	metal_io_write32(ch.ipi_io, IPI_IDR_OFFSET, IPI_MASK);
-	/* unregister IPI irq handler */
-	metal_irq_disable(ipi_irq);
-	metal_irq_unregister(ipi_irq);
+	/* detach IPI irq handler */
+	bench_irq_detach(bch);
+
+	/* Stop the GDMA channel and unregister its irq handler */
+	zdma_fini(ch.dma_io);
+	metal_irq_disable(dma_irq);
+	metal_irq_unregister(dma_irq);
 
 out:
 	return ret;
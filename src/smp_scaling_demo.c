@@ -0,0 +1,620 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * smp_scaling_demo.c
+ * This demo measures how the IPI latency and the shared memory throughput
+ * scale when several APU cores talk to the RPU at the same time.
+ * Each APU core has its own IPI channel and its own shared memory
+ * partition, so the cores only share the RPU and the interconnect.
+ * This demo does the follwing steps:
+ *
+ *  1. Start the secondary APU cores with PSCI CPU_ON. They run with the
+ *     MMU, cache and exception setup of the primary core.
+ *  2. For 1 to the number of online cores, run a round on that many cores:
+ *     a. Each core measures the round trip latency of its IPI channel
+ *        for the number of iterations of the parameters.
+ *     b. All the cores of the round wait for each other.
+ *     c. Each core uploads the total data size of the parameters through
+ *        its own ring and waits for the RPU to acknowledge it.
+ *  3. Report the results of each core and the aggregate of the round.
+ *  4. Turn the secondary cores off with PSCI CPU_OFF.
+ *
+ * The demo only runs when the DEMO_PARAMS_SMP flag is set. It needs the
+ * client to run at EL1, e.g. in a DomU with all four VCPUs, and the IPI
+ * channels 8 to 10 passed through to it. The RPU server must serve the
+ * IPI channels with the protocol below.
+ *
+ * Here is the structure of the shared memory partition of core n, at
+ * SMP_SHM_OFFSET(n):
+ * |0x00000 - 0x00003 | mode, SMP_MODE_*, written by the APU |
+ * |0x00004 - 0x00007 | data size of the throughput run, bytes |
+ * |0x01000 - ...     | ring descriptor area, see shm_ring.h |
+ * |0x10000 - ...     | ring slots |
+ *
+ * The APU writes the mode and kicks the IPI channel of the core:
+ * - SMP_MODE_LATENCY: the RPU kicks back for every kick of the APU.
+ * - SMP_MODE_THROUGHPUT: the RPU attaches to the ring, consumes the data
+ *   size and then kicks back once.
+ * - SMP_MODE_IDLE: the RPU stops serving the channel, no kick back.
+ *
+ * The times of the records are system count ticks, see ts_cnt_freq().
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <metal/atomic.h>
+#include <metal/io.h>
+#include <metal/cache.h>
+#include <metal/device.h>
+#include <metal/irq.h>
+#include <xil_exception.h>
+#include "common.h"
+#include "sys_init.h"
+#include "timestamp.h"
+#include "demo_params.h"
+#include "results.h"
+#include "shm_ring.h"
+#include "shm_layout.h"
+#include "bench.h"
+
+/* Shared memory partition of a core, at SMP_SHM_OFFSET(core) */
+#define SMP_SHM_MODE_OFFSET       0x00000
+#define SMP_SHM_SIZE_OFFSET       0x00004
+#define SMP_SHM_RING_OFFSET       0x01000
+#define SMP_SHM_SLOTS_OFFSET      0x10000
+
+#define SMP_MODE_IDLE             0x0
+#define SMP_MODE_LATENCY          0x1
+#define SMP_MODE_THROUGHPUT       0x2
+
+#define SMP_NUM_SLOTS             256
+#define SMP_SLOT_SIZE_MAX         4096
+#define SMP_STACK_SIZE            0x2000
+
+/* PSCI functions, SMC64 calling convention */
+#define PSCI_CPU_OFF              0x84000002
+#define PSCI_CPU_ON               0xC4000003
+
+/* How long a secondary core has to come online */
+#define SMP_ONLINE_TIMEOUT_MS     100
+
+/* How to wait for the RPU kick, see enum wait_policy */
+#ifndef SMP_WAIT_POLICY
+#define SMP_WAIT_POLICY WAIT_POLICY_WFI
+#endif
+
+/**
+ * per core state, only written by its core during a round
+ */
+struct smp_core {
+	struct metal_io_region *ipi_io; /* IPI metal i/o region */
+	struct metal_io_region *shm_io; /* Shared memory metal i/o region */
+	struct shm_ring ring; /* upload ring of the partition */
+	unsigned long shm_offset; /* shared memory partition offset */
+	int ipi_irq; /* IPI interrupt of the core */
+	atomic_flag remote_nkicked; /* 0 - kicked from remote */
+	struct metal_stat lat; /* round trip latency */
+	struct metal_hist lat_hist; /* round trip latency histogram */
+	uint64_t tput_start; /* system count at the throughput run start */
+	uint64_t tput_end; /* system count at the throughput run end */
+	int ret; /* return code of the round */
+	uint8_t lbuf[SMP_SLOT_SIZE_MAX]; /* upload data */
+} __attribute__((aligned(64)));
+
+/**
+ * state the secondary cores load before enabling their MMU, read with
+ * the MMU off, so it has to be cleaned to memory
+ */
+struct smp_boot {
+	uint64_t mair; /* 0x00 */
+	uint64_t tcr; /* 0x08 */
+	uint64_t ttbr0; /* 0x10 */
+	uint64_t vbar; /* 0x18 */
+	uint64_t cpacr; /* 0x20 */
+	uint64_t sctlr; /* 0x28 */
+	uint64_t sp[SMP_CORES_MAX]; /* 0x30, top of stack of each core */
+};
+
+static struct smp_boot smp_boot __attribute__((used, aligned(64)));
+static uint8_t smp_stacks[SMP_CORES_MAX][SMP_STACK_SIZE]
+	__attribute__((aligned(16)));
+static struct smp_core smp_cores[SMP_CORES_MAX];
+
+static atomic_uint smp_online; /* bitmask of the online cores */
+static atomic_uint smp_round; /* round number, bumped to start a round */
+static atomic_uint smp_round_cores; /* cores taking part in the round */
+static atomic_uint smp_arrived; /* cores done with the latency phase */
+static atomic_uint smp_done; /* secondary cores done with the round */
+static atomic_int smp_quit; /* 1 - secondary cores turn off */
+
+/*
+ * Entry of a secondary core, x0 is the core index. Load the system
+ * registers of the primary core, enable the MMU, switch to the stack of
+ * the core and run smp_secondary_main().
+ */
+void smp_secondary_entry(void);
+void smp_secondary_main(uint64_t core);
+asm(".section .text\n"
+    ".global smp_secondary_entry\n"
+    ".type smp_secondary_entry, %function\n"
+    "smp_secondary_entry:\n"
+    "	adrp x1, smp_boot\n"
+    "	add x1, x1, :lo12:smp_boot\n"
+    "	ldp x2, x3, [x1, #0x00]\n"
+    "	msr mair_el1, x2\n"
+    "	msr tcr_el1, x3\n"
+    "	ldp x2, x3, [x1, #0x10]\n"
+    "	msr ttbr0_el1, x2\n"
+    "	msr vbar_el1, x3\n"
+    "	ldp x2, x3, [x1, #0x20]\n"
+    "	msr cpacr_el1, x2\n"
+    "	tlbi vmalle1\n"
+    "	dsb sy\n"
+    "	isb\n"
+    "	msr sctlr_el1, x3\n"
+    "	isb\n"
+    "	add x2, x1, #0x30\n"
+    "	ldr x2, [x2, x0, lsl #3]\n"
+    "	mov sp, x2\n"
+    "	bl smp_secondary_main\n"
+    "1:	wfe\n"
+    "	b 1b\n"
+    ".size smp_secondary_entry, . - smp_secondary_entry\n");
+
+/**
+ * @brief psci_call() - call a PSCI function
+ *        The hypervisor implements PSCI for a DomU, the secure monitor
+ *        does without Xen.
+ *
+ * @param[in] fn - PSCI function ID
+ * @param[in] a1 - first argument
+ * @param[in] a2 - second argument
+ * @param[in] a3 - third argument
+ * @return - PSCI return code, 0 on success.
+ */
+static int64_t psci_call(uint64_t fn, uint64_t a1, uint64_t a2, uint64_t a3)
+{
+	register uint64_t x0 asm("x0") = fn;
+	register uint64_t x1 asm("x1") = a1;
+	register uint64_t x2 asm("x2") = a2;
+	register uint64_t x3 asm("x3") = a3;
+
+#ifdef NOXEN
+	asm volatile("smc #0" : "+r" (x0) : "r" (x1), "r" (x2), "r" (x3)
+		     : "memory");
+#else
+	asm volatile("hvc #0" : "+r" (x0) : "r" (x1), "r" (x2), "r" (x3)
+		     : "memory");
+#endif
+	return (int64_t)x0;
+}
+
+/**
+ * @brief smp_ipi_irq_handler() - IPI interrupt handler of a core
+ *        It is routed to the core which owns the IPI channel.
+ *
+ * @param[in] vect_id - IPI interrupt vector ID
+ * @param[in/out] priv - state of the core
+ *
+ * @return - If the IPI interrupt is triggered by its remote, it returns
+ *           METAL_IRQ_HANDLED. It returns METAL_IRQ_NOT_HANDLED, if it is
+ *           not the interrupt it expected.
+ */
+static int smp_ipi_irq_handler(int vect_id, void *priv)
+{
+	struct smp_core *c = (struct smp_core *)priv;
+	uint32_t val;
+	(void)vect_id;
+
+	trace_event(TRACE_IRQ_ENTER, vect_id);
+	if (c) {
+		val = metal_io_read32(c->ipi_io, IPI_ISR_OFFSET);
+		if (val & IPI_MASK) {
+			metal_io_write32(c->ipi_io, IPI_ISR_OFFSET, IPI_MASK);
+			atomic_flag_clear(&c->remote_nkicked);
+			trace_event(TRACE_FLAG_CLEAR, vect_id);
+			return METAL_IRQ_HANDLED;
+		}
+	}
+	return METAL_IRQ_NOT_HANDLED;
+}
+
+/**
+ * @brief smp_set_mode() - set the mode of a core and kick the RPU
+ *
+ * @param[in] c - state of the core
+ * @param[in] mode - SMP_MODE_*
+ */
+static void smp_set_mode(struct smp_core *c, uint32_t mode)
+{
+	metal_io_write32(c->shm_io, c->shm_offset + SMP_SHM_MODE_OFFSET, mode);
+	shm_cache_flush(c->shm_io, c->shm_offset, 0x40);
+	metal_io_write32(c->ipi_io, IPI_TRIG_OFFSET, IPI_MASK);
+}
+
+/**
+ * @brief smp_barrier() - wait for all the cores of the round
+ *
+ * @param[in] cores - number of cores of the round
+ */
+static void smp_barrier(unsigned int cores)
+{
+	atomic_fetch_add(&smp_arrived, 1);
+	asm volatile("sev");
+	while (atomic_load(&smp_arrived) < cores)
+		wait_for_event();
+}
+
+/**
+ * @brief smp_run_core() - run the round on the calling core
+ *        Measure the IPI round trip latency, wait for the other cores,
+ *        then upload the data size through the ring of the core.
+ *
+ * @param[in] c - state of the core
+ * @param[in] cores - number of cores of the round
+ */
+static void smp_run_core(struct smp_core *c, unsigned int cores)
+{
+	uint32_t size = demo_params.total_data_size;
+	uint32_t i, sent, len;
+	uint64_t start;
+	int ret;
+
+	/* IPI round trip latency */
+	c->lat = (struct metal_stat)STAT_INIT;
+	reset_hist(&c->lat_hist);
+	metal_io_write32(c->shm_io, c->shm_offset + SMP_SHM_MODE_OFFSET,
+			 SMP_MODE_LATENCY);
+	shm_cache_flush(c->shm_io, c->shm_offset, 0x40);
+	for (i = 0; i < demo_params.iterations; i++) {
+		start = ts_now();
+		metal_io_write32(c->ipi_io, IPI_TRIG_OFFSET, IPI_MASK);
+		wait_for_notified(&c->remote_nkicked, SMP_WAIT_POLICY);
+		start = ts_now() - start;
+		update_stat(&c->lat, start);
+		update_hist(&c->lat_hist, start);
+	}
+
+	smp_barrier(cores);
+
+	/* Upload through the ring */
+	shm_ring_reset(&c->ring);
+	metal_io_write32(c->shm_io, c->shm_offset + SMP_SHM_SIZE_OFFSET, size);
+	c->ret = 0;
+	c->tput_start = ts_now();
+	smp_set_mode(c, SMP_MODE_THROUGHPUT);
+	for (sent = 0; sent < size; sent += len) {
+		len = size - sent < c->ring.slot_size ?
+		      size - sent : c->ring.slot_size;
+		while ((ret = shm_ring_write(&c->ring, c->lbuf, len)) ==
+		       -EAGAIN)
+			;
+		if (ret < 0) {
+			c->ret = ret;
+			break;
+		}
+		shm_ring_publish(&c->ring);
+	}
+	if (!c->ret)
+		wait_for_notified(&c->remote_nkicked, SMP_WAIT_POLICY);
+	c->tput_end = ts_now();
+
+	smp_set_mode(c, SMP_MODE_IDLE);
+}
+
+/**
+ * @brief smp_secondary_main() - main loop of a secondary core
+ *        Run the rounds the core takes part in until smp_quit is set.
+ *
+ * @param[in] core - index of the core
+ */
+void smp_secondary_main(uint64_t core)
+{
+	unsigned int round = 0;
+
+	sys_cpu_irq_init();
+	atomic_fetch_or(&smp_online, 1U << core);
+	asm volatile("sev");
+
+	while (1) {
+		while (atomic_load(&smp_round) == round &&
+		       !atomic_load(&smp_quit))
+			wait_for_event();
+		if (atomic_load(&smp_quit))
+			break;
+		round = atomic_load(&smp_round);
+		if (core < atomic_load(&smp_round_cores))
+			smp_run_core(&smp_cores[core],
+				     atomic_load(&smp_round_cores));
+		atomic_fetch_add(&smp_done, 1);
+		asm volatile("sev");
+	}
+
+	Xil_ExceptionDisable();
+	atomic_fetch_and(&smp_online, ~(1U << core));
+	asm volatile("sev");
+	psci_call(PSCI_CPU_OFF, 0, 0, 0);
+}
+
+/**
+ * @brief smp_start_cores() - start the secondary cores
+ *        Stop at the first core which does not come online, so the
+ *        online cores are always 0 to the returned number - 1.
+ *
+ * @return - number of online cores, including the primary core.
+ */
+static unsigned int smp_start_cores(void)
+{
+	uint64_t timeout, entry = (uintptr_t)smp_secondary_entry;
+	unsigned int core;
+	int64_t ret;
+
+	asm volatile("mrs %0, mair_el1" : "=r" (smp_boot.mair));
+	asm volatile("mrs %0, tcr_el1" : "=r" (smp_boot.tcr));
+	asm volatile("mrs %0, ttbr0_el1" : "=r" (smp_boot.ttbr0));
+	asm volatile("mrs %0, vbar_el1" : "=r" (smp_boot.vbar));
+	asm volatile("mrs %0, cpacr_el1" : "=r" (smp_boot.cpacr));
+	asm volatile("mrs %0, sctlr_el1" : "=r" (smp_boot.sctlr));
+	for (core = 0; core < SMP_CORES_MAX; core++)
+		smp_boot.sp[core] = (uintptr_t)smp_stacks[core] +
+				    SMP_STACK_SIZE;
+	metal_cache_flush(&smp_boot, sizeof(smp_boot));
+
+	atomic_store(&smp_online, 1);
+	for (core = 1; core < SMP_CORES_MAX; core++) {
+		/* Affinity level 0 is the core in the APU cluster */
+		ret = psci_call(PSCI_CPU_ON, core, entry, core);
+		if (ret) {
+			LPRINTF("core %u: CPU_ON failed: %ld\n", core, (long)ret);
+			break;
+		}
+		timeout = ts_now() +
+			  ts_cnt_freq() * SMP_ONLINE_TIMEOUT_MS / 1000;
+		while (!(atomic_load(&smp_online) & (1U << core)) &&
+		       ts_now() < timeout)
+			;
+		if (!(atomic_load(&smp_online) & (1U << core))) {
+			LPERROR("core %u did not come online.\n", core);
+			break;
+		}
+	}
+	return core;
+}
+
+/**
+ * @brief smp_stop_cores() - turn the secondary cores off
+ */
+static void smp_stop_cores(void)
+{
+	atomic_store(&smp_quit, 1);
+	asm volatile("sev");
+	while (atomic_load(&smp_online) & ~1U)
+		wait_for_event();
+}
+
+/**
+ * @brief smp_report() - report and export the results of a round
+ *
+ * @param[in] cores - number of cores of the round
+ */
+static void smp_report(unsigned int cores)
+{
+	static struct metal_hist all_hist;
+	struct metal_stat all = STAT_INIT;
+	struct demo_result res;
+	uint64_t freq = ts_cnt_freq();
+	uint64_t start = ~0ULL, end = 0, cnt;
+	unsigned int i, j;
+	struct smp_core *c;
+
+	RPRINTF("SMP scaling, %u cores:\n", cores);
+	reset_hist(&all_hist);
+	memset(&res, 0, sizeof(res));
+	res.cores = cores;
+	for (i = 0; i < cores; i++) {
+		c = &smp_cores[i];
+		cnt = c->tput_end - c->tput_start;
+		RPRINTF("core %u: round trip [%lu, %lu] avg: %lu ns, "
+			"upload %lu MB/s\n", i, c->lat.st_min, c->lat.st_max,
+			ts_cnt_to_ns(c->lat.st_sum) / c->lat.st_cnt,
+			cnt ? ((uint64_t)demo_params.total_data_size * freq /
+			       cnt) >> 20 : 0);
+
+		res.core = i;
+		res.test = DEMO_TEST_SMP_LATENCY;
+		res.pkg_size = 0;
+		res.apu_ticks = 0;
+		res.stat = c->lat;
+		hist_percentiles(&c->lat_hist, c->lat.st_max, &res.pctl);
+		results_add(&res, &c->lat_hist);
+		res.test = DEMO_TEST_SMP_THROUGHPUT;
+		res.pkg_size = c->ring.slot_size;
+		res.apu_ticks = cnt;
+		memset(&res.stat, 0, sizeof(res.stat));
+		memset(&res.pctl, 0, sizeof(res.pctl));
+		results_add(&res, NULL);
+
+		/* aggregate */
+		all.st_cnt += c->lat.st_cnt;
+		all.st_sum += c->lat.st_sum;
+		if (all.st_min > c->lat.st_min)
+			all.st_min = c->lat.st_min;
+		if (all.st_max < c->lat.st_max)
+			all.st_max = c->lat.st_max;
+		all_hist.h_cnt += c->lat_hist.h_cnt;
+		for (j = 0; j < HIST_BUCKETS; j++)
+			all_hist.h_bucket[j] += c->lat_hist.h_bucket[j];
+		if (start > c->tput_start)
+			start = c->tput_start;
+		if (end < c->tput_end)
+			end = c->tput_end;
+	}
+
+	/* The aggregate throughput is over the span of all the uploads */
+	cnt = end - start;
+	RPRINTF("all cores: round trip avg: %lu ns, upload %lu MB/s\n",
+		ts_cnt_to_ns(all.st_sum) / all.st_cnt,
+		cnt ? ((uint64_t)demo_params.total_data_size * cores * freq /
+		       cnt) >> 20 : 0);
+	res.core = RESULT_CORE_ALL;
+	res.test = DEMO_TEST_SMP_LATENCY;
+	res.pkg_size = 0;
+	res.apu_ticks = 0;
+	res.stat = all;
+	hist_percentiles(&all_hist, all.st_max, &res.pctl);
+	print_pctl("all cores round trip", &res.pctl);
+	results_add(&res, &all_hist);
+	res.test = DEMO_TEST_SMP_THROUGHPUT;
+	res.pkg_size = smp_cores[0].ring.slot_size;
+	res.apu_ticks = cnt;
+	memset(&res.stat, 0, sizeof(res.stat));
+	memset(&res.pctl, 0, sizeof(res.pctl));
+	results_add(&res, NULL);
+}
+
+/**
+ * @brief measure_smp_scaling() - run a round for each number of cores
+ *
+ * @param[in] online - number of online cores
+ * @return - 0 on success, error code if failure.
+ */
+static int measure_smp_scaling(unsigned int online)
+{
+	unsigned int cores, i;
+
+	LPRINTF("Starting SMP scaling\n");
+	for (cores = 1; cores <= online; cores++) {
+		atomic_store(&smp_round_cores, cores);
+		atomic_store(&smp_arrived, 0);
+		atomic_store(&smp_done, 0);
+		atomic_fetch_add(&smp_round, 1);
+		asm volatile("sev");
+
+		smp_run_core(&smp_cores[0], cores);
+		while (atomic_load(&smp_done) < online - 1)
+			wait_for_event();
+
+		for (i = 0; i < cores; i++) {
+			if (smp_cores[i].ret) {
+				LPERROR("core %u: upload failed: %d\n",
+					i, smp_cores[i].ret);
+				return smp_cores[i].ret;
+			}
+		}
+		smp_report(cores);
+	}
+	LPRINTF("Finished SMP scaling\n");
+	return 0;
+}
+
+/**
+ * @brief smp_detach_cores() - disable the IPI interrupts of the first
+ *        cores and detach their handlers
+ *
+ * @param[in] bch - channel of the tests, the IPI of core 0
+ * @param[in] num - number of cores to detach
+ */
+static void smp_detach_cores(struct bench_channel *bch, unsigned int num)
+{
+	struct smp_core *c;
+	unsigned int core;
+
+	for (core = 0; core < num; core++) {
+		c = &smp_cores[core];
+		metal_io_write32(c->ipi_io, IPI_IDR_OFFSET, IPI_MASK);
+		if (!core) {
+			bench_irq_detach(bch);
+		} else {
+			metal_irq_disable(c->ipi_irq);
+			metal_irq_unregister(c->ipi_irq);
+		}
+	}
+}
+
+int smp_scaling_demo(struct bench_channel *bch)
+{
+	struct metal_io_region *shm_io;
+	struct smp_core *c;
+	unsigned int online, core;
+	uint32_t slot_size;
+	uint64_t el;
+	int ret = 0;
+
+	print_demo("SMP scaling");
+
+	asm volatile("mrs %0, CurrentEL" : "=r" (el));
+	if (((el >> 2) & 0x3) != 1) {
+		LPERROR("SMP scaling needs the client at EL1.\n");
+		return -ENOTSUP;
+	}
+
+	shm_io = bch->shm_io;
+
+	slot_size = demo_params.pkg_size_max < SMP_SLOT_SIZE_MAX ?
+		    demo_params.pkg_size_max : SMP_SLOT_SIZE_MAX;
+	for (core = 0; core < SMP_CORES_MAX; core++) {
+		c = &smp_cores[core];
+		memset(c, 0, sizeof(*c));
+		c->shm_io = shm_io;
+		c->shm_offset = SMP_SHM_OFFSET(core);
+		c->ipi_io = metal_device_io_region(smp_ipi_dev[core], 0);
+		if (!c->ipi_io) {
+			LPERROR("Failed to map io region of core %u IPI.\n",
+				core);
+			smp_detach_cores(bch, core);
+			return -ENODEV;
+		}
+		ret = shm_ring_init(&c->ring, shm_io,
+				    c->shm_offset + SMP_SHM_RING_OFFSET,
+				    c->shm_offset + SMP_SHM_SLOTS_OFFSET,
+				    SMP_NUM_SLOTS, slot_size);
+		if (ret) {
+			smp_detach_cores(bch, core);
+			return ret;
+		}
+		memset(c->lbuf, 0xA5 + core, slot_size);
+
+		/* disable and clear the IPI interrupt */
+		metal_io_write32(c->ipi_io, IPI_IDR_OFFSET, IPI_MASK);
+		metal_io_write32(c->ipi_io, IPI_ISR_OFFSET, IPI_MASK);
+		metal_io_write32(c->shm_io, c->shm_offset + SMP_SHM_MODE_OFFSET,
+				 SMP_MODE_IDLE);
+		shm_cache_flush(c->shm_io, c->shm_offset, 0x40);
+
+		atomic_flag_clear(&c->remote_nkicked);
+		atomic_flag_test_and_set(&c->remote_nkicked);
+
+		/* The IPI of core 0 is the channel of the other tests */
+		c->ipi_irq = (intptr_t)smp_ipi_dev[core]->irq_info;
+		if (!core) {
+			bench_irq_attach(bch, smp_ipi_irq_handler, c);
+		} else {
+			metal_irq_register(c->ipi_irq, smp_ipi_irq_handler, c);
+			metal_irq_enable(c->ipi_irq);
+		}
+		metal_io_write32(c->ipi_io, IPI_IER_OFFSET, IPI_MASK);
+	}
+
+	/* The demo may run again, the restarted secondary cores wait for
+	 * round 1 */
+	atomic_store(&smp_round, 0);
+	atomic_store(&smp_round_cores, 0);
+	atomic_store(&smp_arrived, 0);
+	atomic_store(&smp_done, 0);
+	atomic_store(&smp_quit, 0);
+	online = smp_start_cores();
+	LPRINTF("%u APU cores online\n", online);
+
+	ret = measure_smp_scaling(online);
+
+	smp_stop_cores();
+	smp_detach_cores(bch, SMP_CORES_MAX);
+	return ret;
+}
@@ -8,11 +8,19 @@
 #include <metal/device.h>
 #include <metal/sys.h>
 #include <metal/irq.h>
+#include <metal/cache.h>
 
 #include "xil_mmu.h"
 
 #include "platform_config.h"
 #include "common.h"
+#include "demo_params.h"
+#include "results.h"
+#include "shm_copy.h"
+#include "timestamp.h"
+#include "notify.h"
+#include "shm_layout.h"
+#include "ocm.h"
 
 #ifdef STDOUT_IS_16550
  #include <xuartns550_l.h>
@@ -23,15 +31,42 @@
 #define INTC_DEVICE_ID		XPAR_SCUGIC_0_DEVICE_ID
 
 #define IPI_IRQ_VECT_ID         61
+/* IPI channels 8 to 10 of the secondary cores, see smp_scaling_demo.c */
+#define IPI1_IRQ_VECT_ID        62
+#define IPI2_IRQ_VECT_ID        63
+#define IPI3_IRQ_VECT_ID        64
+#define GDMA_IRQ_VECT_ID        156 /* GDMA channel 0, SPI 124 */
 
 #define SHM_BASE_ADDR   0x3ED80000
 #define TTC0_BASE_ADDR  0xFF110000
 #define IPI_BASE_ADDR   0xFF340000
+#define IPI1_BASE_ADDR  0xFF350000
+#define IPI2_BASE_ADDR  0xFF360000
+#define IPI3_BASE_ADDR  0xFF370000
+#define GDMA_BASE_ADDR  0xFD500000 /* GDMA channel 0 */
 
 /* Set mem_flags for Cortex A53. Defined in xil_mmu.h. */
 #define DEVICE_NONSHARED		DEVICE_MEMORY			/* Device memory (Device-nGnRE)*/
 //#define	PRIV_RW_USER_RW		(0x00000003U<<8U)		/*Full Access used for Cortex R5*/
 #define NORM_SHARED_NCACHE 		NORM_NONCACHE			/* Normal Non-cacheable*/
+#define NORM_SHARED_CACHE		NORM_WB_CACHE			/* Normal write-back cacheable*/
+
+/* Shared memory mapping at boot, build with SHM_CACHEABLE to map it
+ * cacheable. The mapping can be changed with sys_shm_set_cacheable(). */
+#ifdef SHM_CACHEABLE
+#define SHM_MEM_FLAGS			NORM_SHARED_CACHE
+#else
+#define SHM_MEM_FLAGS			NORM_SHARED_NCACHE
+#endif
+
+/* Shared memory block copy at boot, build with SHM_COPY_NEON to use the
+ * NEON copy. The copy can be changed with sys_shm_set_neon_copy(). */
+#ifdef SHM_COPY_NEON
+#define SHM_COPY_OPS	{ .block_read = shm_copy_neon_block_read, \
+			  .block_write = shm_copy_neon_block_write, }
+#else
+#define SHM_COPY_OPS	{NULL}
+#endif
 
 /* Default generic I/O region page shift */
 /* Each I/O region can contain multiple pages.
@@ -44,18 +79,60 @@
 
 static XScuGic xInterruptController;
 
+/**
+ * startup phases, each is marked when it ends
+ */
+enum init_phase {
+	INIT_PHASE_ENTRY = 0,
+	INIT_PHASE_IRQ,
+	INIT_PHASE_METAL,
+	INIT_PHASE_XLNX_IRQ,
+	INIT_PHASE_REGISTER,
+	INIT_PHASE_OPEN,
+	INIT_PHASE_PARAMS,
+	INIT_PHASE_RESULTS,
+	INIT_PHASE_READY,
+	INIT_PHASE_NUM,
+};
+
+static const char *init_phase_names[INIT_PHASE_NUM] = {
+	"sys_init entry", "GIC", "libmetal", "metal IRQ controller",
+	"register devices", "open devices", "parameters", "results",
+	"server ready",
+};
+
+/* System count at the end of each startup phase, 0 if not run. It is
+ * read before ts_init(), the virtual count, which starts at the domain
+ * creation under Xen. */
+static uint64_t init_stamps[INIT_PHASE_NUM];
+static uint32_t boot_id;
+
 const metal_phys_addr_t metal_phys[] = {
 	IPI_BASE_ADDR, /**< base IPI address */
 	SHM_BASE_ADDR, /**< shared memory base address */
 	TTC0_BASE_ADDR, /**< base TTC0 address */
+	IPI1_BASE_ADDR, /**< base IPI address of APU core 1 */
+	IPI2_BASE_ADDR, /**< base IPI address of APU core 2 */
+	IPI3_BASE_ADDR, /**< base IPI address of APU core 3 */
+	GDMA_BASE_ADDR, /**< base GDMA channel 0 address */
+};
+
+/* IPI interrupt of each APU core */
+static const int ipi_irq_vect_ids[SMP_CORES_MAX] = {
+	IPI_IRQ_VECT_ID, IPI1_IRQ_VECT_ID, IPI2_IRQ_VECT_ID, IPI3_IRQ_VECT_ID,
 };
 
-/* Define metal devices table for IPI, shared memory and TTC devices.
+/* IPI device name of each APU core */
+static const char *ipi_dev_names[SMP_CORES_MAX] = {
+	IPI_DEV_NAME, IPI1_DEV_NAME, IPI2_DEV_NAME, IPI3_DEV_NAME,
+};
+
+/* Define metal devices table for IPI, shared memory, TTC and GDMA devices.
  * Linux system uses device tree to describe devices. Unlike Linux,
  * there is no standard device abstraction for baremetal system, we
  * uses libmetal devices structure to describe the devices we used in
  * the example.
- * The IPI, shared memory and TTC devices are memory mapped
+ * The IPI, shared memory, TTC and GDMA devices are memory mapped
  * devices. For this type of devices, it is required to provide
  * accessible memory mapped regions, and interrupt information.
  * In baremetal system, the memory mapping is flat. As you can see
@@ -95,8 +172,8 @@ static struct metal_device metal_dev_table[] = {
 				.size = 0x1000000,
 				.page_shift = DEFAULT_PAGE_SHIFT,
 				.page_mask = DEFAULT_PAGE_MASK,
-				.mem_flags = NORM_SHARED_NCACHE,
-				.ops = {NULL},
+				.mem_flags = SHM_MEM_FLAGS,
+				.ops = SHM_COPY_OPS,
 			}
 		},
 		.node = {NULL},
@@ -123,6 +200,86 @@ static struct metal_device metal_dev_table[] = {
 		.irq_num = 0,
 		.irq_info = NULL,
 	},
+	{
+		/* IPI device of APU core 1 */
+		.name = IPI1_DEV_NAME,
+		.bus = NULL,
+		.num_regions = 1,
+		.regions = {
+			{
+				.virt = (void *)IPI1_BASE_ADDR,
+				.physmap = &metal_phys[3],
+				.size = 0x1000,
+				.page_shift = DEFAULT_PAGE_SHIFT,
+				.page_mask = DEFAULT_PAGE_MASK,
+				.mem_flags = DEVICE_NONSHARED,
+				.ops = {NULL},
+			}
+		},
+		.node = {NULL},
+		.irq_num = 1,
+		.irq_info = (void *)IPI1_IRQ_VECT_ID,
+	},
+	{
+		/* IPI device of APU core 2 */
+		.name = IPI2_DEV_NAME,
+		.bus = NULL,
+		.num_regions = 1,
+		.regions = {
+			{
+				.virt = (void *)IPI2_BASE_ADDR,
+				.physmap = &metal_phys[4],
+				.size = 0x1000,
+				.page_shift = DEFAULT_PAGE_SHIFT,
+				.page_mask = DEFAULT_PAGE_MASK,
+				.mem_flags = DEVICE_NONSHARED,
+				.ops = {NULL},
+			}
+		},
+		.node = {NULL},
+		.irq_num = 1,
+		.irq_info = (void *)IPI2_IRQ_VECT_ID,
+	},
+	{
+		/* IPI device of APU core 3 */
+		.name = IPI3_DEV_NAME,
+		.bus = NULL,
+		.num_regions = 1,
+		.regions = {
+			{
+				.virt = (void *)IPI3_BASE_ADDR,
+				.physmap = &metal_phys[5],
+				.size = 0x1000,
+				.page_shift = DEFAULT_PAGE_SHIFT,
+				.page_mask = DEFAULT_PAGE_MASK,
+				.mem_flags = DEVICE_NONSHARED,
+				.ops = {NULL},
+			}
+		},
+		.node = {NULL},
+		.irq_num = 1,
+		.irq_info = (void *)IPI3_IRQ_VECT_ID,
+	},
+	{
+		/* GDMA channel, see zdma.h */
+		.name = GDMA_DEV_NAME,
+		.bus = NULL,
+		.num_regions = 1,
+		.regions = {
+			{
+				.virt = (void *)GDMA_BASE_ADDR,
+				.physmap = &metal_phys[6],
+				.size = 0x1000,
+				.page_shift = DEFAULT_PAGE_SHIFT,
+				.page_mask = DEFAULT_PAGE_MASK,
+				.mem_flags = DEVICE_NONSHARED,
+				.ops = {NULL},
+			}
+		},
+		.node = {NULL},
+		.irq_num = 1,
+		.irq_info = (void *)GDMA_IRQ_VECT_ID,
+	},
 };
 
 /**
@@ -131,6 +288,14 @@ static struct metal_device metal_dev_table[] = {
 struct metal_device *ipi_dev = NULL;
 struct metal_device *shm_dev = NULL;
 struct metal_device *ttc_dev = NULL;
+struct metal_device *smp_ipi_dev[SMP_CORES_MAX];
+struct metal_device *gdma_dev = NULL;
+int shm_cacheable = (SHM_MEM_FLAGS == NORM_SHARED_CACHE);
+#ifdef SHM_COPY_NEON
+int shm_neon_copy = 1;
+#else
+int shm_neon_copy = 0;
+#endif
 
 /**
  * @brief enable_caches() - Enable caches
@@ -169,16 +334,47 @@ void init_uart()
 	/* Bootrom/BSP configures PS7/PSU UART to 115200 bps */
 }
 
+/* IPI fast path, see sys_ipi_set_fast_path() */
+static struct {
+	struct metal_io_region *io; /* IPI metal i/o region */
+	atomic_flag *notified; /* flag cleared on the interrupt */
+	struct ts_timer *ts; /* timer of the RPU to APU interval, or NULL */
+} ipi_fast OCM_BSS;
+
+/**
+ * @brief ipi_fast_isr() - IPI interrupt fast path
+ *        Connected to the GIC in place of the libmetal ISR, it does not
+ *        go through the libmetal irq dispatch and does not read the IPI
+ *        status: only IPI_MASK is enabled in the IPI interrupt mask, so
+ *        the interrupt is from the RPU. It stops the RPU to APU timer,
+ *        acknowledges the IPI and clears the notified flag.
+ *
+ * @param[in] arg - unused
+ */
+static OCM_TEXT void ipi_fast_isr(void *arg)
+{
+	(void)arg;
+
+	trace_event(TRACE_IRQ_ENTER, IPI_IRQ_VECT_ID);
+	if (ipi_fast.ts)
+		ts_stop(ipi_fast.ts, TS_RPU_TO_APU);
+	metal_io_write32(ipi_fast.io, IPI_ISR_OFFSET, IPI_MASK);
+	atomic_flag_clear(ipi_fast.notified);
+	trace_event(TRACE_FLAG_CLEAR, IPI_IRQ_VECT_ID);
+}
+
 /**
  * @brief init_irq() - Initialize GIC and connect IPI interrupt
  *        This function will initialize the GIC and connect the IPI
- *        interrupt.
+ *        interrupts. The IPI interrupt of a secondary APU core is
+ *        routed to that core only.
  *
  * @return 0 - succeeded, non-0 for failures
  */
 int init_irq()
 {
 	int ret = 0;
+	int i;
 	XScuGic_Config *IntcConfig;	/* The configuration parameters of
 					 * the interrupt controller */
 
@@ -207,15 +403,45 @@ int init_irq()
 
 	Xil_ExceptionEnable();
 	/* Connect IPI Interrupt ID with libmetal ISR */
-	XScuGic_Connect(&xInterruptController, IPI_IRQ_VECT_ID,
-			   (Xil_ExceptionHandler)metal_xlnx_irq_isr,
-			   (void *)IPI_IRQ_VECT_ID);
+	for (i = 0; i < SMP_CORES_MAX; i++) {
+		XScuGic_Connect(&xInterruptController, ipi_irq_vect_ids[i],
+				(Xil_ExceptionHandler)metal_xlnx_irq_isr,
+				(void *)(intptr_t)ipi_irq_vect_ids[i]);
+		if (i) {
+			XScuGic_InterruptUnmapFromCpu(&xInterruptController, 0,
+						      ipi_irq_vect_ids[i]);
+			XScuGic_InterruptMaptoCpu(&xInterruptController, i,
+						  ipi_irq_vect_ids[i]);
+		}
+	}
 
 	XScuGic_Enable(&xInterruptController, IPI_IRQ_VECT_ID);
 
+	/* Connect GDMA Interrupt ID with libmetal ISR, enabled by its user */
+	XScuGic_Connect(&xInterruptController, GDMA_IRQ_VECT_ID,
+			(Xil_ExceptionHandler)metal_xlnx_irq_isr,
+			(void *)GDMA_IRQ_VECT_ID);
+
 	return 0;
 }
 
+/**
+ * @brief sys_cpu_irq_init() - Enable interrupts on a secondary core
+ *        init_irq() has configured the distributor on the primary core,
+ *        this enables the banked GIC CPU interface of the calling core
+ *        and unmasks its IRQs.
+ */
+void sys_cpu_irq_init(void)
+{
+	/* The distributor is shared, only the CPU interface is banked */
+	XScuGic_CPUWriteReg(&xInterruptController, XSCUGIC_CPU_PRIOR_OFFSET,
+			    0xF0U);
+	XScuGic_CPUWriteReg(&xInterruptController, XSCUGIC_CONTROL_OFFSET,
+			    0x07U);
+	/* The vector table is shared with the primary core */
+	Xil_ExceptionEnable();
+}
+
 /**
  * @brief platform_register_metal_device() - Statically Register libmetal
  *        devices.
@@ -238,7 +464,9 @@ int platform_register_metal_device(void)
 	for (i = 0; i < sizeof(metal_dev_table)/sizeof(struct metal_device);
 	     i++) {
 		dev = &metal_dev_table[i];
+#ifndef FAST_INIT
 		xil_printf("registering: %d, name=%s\n", i, dev->name);
+#endif
 		ret = metal_register_generic_device(dev);
 		if (ret)
 			return ret;
@@ -255,6 +483,7 @@ int platform_register_metal_device(void)
 int open_metal_devices(void)
 {
 	int ret;
+	int i;
 
 	/* Open shared memory device */
 	ret = metal_device_open(BUS_NAME, SHM_DEV_NAME, &shm_dev);
@@ -277,6 +506,25 @@ int open_metal_devices(void)
 		goto out;
 	}
 
+	/* Open GDMA device */
+	ret = metal_device_open(BUS_NAME, GDMA_DEV_NAME, &gdma_dev);
+	if (ret) {
+		LPERROR("Failed to open device %s.\n", GDMA_DEV_NAME);
+		goto out;
+	}
+
+	/* Open the IPI devices of the secondary cores */
+	smp_ipi_dev[0] = ipi_dev;
+	for (i = 1; i < SMP_CORES_MAX; i++) {
+		ret = metal_device_open(BUS_NAME, ipi_dev_names[i],
+					&smp_ipi_dev[i]);
+		if (ret) {
+			LPERROR("Failed to open device %s.\n",
+				ipi_dev_names[i]);
+			goto out;
+		}
+	}
+
 out:
 	return ret;
 }
@@ -289,6 +537,8 @@ out:
  */
 void close_metal_devices(void)
 {
+	int i;
+
 	/* Close shared memory device */
 	if (shm_dev)
 		metal_device_close(shm_dev);
@@ -300,6 +550,217 @@ void close_metal_devices(void)
 	/* Close TTC device */
 	if (ttc_dev)
 		metal_device_close(ttc_dev);
+
+	/* Close GDMA device */
+	if (gdma_dev)
+		metal_device_close(gdma_dev);
+
+	/* Close the IPI devices of the secondary cores */
+	for (i = 1; i < SMP_CORES_MAX; i++) {
+		if (smp_ipi_dev[i])
+			metal_device_close(smp_ipi_dev[i]);
+		smp_ipi_dev[i] = NULL;
+	}
+}
+
+/**
+ * @brief sys_shm_set_cacheable() - Change the shared memory mapping
+ *        Remap the shared memory device cacheable or non-cacheable.
+ *        When the mapping is cacheable, the producer has to flush the
+ *        data before notifying the remote and the consumer has to
+ *        invalidate it before reading, see shm_cache_flush() and
+ *        shm_cache_invalidate().
+ *
+ * @param[in] cacheable - 1 to map the shared memory cacheable, 0 to map
+ *                        it non-cacheable
+ * @return 0 - succeeded, non-zero for failures.
+ */
+int sys_shm_set_cacheable(int cacheable)
+{
+	struct metal_io_region *io;
+
+	if (!shm_dev)
+		return -ENODEV;
+	io = metal_device_io_region(shm_dev, 0);
+	if (!io)
+		return -ENODEV;
+	cacheable = !!cacheable;
+	if (cacheable == shm_cacheable)
+		return 0;
+
+	/* Write back the dirty lines before the mapping changes */
+	if (shm_cacheable)
+		metal_cache_flush(io->virt, io->size);
+	io->mem_flags = cacheable ? NORM_SHARED_CACHE : NORM_SHARED_NCACHE;
+	metal_machine_io_mem_map(io->virt, *io->physmap, io->size,
+				 io->mem_flags);
+	/* Drop any stale line of the region */
+	metal_cache_invalidate(io->virt, io->size);
+	shm_cacheable = cacheable;
+	return 0;
+}
+
+/**
+ * @brief sys_shm_set_neon_copy() - Change the shared memory block copy
+ *        Install or remove the NEON block copy in the shared memory
+ *        i/o region, see shm_copy.h. The other accesses are unchanged.
+ *
+ * @param[in] neon - 1 to copy with NEON, 0 for the generic libmetal copy
+ * @return 0 - succeeded, non-zero for failures.
+ */
+int sys_shm_set_neon_copy(int neon)
+{
+	struct metal_io_region *io;
+
+	if (!shm_dev)
+		return -ENODEV;
+	io = metal_device_io_region(shm_dev, 0);
+	if (!io)
+		return -ENODEV;
+	neon = !!neon;
+	io->ops.block_read = neon ? shm_copy_neon_block_read : NULL;
+	io->ops.block_write = neon ? shm_copy_neon_block_write : NULL;
+	shm_neon_copy = neon;
+	return 0;
+}
+
+/**
+ * @brief sys_gic_read() - Read the GIC distributor control register
+ *        Under Xen the distributor is emulated and the read traps to the
+ *        hypervisor. It is used to measure the cost of a GIC access.
+ *
+ * @return - value of the register.
+ */
+uint32_t sys_gic_read(void)
+{
+	return XScuGic_DistReadReg(&xInterruptController,
+				   XSCUGIC_DIST_EN_OFFSET);
+}
+
+/**
+ * @brief sys_ipi_set_fast_path() - Change the IPI interrupt handler
+ *        Connect ipi_fast_isr() or the libmetal ISR to the IPI interrupt
+ *        of the primary core. The libmetal path is the default, the
+ *        handler registered with metal_irq_register() is not called
+ *        while the fast path is connected.
+ *
+ * @param[in] notified - flag to clear on the interrupt, NULL to connect
+ *                       the libmetal ISR back
+ * @param[in] ts - timer to stop the RPU to APU interval, or NULL
+ * @return 0 - succeeded, non-zero for failures.
+ */
+int sys_ipi_set_fast_path(atomic_flag *notified, struct ts_timer *ts)
+{
+	struct metal_io_region *io;
+
+	if (!ipi_dev)
+		return -ENODEV;
+	io = metal_device_io_region(ipi_dev, 0);
+	if (!io)
+		return -ENODEV;
+	XScuGic_Disable(&xInterruptController, IPI_IRQ_VECT_ID);
+	if (notified) {
+		ipi_fast.io = io;
+		ipi_fast.notified = notified;
+		ipi_fast.ts = ts;
+		XScuGic_Connect(&xInterruptController, IPI_IRQ_VECT_ID,
+				(Xil_ExceptionHandler)ipi_fast_isr, NULL);
+	} else {
+		XScuGic_Connect(&xInterruptController, IPI_IRQ_VECT_ID,
+				(Xil_ExceptionHandler)metal_xlnx_irq_isr,
+				(void *)IPI_IRQ_VECT_ID);
+	}
+	XScuGic_Enable(&xInterruptController, IPI_IRQ_VECT_ID);
+	return 0;
+}
+
+/**
+ * @brief init_mark() - Mark the end of a startup phase
+ *
+ * @param[in] phase - startup phase
+ */
+static inline void init_mark(enum init_phase phase)
+{
+	init_stamps[phase] = ts_now();
+}
+
+/**
+ * @brief init_report() - Print the startup breakdown
+ *        Print when each phase ended and how long it took.
+ */
+static void init_report(void)
+{
+	uint64_t prev = 0;
+	int i;
+
+#ifdef NOXEN
+	LPRINTF("startup, us since reset:\n");
+#else
+	LPRINTF("startup, us since domain creation:\n");
+#endif
+	for (i = 0; i < INIT_PHASE_NUM; i++) {
+		if (!init_stamps[i])
+			continue;
+		LPRINTF("  %s: %lu (+%lu)\n", init_phase_names[i],
+			ts_cnt_to_ns(init_stamps[i]) / 1000,
+			ts_cnt_to_ns(init_stamps[i] - prev) / 1000);
+		prev = init_stamps[i];
+	}
+}
+
+/**
+ * @brief sys_ready_init() - Start the readiness handshake of this boot
+ *        Publish a new boot ID, the server echoes it once it has
+ *        restarted its demo sequence.
+ *
+ * @param[in] io - shared memory i/o region
+ */
+static void sys_ready_init(struct metal_io_region *io)
+{
+	uint64_t cnt;
+
+	/* The physical count differs from one boot to the next */
+	asm volatile("isb; mrs %0, cntpct_el0" : "=r" (cnt));
+	boot_id = (uint32_t)cnt | 1;
+	metal_io_write32(io, SHM_READY_OFFSET + SHM_READY_BOOT_ID, boot_id);
+	shm_cache_flush(io, SHM_READY_OFFSET + SHM_READY_BOOT_ID,
+			SHM_LINE_SIZE);
+}
+
+/**
+ * @brief sys_wait_remote() - Wait for the server to be ready for a demo
+ *        With FAST_INIT, poll the readiness block until the server waits
+ *        in the demo. Otherwise, sleep for a second.
+ *
+ * @param[in] demo - number of the demo, from 1
+ * @return 0 - succeeded, -ETIMEDOUT if the server is not ready within
+ *         SHM_READY_TIMEOUT_S seconds.
+ */
+int sys_wait_remote(uint32_t demo)
+{
+#ifdef FAST_INIT
+	struct metal_io_region *io = metal_device_io_region(shm_dev, 0);
+	uint64_t timeout;
+
+	timeout = ts_now() + ts_cnt_freq() * SHM_READY_TIMEOUT_S;
+	while (1) {
+		shm_cache_invalidate(io, SHM_READY_OFFSET + SHM_READY_ECHO,
+				     SHM_LINE_SIZE);
+		if (metal_io_read32(io, SHM_READY_OFFSET + SHM_READY_ECHO) ==
+		    boot_id &&
+		    metal_io_read32(io, SHM_READY_OFFSET + SHM_READY_DEMO) >=
+		    demo)
+			return 0;
+		if (ts_now() > timeout) {
+			LPERROR("Server not ready for demo %u.\n", demo);
+			return -ETIMEDOUT;
+		}
+	}
+#else
+	(void)demo;
+	sleep(1);
+	return 0;
+#endif
 }
 
 /**
@@ -315,14 +776,19 @@ int sys_init()
 	struct metal_init_params metal_param = METAL_INIT_DEFAULTS;
 	int ret;
 
+	init_mark(INIT_PHASE_ENTRY);
 //	enable_caches();
 //	init_uart();
+	/* Copy the OCM placed hot path before the IPI ISR is connected */
+	ocm_init();
 	if (init_irq()) {
 		LPERROR("Failed to initialize interrupt\n");
 	}
+	init_mark(INIT_PHASE_IRQ);
 
 	/* Initialize libmetal environment */
 	metal_init(&metal_param);
+	init_mark(INIT_PHASE_METAL);
 
 	/* Initialize metal Xilinx IRQ controller */
 	ret = metal_xlnx_irq_init();
@@ -331,6 +797,7 @@ int sys_init()
 			__func__);
 		return ret;
 	}
+	init_mark(INIT_PHASE_XLNX_IRQ);
 
 	/* Register libmetal devices */
 	ret = platform_register_metal_device();
@@ -338,6 +805,7 @@ int sys_init()
 		LPERROR("%s: failed to register devices: %d\n", __func__, ret);
 		return ret;
 	}
+	init_mark(INIT_PHASE_REGISTER);
 
 	/* Open libmetal devices which have been registered */
 	ret = open_metal_devices();
@@ -345,6 +813,67 @@ int sys_init()
 		LPERROR("%s: failed to open devices: %d\n", __func__, ret);
 		return ret;
 	}
+	init_mark(INIT_PHASE_OPEN);
+
+	/* Check the shared memory layout and share it with the server */
+	ret = shm_layout_publish(metal_device_io_region(shm_dev, 0));
+	if (ret) {
+		LPERROR("%s: invalid shared memory layout: %d\n",
+			__func__, ret);
+		return ret;
+	}
+	sys_ready_init(metal_device_io_region(shm_dev, 0));
+
+	/* Load the runtime parameters filled by the server, if any */
+	if (demo_params_load(metal_device_io_region(shm_dev, 0)))
+		LPRINTF("No shared memory parameters, using defaults.\n");
+#ifndef FAST_INIT
+	demo_params_print();
+#endif
+	init_mark(INIT_PHASE_PARAMS);
+
+	/* Select the notification backend, the IPI by default */
+	ret = notify_init(metal_device_io_region(shm_dev, 0));
+	if (ret) {
+		LPERROR("%s: failed to initialize doorbells: %d\n",
+			__func__, ret);
+		return ret;
+	}
+	if (demo_params.flags & DEMO_PARAMS_DOORBELL) {
+		notify_set_backend(NOTIFY_BACKEND_DOORBELL, 0);
+	} else if (demo_params.evtchn_port) {
+		ret = notify_set_backend(NOTIFY_BACKEND_EVTCHN,
+					 demo_params.evtchn_port);
+		if (ret)
+			LPERROR("%s: no event channel backend: %d, using IPI\n",
+				__func__, ret);
+	}
+
+	/* Start a new set of results */
+	ret = results_init(metal_device_io_region(shm_dev, 0));
+	if (ret) {
+		LPERROR("%s: failed to initialize results: %d\n",
+			__func__, ret);
+		return ret;
+	}
+	init_mark(INIT_PHASE_RESULTS);
+
+	/* Start a new trace, there is no trace if DEMO_TRACE is not set */
+	ret = trace_init(metal_device_io_region(shm_dev, 0));
+	if (ret) {
+		LPERROR("%s: failed to initialize trace: %d\n",
+			__func__, ret);
+		return ret;
+	}
+
+#ifdef FAST_INIT
+	/* The first channel is usable once the server is ready */
+	ret = sys_wait_remote(1);
+	if (ret)
+		return ret;
+	init_mark(INIT_PHASE_READY);
+#endif
+	init_report();
 
 	return 0;
 }
@@ -33,9 +33,39 @@
 #ifndef __SYS_INIT_H__
 #define __SYS_INIT_H__
 
+#include <stdint.h>
+#include <metal/atomic.h>
 #include "platform_config.h"
 
+struct ts_timer;
+
+/*
+ * Readiness handshake with the server, used instead of the fixed sleeps
+ * between the demos when built with FAST_INIT.
+ *
+ * Here is the structure of the readiness block in the shared memory:
+ * |0x00 - 0x03 | APU boot ID, written by the APU in sys_init() |
+ * |0x40 - 0x43 | boot ID echo, the server copies the APU boot ID once it
+ *                has restarted its demo sequence for this boot |
+ * |0x44 - 0x47 | number of the demo the server waits in, from 1, written
+ *                by the server, valid once the echo matches |
+ *
+ * The server writes the demo number before the echo.
+ */
+#define SHM_READY_OFFSET       0xFE0000
+#define SHM_READY_BOOT_ID      0x00
+#define SHM_READY_ECHO         0x40
+#define SHM_READY_DEMO         0x44
+#define SHM_READY_SIZE         0x80
+#define SHM_READY_TIMEOUT_S    10
+
 int sys_init();
 void sys_cleanup();
+int sys_shm_set_cacheable(int cacheable);
+int sys_shm_set_neon_copy(int neon);
+int sys_ipi_set_fast_path(atomic_flag *notified, struct ts_timer *ts);
+uint32_t sys_gic_read(void);
+void sys_cpu_irq_init(void);
+int sys_wait_remote(uint32_t demo);
 
 #endif /* __SYS_INIT_H__ */
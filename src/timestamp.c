@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * timestamp.c
+ * Timestamp source for the latency and throughput measurements.
+ * See timestamp.h for the backends and the shared memory structure.
+ */
+
+#include <errno.h>
+#include <metal/io.h>
+#include "common.h"
+#include "timestamp.h"
+
+uint64_t ts_cnt_offset = 0;
+
+int ts_init(struct ts_timer *ts, struct metal_io_region *ttc_io,
+	    struct metal_io_region *shm_io)
+{
+	uint64_t pcnt, vcnt;
+
+	if (!ts || !shm_io)
+		return -EINVAL;
+#ifdef TS_BACKEND_TTC
+	if (!ttc_io)
+		return -EINVAL;
+#endif
+	ts->ttc_io = ttc_io;
+	ts->shm_io = shm_io;
+
+	/* Under Xen the virtual count is offset from the system count the
+	 * RPU sees. EL1 may read the physical count, but only do it once,
+	 * the hot path reads the virtual count. */
+	asm volatile("isb; mrs %0, cntpct_el0; mrs %1, cntvct_el0"
+		     : "=r" (pcnt), "=r" (vcnt) :: "memory");
+	ts_cnt_offset = pcnt - vcnt;
+
+	/* Tell the remote which backend to use */
+	metal_io_write32(shm_io, SHM_TS_OFFSET + SHM_TS_BACKEND_OFFSET,
+#ifdef TS_BACKEND_TTC
+			 TS_BACKEND_TTC_ID);
+#else
+			 TS_BACKEND_GENERIC_ID);
+#endif
+	shm_cache_flush(shm_io, SHM_TS_OFFSET, SHM_TS_SIZE);
+	return 0;
+}
+
+const char *ts_backend_name(void)
+{
+#ifdef TS_BACKEND_TTC
+	return "TTC";
+#else
+	return "generic timer";
+#endif
+}
+
+uint64_t ts_freq(void)
+{
+#ifdef TS_BACKEND_TTC
+	return TTC_CLK_FREQ_HZ;
+#else
+	return ts_cnt_freq();
+#endif
+}
+
+uint64_t ts_cnt_freq(void)
+{
+	static uint64_t freq;
+
+	if (!freq)
+		asm volatile("mrs %0, cntfrq_el0" : "=r" (freq));
+	return freq;
+}
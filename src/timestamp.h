@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * timestamp.h
+ * Timestamp source for the latency and throughput measurements.
+ *
+ * The demos measure two directional intervals, APU to RPU and RPU to APU.
+ * One side starts the interval, the same or the other side stops it, and
+ * the APU reads it. Two backends are available:
+ *
+ * - Generic timer (default): the start and stop stamps are 64bit values
+ *   of the system counter, written to the timestamp block in the shared
+ *   memory. The APU reads the counter through CNTVCT_EL0, which does not
+ *   trap, and adds the offset to the physical count measured at init, so
+ *   the stamps are in the time base of the system counter. The RPU reads
+ *   the same counter through the IOU_SCNTRS counter value registers
+ *   (0xFF260008 low, 0xFF26000C high), so both sides share one wall
+ *   clock and the intervals do not wrap.
+ * - TTC (build with TS_BACKEND_TTC): counters 2 and 3 of TTC0 are reset
+ *   to start an interval, disabled to stop it and read back. They are
+ *   32bit counters so long intervals wrap.
+ *
+ * Here is the structure of the timestamp block in the shared memory,
+ * each field is on its own cache line:
+ * |0x00  - 0x03  | backend ID, written by APU at init (enum ts_backend) |
+ * |0x40  - 0x47  | APU to RPU start stamp, written by APU |
+ * |0x80  - 0x87  | APU to RPU stop stamp, written by the stopping side |
+ * |0xC0  - 0xC7  | RPU to APU start stamp, written by the starting side |
+ * |0x100 - 0x107 | RPU to APU stop stamp, written by APU |
+ */
+
+#ifndef __TIMESTAMP_H__
+#define __TIMESTAMP_H__
+
+#include <stdint.h>
+#include <metal/io.h>
+#include "common.h"
+
+#define TTC_CNT_APU_TO_RPU 2 /* APU to RPU TTC counter ID */
+#define TTC_CNT_RPU_TO_APU 3 /* RPU to APU TTC counter ID */
+
+#define TTC_CLK_FREQ_HZ	100000000
+#define NS_PER_SEC	1000000000ULL
+
+/* Timestamp block in the shared memory */
+#define SHM_TS_OFFSET        0xF00000
+#define SHM_TS_BACKEND_OFFSET 0x00
+#define SHM_TS_STAMP_OFFSET(dir, stop) (0x40 + ((dir) * 2 + (stop)) * 0x40)
+#define SHM_TS_SIZE          0x140
+
+/**
+ * timestamp backends
+ */
+enum ts_backend {
+	TS_BACKEND_TTC_ID = 0, /* TTC0 counters 2 and 3 */
+	TS_BACKEND_GENERIC_ID = 1, /* ARMv8 generic timer system counter */
+};
+
+/**
+ * measured directions
+ */
+enum ts_dir {
+	TS_APU_TO_RPU = 0,
+	TS_RPU_TO_APU = 1,
+};
+
+/**
+ * timestamp source of a channel
+ */
+struct ts_timer {
+	struct metal_io_region *ttc_io; /* TTC metal i/o region */
+	struct metal_io_region *shm_io; /* Shared memory metal i/o region */
+};
+
+/* Offset from the virtual count to the physical system count */
+extern uint64_t ts_cnt_offset;
+
+/**
+ * @brief ts_init() - Initialize the timestamp source of a channel
+ *        Write the backend ID to the timestamp block so that the remote
+ *        uses the same one.
+ *
+ * @param[in] ts - timestamp source
+ * @param[in] ttc_io - TTC timer i/o region
+ * @param[in] shm_io - shared memory i/o region
+ * @return - 0 on success, error code if failure.
+ */
+int ts_init(struct ts_timer *ts, struct metal_io_region *ttc_io,
+	    struct metal_io_region *shm_io);
+
+/**
+ * @brief ts_backend_name() - return name of the timestamp backend
+ */
+const char *ts_backend_name(void);
+
+/**
+ * @brief ts_freq() - return frequency of the timestamp ticks in Hz
+ */
+uint64_t ts_freq(void);
+
+/**
+ * @brief ts_cnt_freq() - return frequency of the system count in Hz
+ *        This is the frequency of ts_now(), whichever the backend.
+ */
+uint64_t ts_cnt_freq(void);
+
+/**
+ * @brief ts_now() - return the current system count
+ *        Read CNTVCT_EL0, the isb keeps the read from being done
+ *        earlier than the instructions before it.
+ */
+static inline uint64_t ts_now(void)
+{
+	uint64_t cnt;
+
+	asm volatile("isb; mrs %0, cntvct_el0" : "=r" (cnt) :: "memory");
+	return cnt + ts_cnt_offset;
+}
+
+/**
+ * @brief ts_ticks_to_ns() - convert timestamp ticks to nanoseconds
+ *
+ * @param[in] ticks - number of ticks
+ */
+static inline uint64_t ts_ticks_to_ns(uint64_t ticks)
+{
+	uint64_t freq = ts_freq();
+
+	return (ticks / freq) * NS_PER_SEC + (ticks % freq) * NS_PER_SEC / freq;
+}
+
+/**
+ * @brief ts_cnt_to_ns() - convert a system count interval to nanoseconds
+ *
+ * @param[in] cnt - number of system count ticks, e.g. of ts_now()
+ */
+static inline uint64_t ts_cnt_to_ns(uint64_t cnt)
+{
+	uint64_t freq = ts_cnt_freq();
+
+	return (cnt / freq) * NS_PER_SEC + (cnt % freq) * NS_PER_SEC / freq;
+}
+
+#ifdef TS_BACKEND_TTC
+/**
+ * @brief ts_ttc_cnt_id() - return TTC counter ID of a direction
+ *
+ * @param[in] dir - direction
+ */
+static inline unsigned long ts_ttc_cnt_id(enum ts_dir dir)
+{
+	return dir == TS_APU_TO_RPU ? TTC_CNT_APU_TO_RPU : TTC_CNT_RPU_TO_APU;
+}
+#endif
+
+/**
+ * @brief ts_start() - start measuring an interval
+ *        TTC: set the RST bit in the Count Control Reg.
+ *        Generic timer: write the start stamp.
+ *
+ * @param[in] ts - timestamp source
+ * @param[in] dir - direction
+ */
+static inline void ts_start(struct ts_timer *ts, enum ts_dir dir)
+{
+#ifdef TS_BACKEND_TTC
+	metal_io_write32(ts->ttc_io, XTTCPS_CNT_CNTRL_OFFSET +
+			 XTTCPS_CNT_OFFSET(ts_ttc_cnt_id(dir)),
+			 XTTCPS_CNT_CNTRL_RST_MASK);
+#else
+	unsigned long offset = SHM_TS_OFFSET + SHM_TS_STAMP_OFFSET(dir, 0);
+
+	metal_io_write64(ts->shm_io, offset, ts_now());
+	shm_cache_flush(ts->shm_io, offset, sizeof(uint64_t));
+#endif
+}
+
+/**
+ * @brief ts_stop() - stop measuring an interval
+ *        TTC: set the disable bit in the Count Control Reg.
+ *        Generic timer: write the stop stamp.
+ *
+ * @param[in] ts - timestamp source
+ * @param[in] dir - direction
+ */
+static inline void ts_stop(struct ts_timer *ts, enum ts_dir dir)
+{
+#ifdef TS_BACKEND_TTC
+	metal_io_write32(ts->ttc_io, XTTCPS_CNT_CNTRL_OFFSET +
+			 XTTCPS_CNT_OFFSET(ts_ttc_cnt_id(dir)),
+			 XTTCPS_CNT_CNTRL_DIS_MASK);
+#else
+	unsigned long offset = SHM_TS_OFFSET + SHM_TS_STAMP_OFFSET(dir, 1);
+
+	metal_io_write64(ts->shm_io, offset, ts_now());
+	shm_cache_flush(ts->shm_io, offset, sizeof(uint64_t));
+#endif
+}
+
+/**
+ * @brief ts_read() - return a measured interval in ticks
+ *
+ * @param[in] ts - timestamp source
+ * @param[in] dir - direction
+ */
+static inline uint64_t ts_read(struct ts_timer *ts, enum ts_dir dir)
+{
+#ifdef TS_BACKEND_TTC
+	return metal_io_read32(ts->ttc_io, XTTCPS_CNT_VAL_OFFSET +
+			       XTTCPS_CNT_OFFSET(ts_ttc_cnt_id(dir)));
+#else
+	unsigned long offset = SHM_TS_OFFSET + SHM_TS_STAMP_OFFSET(dir, 0);
+	uint64_t start, stop;
+
+	shm_cache_invalidate(ts->shm_io, offset, 0x80);
+	start = metal_io_read64(ts->shm_io, offset);
+	stop = metal_io_read64(ts->shm_io, offset + 0x40);
+	return stop - start;
+#endif
+}
+
+/**
+ * @brief ts_sample() - return a running count, for intervals measured
+ *        locally on the APU in the same ticks as ts_read()
+ *        TTC: read the APU to RPU counter, it must be running.
+ *        Generic timer: read the system count.
+ *
+ * @param[in] ts - timestamp source
+ */
+static inline uint64_t ts_sample(struct ts_timer *ts)
+{
+#ifdef TS_BACKEND_TTC
+	return metal_io_read32(ts->ttc_io, XTTCPS_CNT_VAL_OFFSET +
+			       XTTCPS_CNT_OFFSET(TTC_CNT_APU_TO_RPU));
+#else
+	(void)ts;
+	return ts_now();
+#endif
+}
+
+#endif /* __TIMESTAMP_H__ */
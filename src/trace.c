@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * trace.c
+ * Hot path event trace ring in the shared memory.
+ * See trace.h for the shared memory structure of the trace area.
+ */
+
+#include "common.h"
+#include "trace.h"
+
+#ifdef DEMO_TRACE
+
+struct trace_record *trace_records;
+volatile uint32_t *trace_head;
+atomic_uint trace_next = ATOMIC_VAR_INIT(0);
+
+static struct metal_io_region *trace_io;
+
+int trace_init(struct metal_io_region *io)
+{
+	if (!io || metal_io_region_size(io) < SHM_TRACE_OFFSET +
+					      SHM_TRACE_SIZE)
+		return -EINVAL;
+	trace_io = io;
+	atomic_store(&trace_next, 0);
+
+	metal_io_block_set(io, SHM_TRACE_OFFSET, 0, SHM_TRACE_SIZE);
+	metal_io_write32(io, SHM_TRACE_OFFSET + 0x00, TRACE_MAGIC);
+	metal_io_write32(io, SHM_TRACE_OFFSET + 0x04, TRACE_VERSION);
+	metal_io_write32(io, SHM_TRACE_OFFSET + 0x08,
+			 sizeof(struct trace_record));
+	metal_io_write32(io, SHM_TRACE_OFFSET + 0x0C, TRACE_NUM_RECORDS);
+	shm_cache_flush(io, SHM_TRACE_OFFSET, SHM_TRACE_SIZE);
+
+	trace_head = metal_io_virt(io, SHM_TRACE_OFFSET + TRACE_HEAD_OFFSET);
+	trace_records = metal_io_virt(io, SHM_TRACE_OFFSET +
+				      TRACE_RECORDS_OFFSET);
+	return 0;
+}
+
+void trace_sync(void)
+{
+	uint32_t n;
+
+	if (!trace_io)
+		return;
+	n = atomic_load(&trace_next);
+	LPRINTF("trace: %u events, %u kept at 0x%x\n", n,
+		n < TRACE_NUM_RECORDS ? n : TRACE_NUM_RECORDS,
+		SHM_TRACE_OFFSET);
+	shm_cache_flush(trace_io, SHM_TRACE_OFFSET, SHM_TRACE_SIZE);
+}
+
+#endif /* DEMO_TRACE */
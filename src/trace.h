@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * trace.h
+ * Hot path event trace ring in the shared memory.
+ *
+ * Build with DEMO_TRACE to record the IPI kicks, the interrupt handler
+ * entries, the notified flag clears, the waits and the shared memory
+ * copies with a timestamp each. Without DEMO_TRACE the trace calls are
+ * compiled out.
+ *
+ * A record is written directly to the shared memory, there is no
+ * allocation or lock: the writer takes the next index with an atomic
+ * add, fills the record and updates the head. The ring wraps, so the
+ * last TRACE_NUM_RECORDS events are kept. The stamps are in the time
+ * base of the system counter, the same as ts_now(), the events before
+ * ts_init() have no offset applied. The area is flushed from the cache
+ * at the end of the demos, Linux dumps it after the results are done.
+ *
+ * Here is the structure of the trace area in the shared memory:
+ * |0x00 - 0x03 | magic, TRACE_MAGIC |
+ * |0x04 - 0x07 | version, TRACE_VERSION |
+ * |0x08 - 0x0B | record size in bytes |
+ * |0x0C - 0x0F | number of records in the ring, a power of two |
+ * |0x10 - 0x13 | head, number of records written since init, the record
+ *               of event n is at n % number of records |
+ * |0x40 - ...  | records, struct trace_record |
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include <metal/io.h>
+
+/* Trace area in the shared memory */
+#define SHM_TRACE_OFFSET       0xF10000
+#define TRACE_HEAD_OFFSET      0x10
+#define TRACE_RECORDS_OFFSET   0x40
+#define TRACE_NUM_RECORDS      0x8000
+#define SHM_TRACE_SIZE \
+	(TRACE_RECORDS_OFFSET + TRACE_NUM_RECORDS * sizeof(struct trace_record))
+
+#define TRACE_MAGIC            0x45435254 /* "TRCE" */
+#define TRACE_VERSION          1
+
+/**
+ * trace event IDs
+ */
+enum trace_id {
+	TRACE_KICK = 1, /* IPI kick to the RPU, arg: IPI mask */
+	TRACE_IRQ_ENTER, /* IPI interrupt handler entry, arg: vector ID */
+	TRACE_FLAG_CLEAR, /* notified flag cleared, arg: vector ID */
+	TRACE_WAIT_START, /* wait_for_notified() entry, arg: wait policy */
+	TRACE_WAIT_END, /* wait_for_notified() exit, arg: wait policy */
+	TRACE_COPY_START, /* shared memory copy start, arg: bytes */
+	TRACE_COPY_END, /* shared memory copy end, arg: bytes */
+};
+
+/**
+ * trace record in the shared memory
+ */
+struct trace_record {
+	uint64_t ts; /* system count */
+	uint32_t id; /* enum trace_id */
+	uint32_t arg; /* event argument */
+};
+
+#ifdef DEMO_TRACE
+
+#include <metal/atomic.h>
+
+extern struct trace_record *trace_records;
+extern volatile uint32_t *trace_head;
+extern atomic_uint trace_next;
+extern uint64_t ts_cnt_offset;
+
+/**
+ * @brief trace_init() - clear the trace area and start recording
+ *
+ * @param[in] io - shared memory metal i/o region
+ * @return - 0 on success, -EINVAL if the region is too small.
+ */
+int trace_init(struct metal_io_region *io);
+
+/**
+ * @brief trace_sync() - flush the trace area for Linux to dump it
+ */
+void trace_sync(void);
+
+/**
+ * @brief trace_event() - record an event
+ *        The system count is read as in ts_now(), timestamp.h is not
+ *        included as it depends on common.h.
+ *
+ * @param[in] id - event ID, enum trace_id
+ * @param[in] arg - event argument
+ */
+static inline void trace_event(uint32_t id, uint32_t arg)
+{
+	struct trace_record *r;
+	uint32_t n;
+	uint64_t cnt;
+
+	if (!trace_records)
+		return;
+	asm volatile("isb; mrs %0, cntvct_el0" : "=r" (cnt) :: "memory");
+	n = atomic_fetch_add_explicit(&trace_next, 1, memory_order_relaxed);
+	r = &trace_records[n & (TRACE_NUM_RECORDS - 1)];
+	r->ts = cnt + ts_cnt_offset;
+	r->id = id;
+	r->arg = arg;
+	*trace_head = n + 1;
+}
+
+#else /* DEMO_TRACE */
+
+#define trace_init(io) ((void)(io), 0)
+#define trace_sync() do { } while (0)
+#define trace_event(id, arg) do { } while (0)
+
+#endif /* DEMO_TRACE */
+
+#endif /* __TRACE_H__ */
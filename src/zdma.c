@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * zdma.c
+ * Minimal driver of a ZynqMP GDMA/ADMA (ZDMA) channel.
+ * See zdma.h for the mode of operation.
+ */
+
+#include <errno.h>
+#include <metal/io.h>
+#include "zdma.h"
+
+int zdma_init(struct metal_io_region *io)
+{
+	if (!io)
+		return -EINVAL;
+	metal_io_write32(io, ZDMA_CH_CTRL2_OFFSET, 0);
+	metal_io_write32(io, ZDMA_CH_IDS_OFFSET, ZDMA_IRQ_ALL);
+	metal_io_write32(io, ZDMA_CH_ISR_OFFSET, ZDMA_IRQ_ALL);
+	/* Simple mode, normal transfers */
+	metal_io_write32(io, ZDMA_CH_CTRL0_OFFSET, 0);
+	metal_io_write32(io, ZDMA_CH_IEN_OFFSET,
+			 ZDMA_IRQ_DONE | ZDMA_IRQ_ERR);
+	return 0;
+}
+
+int zdma_submit(struct metal_io_region *io, metal_phys_addr_t dst,
+		metal_phys_addr_t src, uint32_t len)
+{
+	if (!len || len >= ZDMA_SIZE_MAX)
+		return -EINVAL;
+	metal_io_write32(io, ZDMA_CH_SRC_DSCR_WORD0, (uint32_t)src);
+	metal_io_write32(io, ZDMA_CH_SRC_DSCR_WORD1, (uint64_t)src >> 32);
+	metal_io_write32(io, ZDMA_CH_SRC_DSCR_WORD2, len);
+	metal_io_write32(io, ZDMA_CH_SRC_DSCR_WORD3, 0);
+	metal_io_write32(io, ZDMA_CH_DST_DSCR_WORD0, (uint32_t)dst);
+	metal_io_write32(io, ZDMA_CH_DST_DSCR_WORD1, (uint64_t)dst >> 32);
+	metal_io_write32(io, ZDMA_CH_DST_DSCR_WORD2, len);
+	metal_io_write32(io, ZDMA_CH_DST_DSCR_WORD3, 0);
+	/* metal_io_write32() is sequentially consistent, the descriptors
+	 * are written before the channel is enabled */
+	metal_io_write32(io, ZDMA_CH_CTRL2_OFFSET, ZDMA_CH_CTRL2_EN);
+	return 0;
+}
+
+uint32_t zdma_ack(struct metal_io_region *io)
+{
+	uint32_t val;
+
+	val = metal_io_read32(io, ZDMA_CH_ISR_OFFSET);
+	metal_io_write32(io, ZDMA_CH_ISR_OFFSET, val);
+	return val;
+}
+
+void zdma_fini(struct metal_io_region *io)
+{
+	if (!io)
+		return;
+	metal_io_write32(io, ZDMA_CH_IDS_OFFSET, ZDMA_IRQ_ALL);
+	metal_io_write32(io, ZDMA_CH_CTRL2_OFFSET, 0);
+	metal_io_write32(io, ZDMA_CH_ISR_OFFSET, ZDMA_IRQ_ALL);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2017, Xilinx Inc. and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*****************************************************************************
+ * zdma.h
+ * Minimal driver of a ZynqMP GDMA/ADMA (ZDMA) channel.
+ *
+ * The channel is used in simple mode: one transfer at a time, the source
+ * and destination descriptors are written to the channel registers, no
+ * descriptor is fetched from memory. The DMA_DONE interrupt is raised at
+ * the end of the transfer.
+ *
+ * The ZDMA is not coherent with the APU caches and uses physical
+ * addresses: the source must be cleaned and the destination invalidated
+ * before the transfer if they are cacheable.
+ */
+
+#ifndef __ZDMA_H__
+#define __ZDMA_H__
+
+#include <stdint.h>
+#include <metal/io.h>
+
+/* ZDMA channel registers offsets */
+#define ZDMA_CH_ISR_OFFSET        0x100 /* interrupt status, write 1 clear */
+#define ZDMA_CH_IMR_OFFSET        0x104 /* interrupt mask */
+#define ZDMA_CH_IEN_OFFSET        0x108 /* interrupt enable */
+#define ZDMA_CH_IDS_OFFSET        0x10C /* interrupt disable */
+#define ZDMA_CH_CTRL0_OFFSET      0x110 /* mode and point type */
+#define ZDMA_CH_STATUS_OFFSET     0x11C /* channel state */
+#define ZDMA_CH_SRC_DSCR_WORD0    0x128 /* source address, low */
+#define ZDMA_CH_SRC_DSCR_WORD1    0x12C /* source address, high */
+#define ZDMA_CH_SRC_DSCR_WORD2    0x130 /* source size */
+#define ZDMA_CH_SRC_DSCR_WORD3    0x134 /* source control */
+#define ZDMA_CH_DST_DSCR_WORD0    0x138 /* destination address, low */
+#define ZDMA_CH_DST_DSCR_WORD1    0x13C /* destination address, high */
+#define ZDMA_CH_DST_DSCR_WORD2    0x140 /* destination size */
+#define ZDMA_CH_DST_DSCR_WORD3    0x144 /* destination control */
+#define ZDMA_CH_CTRL2_OFFSET      0x200 /* channel enable */
+
+/* Interrupt bits */
+#define ZDMA_IRQ_INV_APB          0x001 /* invalid register access */
+#define ZDMA_IRQ_AXI_RD_SRC_DSCR  0x040
+#define ZDMA_IRQ_AXI_RD_DST_DSCR  0x080
+#define ZDMA_IRQ_AXI_RD_DATA      0x100
+#define ZDMA_IRQ_AXI_WR_DATA      0x200
+#define ZDMA_IRQ_DONE             0x400 /* transfer done */
+#define ZDMA_IRQ_ERR              (ZDMA_IRQ_INV_APB | \
+				   ZDMA_IRQ_AXI_RD_SRC_DSCR | \
+				   ZDMA_IRQ_AXI_RD_DST_DSCR | \
+				   ZDMA_IRQ_AXI_RD_DATA | \
+				   ZDMA_IRQ_AXI_WR_DATA)
+#define ZDMA_IRQ_ALL              0xFFF
+
+#define ZDMA_CH_CTRL2_EN          0x1 /* start the transfer */
+#define ZDMA_SIZE_MAX             0x40000000 /* 30 bits size */
+
+/**
+ * @brief zdma_init() - Reset the channel to simple mode
+ *        Disable the channel, clear and unmask the done and error
+ *        interrupts.
+ *
+ * @param[in] io - ZDMA channel i/o region
+ * @return - 0 on success, error code if failure.
+ */
+int zdma_init(struct metal_io_region *io);
+
+/**
+ * @brief zdma_submit() - Start a transfer
+ *        The channel must be idle, i.e. the previous transfer is done.
+ *
+ * @param[in] io - ZDMA channel i/o region
+ * @param[in] dst - physical address of the destination
+ * @param[in] src - physical address of the source
+ * @param[in] len - number of bytes
+ * @return - 0 on success, -EINVAL if the size is out of range.
+ */
+int zdma_submit(struct metal_io_region *io, metal_phys_addr_t dst,
+		metal_phys_addr_t src, uint32_t len);
+
+/**
+ * @brief zdma_ack() - Read and clear the pending interrupts
+ *
+ * @param[in] io - ZDMA channel i/o region
+ * @return - pending ZDMA_IRQ_* bits.
+ */
+uint32_t zdma_ack(struct metal_io_region *io);
+
+/**
+ * @brief zdma_fini() - Disable the channel and its interrupts
+ *
+ * @param[in] io - ZDMA channel i/o region
+ */
+void zdma_fini(struct metal_io_region *io);
+
+#endif /* __ZDMA_H__ */